@@ -0,0 +1,239 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "accounting.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <new>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+namespace Alloc {
+
+  namespace {
+
+    // fixed size, because it is updated from operator new
+    const unsigned max_tags = 64;
+
+    struct Slot {
+      const char           *name;
+      atomic<uint64_t>      allocations;
+      atomic<uint64_t>      bytes;
+    };
+    // zero-initialized, i.e. usable before any constructor did run
+    Slot             slots[max_tags];
+    atomic<unsigned> slot_count;
+    atomic<uint64_t> free_count;
+    mutex            slot_mutex;
+
+    thread_local unsigned current;
+
+    double share(uint64_t part, uint64_t whole)
+    {
+      return whole ? 100.0 * double(part) / double(whole) : 0.0;
+    }
+
+  }
+
+  Counts Counts::operator-(const Counts &o) const
+  {
+    Counts r;
+    r.allocations = allocations - o.allocations;
+    r.bytes       = bytes       - o.bytes;
+    return r;
+  }
+
+  unsigned id(const char *name)
+  {
+    lock_guard<mutex> lock(slot_mutex);
+    unsigned n = max(slot_count.load(), 1u);
+    for (unsigned i = 1; i < n; ++i)
+      if (!strcmp(slots[i].name, name))
+        return i;
+    // when all slots are taken, the allocations end up untagged
+    if (n == max_tags)
+      return 0;
+    slots[n].name = name;
+    slot_count = n + 1;
+    return n;
+  }
+
+  Tag::Tag(unsigned id)
+    :
+      prev_(current)
+  {
+    current = id;
+  }
+  Tag::~Tag()
+  {
+    current = prev_;
+  }
+
+  void count(size_t size)
+  {
+    auto &s = slots[current];
+    s.allocations.fetch_add(1, memory_order_relaxed);
+    s.bytes.fetch_add(size, memory_order_relaxed);
+  }
+  void count_free()
+  {
+    free_count.fetch_add(1, memory_order_relaxed);
+  }
+
+  Counts total()
+  {
+    Counts r;
+    for (auto &s : slots) {
+      r.allocations += s.allocations.load(memory_order_relaxed);
+      r.bytes       += s.bytes.load(memory_order_relaxed);
+    }
+    return r;
+  }
+  uint64_t frees()
+  {
+    return free_count.load(memory_order_relaxed);
+  }
+
+  std::vector<Entry> entries()
+  {
+    unsigned n = max(slot_count.load(), 1u);
+    std::vector<Entry> r;
+    r.reserve(n);
+    for (unsigned i = 0; i < n; ++i) {
+      Entry e;
+      e.name               = i ? slots[i].name : "untagged";
+      e.counts.allocations = slots[i].allocations.load(memory_order_relaxed);
+      e.counts.bytes       = slots[i].bytes.load(memory_order_relaxed);
+      r.push_back(e);
+    }
+    return r;
+  }
+
+  Counts of(const char *name)
+  {
+    for (auto &e : entries())
+      if (!strcmp(e.name, name))
+        return e.counts;
+    return Counts();
+  }
+
+  void print(std::ostream &o, size_t messages)
+  {
+    auto es = entries();
+    auto sum = total();
+    double n = messages ? double(messages) : 1.0;
+    if (!enabled())
+      o << "(built without IMAPDL_ALLOC_ACCOUNTING - no allocations counted)\n";
+    o << left << setw(16) << "tag" << right
+      << setw(12) << "allocs" << setw(7) << "%"
+      << setw(12) << "allocs/msg" << setw(12) << "bytes/msg" << '\n'
+      << fixed;
+    for (auto &e : es) {
+      if (!e.counts.allocations)
+        continue;
+      o << left << setw(16) << e.name << right
+        << setw(12) << e.counts.allocations
+        << setprecision(1) << setw(7) << share(e.counts.allocations, sum.allocations)
+        << setw(12) << (e.counts.allocations / n)
+        << setprecision(0) << setw(12) << (e.counts.bytes / n) << '\n';
+    }
+    o << left << setw(16) << "total" << right
+      << setw(12) << sum.allocations << setw(7) << ""
+      << setprecision(1) << setw(12) << (sum.allocations / n)
+      << setprecision(0) << setw(12) << (sum.bytes / n) << '\n'
+      << "frees: " << frees() << ", messages: " << messages << '\n';
+    o.unsetf(ios::floatfield);
+  }
+
+}
+
+#ifdef IMAPDL_ALLOC_ACCOUNTING
+
+// the replaceable global allocation functions, cf. [new.delete]
+
+void *operator new(size_t size)
+{
+  Alloc::count(size);
+  if (!size)
+    size = 1;
+  for (;;) {
+    void *p = malloc(size);
+    if (p)
+      return p;
+    auto handler = std::get_new_handler();
+    if (!handler)
+      throw std::bad_alloc();
+    handler();
+  }
+}
+void *operator new[](size_t size)
+{
+  return ::operator new(size);
+}
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+  try {
+    return ::operator new(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+  return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept
+{
+  if (!p)
+    return;
+  Alloc::count_free();
+  free(p);
+}
+void operator delete[](void *p) noexcept
+{
+  ::operator delete(p);
+}
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+  ::operator delete(p);
+}
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+  ::operator delete(p);
+}
+#if defined(__cpp_sized_deallocation)
+void operator delete(void *p, size_t) noexcept
+{
+  ::operator delete(p);
+}
+void operator delete[](void *p, size_t) noexcept
+{
+  ::operator delete(p);
+}
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef ALLOC_ACCOUNTING_H
+#define ALLOC_ACCOUNTING_H
+
+#include "config.h"
+
+#include <ostream>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+// Heap allocation accounting - with IMAPDL_ALLOC_ACCOUNTING (a build
+// option) the global operator new/delete count each allocation and
+// attribute it to the innermost tag of the calling thread. Without it,
+// the tags compile to nothing and the counters stay zero.
+namespace Alloc {
+
+  struct Counts {
+    uint64_t allocations {0};
+    uint64_t bytes       {0};
+
+    Counts operator-(const Counts &o) const;
+  };
+
+  struct Entry {
+    const char *name;
+    Counts      counts;
+  };
+
+  constexpr bool enabled()
+  {
+#ifdef IMAPDL_ALLOC_ACCOUNTING
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // registers a call site name, the same name yields the same id;
+  // id 0 means untagged
+  unsigned id(const char *name);
+
+  // not meant to be used directly, cf. IMAPDL_ALLOC_TAG()
+  class Tag {
+    private:
+      unsigned prev_;
+    public:
+      explicit Tag(unsigned id);
+      ~Tag();
+      Tag(const Tag &) =delete;
+      Tag &operator=(const Tag &) =delete;
+  };
+
+  void count(size_t size);
+  void count_free();
+
+  // over all threads and tags
+  Counts total();
+  uint64_t frees();
+  Counts of(const char *name);
+  std::vector<Entry> entries();
+
+  // per tag, absolute and per message
+  void print(std::ostream &o, size_t messages);
+
+}
+
+#ifdef IMAPDL_ALLOC_ACCOUNTING
+  // attributes the allocations until the end of the enclosing scope
+  // to NAME, i.e. a string literal
+  #define IMAPDL_ALLOC_TAG(NAME) \
+    static const unsigned imapdl_alloc_id_ = ::Alloc::id(NAME); \
+    ::Alloc::Tag imapdl_alloc_tag_(imapdl_alloc_id_)
+#else
+  #define IMAPDL_ALLOC_TAG(NAME) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,274 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "corpus.h"
+
+#include <random>
+#include <sstream>
+#include <stdint.h>
+
+using namespace std;
+
+namespace Bench {
+
+  namespace Corpus {
+
+    namespace {
+
+      const char base64_alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+      string base64(const string &s)
+      {
+        string r;
+        r.reserve((s.size() + 2) / 3 * 4);
+        size_t i = 0;
+        for (; i + 3 <= s.size(); i += 3) {
+          uint32_t u = uint32_t(uint8_t(s[i])) << 16
+            | uint32_t(uint8_t(s[i+1])) << 8 | uint8_t(s[i+2]);
+          r += base64_alphabet[(u >> 18) & 0x3f];
+          r += base64_alphabet[(u >> 12) & 0x3f];
+          r += base64_alphabet[(u >>  6) & 0x3f];
+          r += base64_alphabet[ u        & 0x3f];
+        }
+        if (i < s.size()) {
+          uint32_t u = uint32_t(uint8_t(s[i])) << 16;
+          if (i + 1 < s.size())
+            u |= uint32_t(uint8_t(s[i+1])) << 8;
+          r += base64_alphabet[(u >> 18) & 0x3f];
+          r += base64_alphabet[(u >> 12) & 0x3f];
+          r += i + 1 < s.size() ? base64_alphabet[(u >> 6) & 0x3f] : '=';
+          r += '=';
+        }
+        return r;
+      }
+
+      // RFC 2047, 4.2
+      string q(const string &s)
+      {
+        static const char hex[] = "0123456789ABCDEF";
+        string r;
+        r.reserve(s.size() * 2);
+        for (char c : s) {
+          uint8_t u = uint8_t(c);
+          if (c == ' ') {
+            r += '_';
+          } else if (u < 0x21 || u > 0x7e || c == '=' || c == '?' || c == '_') {
+            r += '=';
+            r += hex[u >> 4];
+            r += hex[u & 0xf];
+          } else {
+            r += c;
+          }
+        }
+        return r;
+      }
+
+      class Text {
+        private:
+          mt19937 rng_;
+        public:
+          Text(unsigned seed)
+            : rng_(seed)
+          {
+          }
+          unsigned uniform(unsigned a, unsigned b)
+          {
+            return uniform_int_distribution<unsigned>(a, b)(rng_);
+          }
+          // with some UTF-8 encoded umlauts among the ASCII letters
+          // unless ascii is set
+          string word(bool ascii)
+          {
+            static const char *const umlauts[] = {
+              "\xc3\xa4", "\xc3\xb6", "\xc3\xbc", "\xc3\x9f", "\xc3\xa9" };
+            string r;
+            unsigned n = uniform(2, 10);
+            for (unsigned i = 0; i < n; ++i) {
+              if (!ascii && uniform(0, 9) == 0)
+                r += umlauts[uniform(0, 4)];
+              else
+                r += char(uniform(0, 1) ? uniform('a', 'z') : uniform('A', 'Z'));
+            }
+            return r;
+          }
+          string words(size_t bytes, bool ascii = false)
+          {
+            string r;
+            while (r.size() < bytes) {
+              if (!r.empty())
+                r += ' ';
+              r += word(ascii);
+            }
+            return r;
+          }
+          string bytes(size_t n)
+          {
+            string r;
+            r.reserve(n);
+            for (size_t i = 0; i < n; ++i)
+              r += char(uniform(0, 255));
+            return r;
+          }
+      };
+
+    }
+
+    size_t size(const Units &units)
+    {
+      size_t r = 0;
+      for (auto &u : units)
+        r += u.size();
+      return r;
+    }
+
+    Units fetch_responses(size_t bytes, unsigned seed, Distribution d)
+    {
+      Message_Generator g(seed, d);
+      string s("* OK [CAPABILITY IMAP4 IMAP4rev1 LITERAL+ ID AUTH=PLAIN SASL-IR] "
+          "bench server ready\r\n"
+          "A001 OK [CAPABILITY IMAP4 IMAP4rev1 LITERAL+ ID UIDPLUS] "
+          "User logged in\r\n"
+          "* FLAGS (\\Answered \\Flagged \\Draft \\Deleted \\Seen)\r\n"
+          "* OK [PERMANENTFLAGS (\\Answered \\Flagged \\Draft \\Deleted \\Seen \\*)]  \r\n"
+          "* 4223 EXISTS\r\n"
+          "* 0 RECENT\r\n"
+          "* OK [UIDVALIDITY 4223]  \r\n"
+          "* OK [UIDNEXT 4224]  \r\n"
+          "A002 OK [READ-WRITE] Completed\r\n");
+      size_t literal_bytes = 0;
+      for (size_t i = 1; s.size() < bytes; ++i)
+        s += g.fetch_response(i, literal_bytes);
+      s += "A003 OK Completed\r\n";
+      return Units{s};
+    }
+
+    Units client_commands(size_t bytes, unsigned seed)
+    {
+      Text t(seed);
+      string s("a0 LOGIN juser geheimvery\r\n"
+          "a1 SELECT INBOX\r\n");
+      for (unsigned i = 2; s.size() < bytes; ++i) {
+        unsigned a = t.uniform(1, 4000);
+        unsigned b = a + t.uniform(0, 200);
+        ostringstream o;
+        o << 'a' << i << ' ';
+        switch (i % 6) {
+          case 0:
+            o << "UID FETCH " << a << ':' << b << " (UID FLAGS BODY.PEEK[HEADER.FIELDS "
+              "(date from subject message-id)] BODY.PEEK[])";
+            break;
+          case 1:
+            o << "FETCH " << a << ',' << b << ":* (FLAGS INTERNALDATE RFC822.SIZE)";
+            break;
+          case 2:
+            o << "UID STORE " << a << ':' << b << " +FLAGS.SILENT (\\Deleted \\Seen)";
+            break;
+          case 3:
+            o << "NOOP";
+            break;
+          case 4:
+            o << "UID EXPUNGE " << a << ':' << b << ',' << (b + 7);
+            break;
+          case 5:
+            o << "CHECK";
+            break;
+        }
+        o << "\r\n";
+        s += o.str();
+      }
+      return Units{s};
+    }
+
+    Units header_blocks(size_t bytes, unsigned seed)
+    {
+      Text t(seed);
+      Units r;
+      size_t n = 0;
+      while (n < bytes) {
+        ostringstream o;
+        o << "Subject: " << t.words(t.uniform(10, 40), true)
+          << " =?utf-8?B?" << base64(t.words(t.uniform(10, 40))) << "?="
+          << " =?utf-8?Q?" << q(t.words(t.uniform(10, 40))) << "?=\n"
+          << "From: =?ISO-8859-1?Q?Patrik_F=E4ltstr=F6m?= <paf@nada.kth.se>\n"
+          << "To: =?utf-8?B?" << base64(t.words(t.uniform(5, 20)))
+          << "?= <user@example.org>,\n"
+          << "    =?utf-8?Q?" << q(t.words(t.uniform(5, 20)))
+          << "?= <other@example.org>\n";
+        unsigned k = t.uniform(0, 4);
+        for (unsigned i = 0; i < k; ++i)
+          o << "Comments: =?utf-8?Q?" << q(t.words(t.uniform(20, 60))) << "?=\n"
+            << " =?utf-8?B?" << base64(t.words(t.uniform(20, 60))) << "?=\n";
+        o << "\n";
+        r.push_back(o.str());
+        n += r.back().size();
+      }
+      return r;
+    }
+
+    Units base64_runs(size_t bytes, unsigned seed)
+    {
+      Text t(seed);
+      Units r;
+      size_t n = 0;
+      while (n < bytes) {
+        r.push_back(base64(t.bytes(t.uniform(1, 16 * 1024))));
+        n += r.back().size();
+      }
+      return r;
+    }
+
+    Units q_runs(size_t bytes, unsigned seed)
+    {
+      Text t(seed);
+      Units r;
+      size_t n = 0;
+      while (n < bytes) {
+        r.push_back(q(t.words(t.uniform(1, 16 * 1024))));
+        n += r.back().size();
+      }
+      return r;
+    }
+
+    Units control_text(size_t bytes, unsigned seed)
+    {
+      static const char controls[] = "\x01\x07\x08\x0b\x0c\x1b\x7f";
+      Text t(seed);
+      Units r;
+      size_t n = 0;
+      while (n < bytes) {
+        string s;
+        while (s.size() < 64 * 1024) {
+          string field(t.words(t.uniform(20, 76)));
+          if (t.uniform(0, 9) == 0)
+            field[t.uniform(0, field.size() - 1)] =
+              controls[t.uniform(0, sizeof controls - 2)];
+          s += field;
+          s += ' ';
+        }
+        r.push_back(s);
+        n += s.size();
+      }
+      return r;
+    }
+
+  }
+
+}
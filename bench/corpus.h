@@ -0,0 +1,60 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include "message.h"
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+namespace Bench {
+
+  // Inputs for the parser microbenchmarks - each corpus consists of units
+  // that a fresh (or cleared) automaton reads from start to end, e.g.
+  // one header block or one encoded-word payload. A corpus is generated
+  // until it contains at least the requested number of bytes.
+  namespace Corpus {
+
+    using Units = std::vector<std::string>;
+
+    size_t size(const Units &units);
+
+    // server greeting, SELECT and FETCH responses with message literals
+    Units fetch_responses(size_t bytes, unsigned seed, Distribution d);
+    // LOGIN, SELECT and a mix of FETCH/STORE/NOOP commands
+    Units client_commands(size_t bytes, unsigned seed);
+    // header blocks with many B and Q encoded-words, terminated by an
+    // empty line - with LF line endings, as Copy::Header_Printer sees them
+    Units header_blocks(size_t bytes, unsigned seed);
+    // encoded-text of base64 encoded-words, i.e. without line breaks
+    Units base64_runs(size_t bytes, unsigned seed);
+    // encoded-text of Q encoded-words
+    Units q_runs(size_t bytes, unsigned seed);
+    // decoded header field bodies with sporadic control characters
+    Units control_text(size_t bytes, unsigned seed);
+
+  }
+
+}
+
+#endif
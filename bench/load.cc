@@ -0,0 +1,603 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+
+// Load generator: drives many concurrent scripted IMAP sessions against
+// a server (e.g. the example server with --maildir and --threads) and
+// reports latency percentiles per command and the aggregate throughput.
+//
+// Each thread has its own io_service and keeps its share of the
+// sessions in flight; a finished session is replaced by a new
+// connection until --rounds sessions per slot are done. The script is
+// either a plain download session or the command sequence of a recorded
+// trace - the arguments (mailbox, fetch set and attributes) then come
+// from the options, the credentials always do.
+
+#include <imap/client_base.h>
+#include <imap/client_parser.h>
+#include <net/client_application.h>
+#include <net/tcp_client.h>
+#include <trace/analyzer.h>
+#include <trace/trace.h>
+#include <buffer/buffer.h>
+#include <log/log.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/log/sources/record_ostream.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace std;
+namespace po = boost::program_options;
+namespace asio = boost::asio;
+
+namespace {
+
+  enum class Step {
+    FIRST_,
+    CONNECT = FIRST_,
+    CAPABILITY,
+    LOGIN,
+    SELECT,
+    LIST,
+    FETCH,
+    STORE,
+    EXPUNGE,
+    LOGOUT,
+    LAST_
+  };
+  const size_t steps = size_t(Step::LAST_) - size_t(Step::FIRST_);
+  const char *const step_names[steps] = {
+    "connect", "capability", "login", "select", "list",
+    "fetch", "store", "expunge", "logout"
+  };
+  const char *name_of(Step s)
+  {
+    return step_names[size_t(s) - size_t(Step::FIRST_)];
+  }
+
+  // the commands without an equivalent in IMAP::Client::Base (e.g. ID,
+  // NOOP) are skipped
+  bool step_of(const string &command, Step &s)
+  {
+    static const pair<const char*, Step> m[] = {
+      { "CAPABILITY"  , Step::CAPABILITY },
+      { "LOGIN"       , Step::LOGIN      },
+      { "AUTHENTICATE", Step::LOGIN      },
+      { "SELECT"      , Step::SELECT     },
+      { "EXAMINE"     , Step::SELECT     },
+      { "LIST"        , Step::LIST       },
+      { "LSUB"        , Step::LIST       },
+      { "FETCH"       , Step::FETCH      },
+      { "UID FETCH"   , Step::FETCH      },
+      { "STORE"       , Step::STORE      },
+      { "UID STORE"   , Step::STORE      },
+      { "EXPUNGE"     , Step::EXPUNGE    },
+      { "UID EXPUNGE" , Step::EXPUNGE    },
+      { "CLOSE"       , Step::EXPUNGE    },
+      { "LOGOUT"      , Step::LOGOUT     }
+    };
+    for (auto &i : m)
+      if (command == i.first) {
+        s = i.second;
+        return true;
+      }
+    return false;
+  }
+
+  struct Options {
+    Net::TCP::SSL::Client::Options net;
+    bool     use_ssl    {true};
+    string   username;
+    string   password;
+    string   mailbox    {"INBOX"};
+    size_t   sessions   {100};
+    unsigned threads    {1};
+    size_t   rounds     {1};
+    string   script;
+    string   fetch      {"full"};
+    uint32_t fetch_count {0};
+    string   json;
+
+    Options(int argc, char **argv);
+  };
+  Options::Options(int argc, char **argv)
+  {
+    net.service  = "imaps";
+    net.ca_file  = "/etc/ssl/certs/ca-bundle.crt";
+    net.severity = Log::ERROR;
+    net.file_severity = Log::ERROR;
+
+    po::options_description desc("Options");
+    desc.add_options()
+      ("help,h", "this help screen")
+      ("host", po::value<string>(&net.host)->required(), "IMAP server")
+      ("service", po::value<string>(&net.service)->default_value(net.service),
+       "service name or port")
+      ("ssl", po::value<bool>(&use_ssl)->default_value(use_ssl),
+       "use TLS (i.e. IMAPS)")
+      ("fingerprint", po::value<string>(&net.fingerprint),
+       "SHA1 fingerprint of the server certificate - instead of CA verification")
+      ("ca", po::value<string>(&net.ca_file)->default_value(net.ca_file),
+       "CA file")
+      ("cert_host", po::value<string>(&net.cert_host),
+       "expected certificate hostname (default: --host)")
+      ("user", po::value<string>(&username)->required(), "account name")
+      ("pw", po::value<string>(&password)->required(), "account password")
+      ("mailbox", po::value<string>(&mailbox)->default_value(mailbox),
+       "mailbox to select")
+      ("sessions", po::value<size_t>(&sessions)->default_value(sessions),
+       "number of concurrent sessions")
+      ("threads", po::value<unsigned>(&threads)->default_value(threads),
+       "number of threads - each with its own io_service")
+      ("rounds", po::value<size_t>(&rounds)->default_value(rounds),
+       "number of consecutive sessions per concurrent session")
+      ("script", po::value<string>(&script),
+       "derive the command sequence from this trace file "
+       "(default: capability, login, select, fetch, logout)")
+      ("fetch", po::value<string>(&fetch)->default_value(fetch),
+       "fetch attributes: full (UID, FLAGS, BODY.PEEK[]) or header "
+       "(UID, FLAGS and some header fields)")
+      ("fetch_count", po::value<uint32_t>(&fetch_count)->default_value(fetch_count),
+       "fetch the first n messages - 0 means all")
+      ("severity", po::value<unsigned>(&net.severity)->default_value(net.severity),
+       "console log severity")
+      ("json", po::value<string>(&json)->default_value(""),
+       "also write the results as JSON to this file (- means stdout)")
+      ;
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.count("help")) {
+      cout << "call: " << *argv << " OPTION*\n" << desc << '\n';
+      exit(0);
+    }
+    po::notify(vm);
+    if (!(fetch == "full" || fetch == "header"))
+      throw invalid_argument("unknown fetch attributes: " + fetch);
+    if (!sessions || !threads)
+      throw invalid_argument("need at least one session and one thread");
+    if (net.cert_host.empty())
+      net.cert_host = net.host;
+  }
+
+  vector<Step> default_script()
+  {
+    return { Step::CAPABILITY, Step::LOGIN, Step::SELECT, Step::FETCH,
+      Step::LOGOUT };
+  }
+
+  vector<Step> read_script(const string &filename)
+  {
+    Trace::Reader reader(filename);
+    Trace::Analyzer analyzer;
+    for (;;) {
+      Trace::Record_View r(reader.next());
+      if (r.type == Trace::Type::END_OF_FILE)
+        break;
+      analyzer.push(r);
+    }
+    vector<Step> r;
+    for (auto &c : analyzer.commands()) {
+      Step s;
+      if (step_of(c.name, s))
+        r.push_back(s);
+    }
+    if (r.empty())
+      throw runtime_error("no replayable commands in: " + filename);
+    if (r.back() != Step::LOGOUT)
+      r.push_back(Step::LOGOUT);
+    return r;
+  }
+
+  // all latencies are in us
+  struct Stats {
+    array<vector<uint64_t>, steps> latencies;
+    size_t   sessions {0};
+    size_t   failed   {0};
+    size_t   bytes    {0};
+    string   first_error;
+
+    void record(Step s, chrono::steady_clock::duration d)
+    {
+      latencies[size_t(s) - size_t(Step::FIRST_)].push_back(
+          chrono::duration_cast<chrono::microseconds>(d).count());
+    }
+    void fail(const string &msg)
+    {
+      ++failed;
+      if (first_error.empty())
+        first_error = msg;
+    }
+    Stats &operator+=(const Stats &o)
+    {
+      for (size_t i = 0; i < steps; ++i)
+        latencies[i].insert(latencies[i].end(),
+            o.latencies[i].begin(), o.latencies[i].end());
+      sessions += o.sessions;
+      failed   += o.failed;
+      bytes    += o.bytes;
+      if (first_error.empty())
+        first_error = o.first_error;
+      return *this;
+    }
+  };
+
+  // nearest rank on a sorted vector
+  uint64_t percentile(const vector<uint64_t> &v, double p)
+  {
+    if (v.empty())
+      return 0;
+    size_t i = size_t(p * v.size() + 0.999999);
+    return v[std::min(std::max(i, size_t(1)), v.size()) - 1];
+  }
+
+  class Session : public IMAP::Client::Base {
+    private:
+      const Options                        &opts_;
+      const vector<Step>                   &script_;
+      Stats                                &stats_;
+      std::function<void(void)>             done_;
+      unique_ptr<Net::Client::Base>         client_;
+      Net::Client::Application              app_;
+      Memory::Buffer::Proxy                 buffer_proxy_;
+      IMAP::Client::Parser                  parser_;
+      vector<pair<uint32_t, uint32_t> >     set_;
+      vector<IMAP::Client::Fetch_Attribute> atts_;
+      size_t                                pos_      {0};
+      bool                                  closing_  {false};
+      bool                                  reading_  {false};
+      bool                                  finished_ {false};
+
+      void do_read();
+      void do_step();
+      void do_finish();
+      void fail(const string &msg);
+      void maybe_done();
+      void write_command(vector<char> &cmd);
+    public:
+      Session(asio::io_service &io_service, asio::ssl::context &context,
+          const Options &opts, const vector<Step> &script, Stats &stats,
+          boost::log::sources::severity_logger<Log::Severity> &lg,
+          std::function<void(void)> done);
+  };
+
+  Session::Session(asio::io_service &io_service, asio::ssl::context &context,
+      const Options &opts, const vector<Step> &script, Stats &stats,
+      boost::log::sources::severity_logger<Log::Severity> &lg,
+      std::function<void(void)> done)
+    :
+      IMAP::Client::Base(std::bind(&Session::write_command, this,
+            std::placeholders::_1), lg),
+      opts_(opts),
+      script_(script),
+      stats_(stats),
+      done_(done),
+      client_(opts_.use_ssl
+          ? static_cast<Net::Client::Base*>(
+            new Net::TCP::SSL::Client::Base(io_service, context, opts_.net, lg,
+              false))
+          : static_cast<Net::Client::Base*>(
+            new Net::TCP::Client::Base(io_service, opts_.net, lg))),
+      app_(opts_.net.host, *client_, lg),
+      parser_(buffer_proxy_, tag_buffer_, *this),
+      set_{{1, opts_.fetch_count ? opts_.fetch_count
+        : numeric_limits<uint32_t>::max()}}
+  {
+    buffer_proxy_.set(&buffer_);
+    using namespace IMAP::Client;
+    atts_.emplace_back(Fetch::UID);
+    atts_.emplace_back(Fetch::FLAGS);
+    if (opts_.fetch == "header") {
+      vector<string> fields = { "date", "from", "subject" };
+      atts_.emplace_back(Fetch::BODY_PEEK,
+          IMAP::Section_Attribute(IMAP::Section::HEADER_FIELDS, std::move(fields)));
+    } else {
+      atts_.emplace_back(Fetch::BODY_PEEK);
+    }
+    auto start = chrono::steady_clock::now();
+    app_.async_start([this, start](){
+        stats_.record(Step::CONNECT, chrono::steady_clock::now() - start);
+        reading_ = true;
+        do_read();
+        do_step();
+      });
+  }
+
+  void Session::write_command(vector<char> &cmd)
+  {
+    client_->push_write(cmd);
+  }
+
+  void Session::do_read()
+  {
+    client_->async_read_some([this](const boost::system::error_code &ec,
+          size_t size)
+        {
+          if (ec) {
+            reading_ = false;
+            if (closing_)
+              maybe_done();
+            else
+              fail(ec.message());
+            return;
+          }
+          stats_.bytes += size;
+          try {
+            parser_.read(client_->input().data(), client_->input().data() + size);
+          } catch (const std::exception &e) {
+            reading_ = false;
+            fail(e.what());
+            return;
+          }
+          if (closing_) {
+            reading_ = false;
+            maybe_done();
+          } else {
+            do_read();
+          }
+        });
+  }
+
+  void Session::do_step()
+  {
+    if (pos_ == script_.size()) {
+      do_finish();
+      return;
+    }
+    Step s = script_[pos_++];
+    auto start = chrono::steady_clock::now();
+    auto fn = [this, s, start](){
+      stats_.record(s, chrono::steady_clock::now() - start);
+      do_step();
+    };
+    switch (s) {
+      case Step::CAPABILITY: async_capabilities(fn); break;
+      case Step::LOGIN     : async_login(opts_.username, opts_.password, fn); break;
+      case Step::SELECT    : async_select(opts_.mailbox, fn); break;
+      case Step::LIST      : async_list("", "*", fn); break;
+      case Step::FETCH     : async_fetch(set_, atts_, fn); break;
+      case Step::STORE     : async_store(set_, { IMAP::Flag::SEEN }, fn); break;
+      case Step::EXPUNGE   : async_expunge(fn); break;
+      case Step::LOGOUT    : async_logout(fn); break;
+      default: do_step();
+    }
+  }
+
+  void Session::do_finish()
+  {
+    closing_ = true;
+    app_.async_finish([this](){
+        ++stats_.sessions;
+        finished_ = true;
+        maybe_done();
+      });
+  }
+
+  void Session::fail(const string &msg)
+  {
+    stats_.fail(msg);
+    closing_  = true;
+    finished_ = true;
+    client_->close();
+    maybe_done();
+  }
+
+  void Session::maybe_done()
+  {
+    if (finished_ && !reading_) {
+      finished_ = false;
+      done_();
+    }
+  }
+
+  // keeps opts.sessions / opts.threads sessions in flight on its own
+  // io_service
+  class Runner {
+    private:
+      const Options                                       &opts_;
+      const vector<Step>                                  &script_;
+      boost::log::sources::severity_logger<Log::Severity>  lg_;
+      asio::io_service                                     io_service_ {1};
+      asio::ssl::context                                   context_;
+      vector<unique_ptr<Session> >                         slots_;
+      size_t                                               left_;
+      Stats                                                stats_;
+
+      void start(size_t slot);
+    public:
+      Runner(const Options &opts, const vector<Step> &script, size_t sessions,
+          const boost::log::sources::severity_logger<Log::Severity> &lg);
+      void run();
+      const Stats &stats() const;
+  };
+
+  Runner::Runner(const Options &opts, const vector<Step> &script,
+      size_t sessions,
+      const boost::log::sources::severity_logger<Log::Severity> &lg)
+    :
+      opts_(opts),
+      script_(script),
+      lg_(lg),
+      context_(asio::ssl::context::sslv23),
+      slots_(sessions),
+      left_(sessions * opts.rounds)
+  {
+    // once - the sessions share the context, thus they don't re-read
+    // the CA file and don't modify it while others are using it
+    if (opts_.use_ssl)
+      opts_.net.apply(context_);
+  }
+
+  void Runner::start(size_t slot)
+  {
+    // replaces the previous session of the slot - which is done, i.e. it
+    // has no outstanding handlers
+    slots_[slot].reset();
+    if (!left_)
+      return;
+    --left_;
+    slots_[slot].reset(new Session(io_service_, context_, opts_, script_,
+          stats_, lg_, [this, slot](){
+            io_service_.post([this, slot](){ start(slot); });
+          }));
+  }
+
+  void Runner::run()
+  {
+    for (size_t i = 0; i < slots_.size(); ++i)
+      start(i);
+    // errors outside of a session (e.g. resolve or connect) leave just
+    // that slot idle
+    for (;;) {
+      try {
+        io_service_.run();
+        break;
+      } catch (const std::exception &e) {
+        stats_.fail(e.what());
+      }
+    }
+    slots_.clear();
+  }
+
+  const Stats &Runner::stats() const
+  {
+    return stats_;
+  }
+
+  void print(ostream &o, Stats &stats, double seconds)
+  {
+    o << "sessions: " << stats.sessions << " (" << stats.failed << " failed) in "
+      << fixed << setprecision(3) << seconds << " s - "
+      << (stats.sessions / seconds) << " sessions/s, "
+      << (stats.bytes / seconds / 1024.0 / 1024.0) << " MiB/s\n";
+    if (!stats.first_error.empty())
+      o << "first error: " << stats.first_error << '\n';
+    o << setw(12) << left << "command" << right
+      << setw(10) << "count"
+      << setw(10) << "p50 ms" << setw(10) << "p90 ms"
+      << setw(10) << "p99 ms" << setw(10) << "max ms" << '\n';
+    for (size_t i = 0; i < steps; ++i) {
+      auto &v = stats.latencies[i];
+      if (v.empty())
+        continue;
+      o << setw(12) << left << step_names[i] << right
+        << setw(10) << v.size()
+        << setw(10) << percentile(v, 0.5)  / 1e3
+        << setw(10) << percentile(v, 0.9)  / 1e3
+        << setw(10) << percentile(v, 0.99) / 1e3
+        << setw(10) << v.back()            / 1e3 << '\n';
+    }
+    o.unsetf(ios::floatfield);
+  }
+
+  void print_json(ostream &o, const Options &opts, const Stats &stats,
+      double seconds)
+  {
+    o << "{\n"
+      << "  \"concurrency\": " << opts.sessions << ",\n"
+      << "  \"threads\": " << opts.threads << ",\n"
+      << "  \"sessions\": " << stats.sessions << ",\n"
+      << "  \"failed\": " << stats.failed << ",\n"
+      << "  \"bytes\": " << stats.bytes << ",\n"
+      << "  \"seconds\": " << seconds << ",\n"
+      << "  \"sessions_per_second\": " << (stats.sessions / seconds) << ",\n"
+      << "  \"mib_per_second\": " << (stats.bytes / seconds / 1024.0 / 1024.0) << ",\n"
+      << "  \"commands\": {";
+    bool first = true;
+    for (size_t i = 0; i < steps; ++i) {
+      auto &v = stats.latencies[i];
+      if (v.empty())
+        continue;
+      o << (first ? "" : ",") << "\n    \"" << step_names[i] << "\": { "
+        << "\"count\": " << v.size()
+        << ", \"p50_us\": " << percentile(v, 0.5)
+        << ", \"p90_us\": " << percentile(v, 0.9)
+        << ", \"p99_us\": " << percentile(v, 0.99)
+        << ", \"max_us\": " << v.back() << " }";
+      first = false;
+    }
+    o << "\n  }\n}\n";
+  }
+
+}
+
+int main(int argc, char **argv)
+{
+  try {
+    Options opts(argc, argv);
+    vector<Step> script(opts.script.empty() ? default_script()
+        : read_script(opts.script));
+    boost::log::sources::severity_logger<Log::Severity> lg(Log::create(
+          static_cast<Log::Severity>(opts.net.severity),
+          static_cast<Log::Severity>(opts.net.file_severity)));
+
+    vector<unique_ptr<Runner> > runners;
+    for (unsigned i = 0; i < opts.threads; ++i) {
+      size_t n = opts.sessions / opts.threads
+        + (i < opts.sessions % opts.threads ? 1 : 0);
+      runners.emplace_back(new Runner(opts, script, n, lg));
+    }
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (auto &r : runners)
+      threads.emplace_back(&Runner::run, r.get());
+    for (auto &t : threads)
+      t.join();
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    Log::finish();
+
+    Stats stats;
+    for (auto &r : runners)
+      stats += r->stats();
+    for (auto &v : stats.latencies)
+      sort(v.begin(), v.end());
+
+    print(cout, stats, seconds);
+    if (opts.json == "-") {
+      print_json(cout, opts, stats, seconds);
+    } else if (!opts.json.empty()) {
+      ofstream f;
+      f.exceptions(ofstream::failbit | ofstream::badbit);
+      f.open(opts.json);
+      print_json(f, opts, stats, seconds);
+    }
+    return stats.failed ? 1 : 0;
+  } catch (const exception &e) {
+    cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+}
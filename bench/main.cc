@@ -0,0 +1,326 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+
+// End-to-end throughput benchmark: the example server replays a synthetic
+// session to IMAP::Copy::Client that downloads it into a maildir
+// (preferably on a tmpfs). With the loopback transport the session is
+// served from memory instead, i.e. without sockets, TLS and the server
+// thread.
+
+#include "session.h"
+
+#include <copy/client.h>
+#include <copy/options.h>
+#include <example/server.h>
+#include <log/log.h>
+#include <net/loopback_client.h>
+
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+#include <sys/resource.h>
+
+using namespace std;
+namespace po = boost::program_options;
+namespace fs = boost::filesystem;
+
+namespace {
+
+  const char username[]    = "juser123";
+  const char password[]    = "muchvery";
+  // of unittest/server.crt
+  const char fingerprint[] = "ED77CA3CE8B917C3F081FEC35C316E17E7879D35";
+
+  struct Options {
+    size_t   count  {100};
+    string   distribution {"mixed"};
+    unsigned seed   {23};
+    vector<string> transports {"tcp", "tls"};
+    string   dir    {"/dev/shm/imapdl-bench"};
+    string   prefix;
+    unsigned port   {6667};
+    string   json;
+
+    Options(int argc, char **argv);
+  };
+  Options::Options(int argc, char **argv)
+  {
+    const char *p = getenv("UT_PREFIX");
+    prefix = p ? p : "../unittest";
+
+    po::options_description desc("Options");
+    desc.add_options()
+      ("help,h", "this help screen")
+      ("count", po::value<size_t>(&count)->default_value(count),
+       "number of messages")
+      ("size", po::value<string>(&distribution)->default_value(distribution),
+       "message size distribution: tiny, typical, large or mixed")
+      ("seed", po::value<unsigned>(&seed)->default_value(seed),
+       "seed of the message generator")
+      ("transport", po::value<vector<string> >(&transports)->multitoken(),
+       "run over these transports: tcp, tls and/or loopback "
+       "(default: tcp tls)")
+      ("dir", po::value<string>(&dir)->default_value(dir),
+       "work directory for the trace and the maildir - should be on a tmpfs")
+      ("prefix", po::value<string>(&prefix)->default_value(prefix),
+       "directory containing server.key, server.crt and dh1024.pem "
+       "(default: $UT_PREFIX or ../unittest)")
+      ("port", po::value<unsigned>(&port)->default_value(port),
+       "port of the replay server")
+      ("json", po::value<string>(&json)->default_value(""),
+       "also write the results as JSON to this file (- means stdout)")
+      ;
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.count("help")) {
+      cout << "call: " << *argv << " OPTION*\n" << desc << '\n';
+      exit(0);
+    }
+    po::notify(vm);
+    for (auto &t : transports)
+      if (!(t == "tcp" || t == "tls" || t == "loopback"))
+        throw invalid_argument("unknown transport: " + t);
+  }
+
+  struct Result {
+    string transport;
+    size_t messages     {0};
+    size_t bytes        {0};
+    double seconds      {0};
+    double user_seconds {0};
+    double sys_seconds  {0};
+    // peak of the whole process so far, i.e. of all preceding runs, too
+    long   process_peak_rss_kb {0};
+  };
+
+  double to_seconds(const timeval &t)
+  {
+    return double(t.tv_sec) + double(t.tv_usec) / 1e6;
+  }
+
+  void write_rc(const string &filename, const Options &opts, const string &maildir)
+  {
+    ofstream f;
+    f.exceptions(ofstream::failbit | ofstream::badbit);
+    f.open(filename);
+    f << "{\n  \"bench\":\n  {\n"
+      << "    \"username\"    : \"" << username << "\",\n"
+      << "    \"password\"    : \"" << password << "\",\n"
+      << "    \"host\"        : \"localhost\",\n"
+      << "    \"port\"        : \"" << opts.port << "\",\n"
+      << "    \"fingerprint\" : \"" << fingerprint << "\",\n"
+      << "    \"maildir\"     : \"" << maildir << "\",\n"
+      << "    \"delete\"      : false\n"
+      << "  }\n}\n";
+  }
+
+  Result run(const Options &opts, const string &trace, const string &transport)
+  {
+    bool use_tls = transport == "tls";
+    bool loopback = transport == "loopback";
+    string maildir(opts.dir + "/maildir");
+    fs::remove_all(maildir);
+    string rc(opts.dir + "/rc.json");
+    write_rc(rc, opts, maildir);
+
+    Server::Options sopts;
+    sopts.use_ssl    = use_tls;
+    sopts.key        = opts.prefix + "/server.key";
+    sopts.cert       = opts.prefix + "/server.crt";
+    sopts.dhparam    = opts.prefix + "/dh1024.pem";
+    sopts.replayfile = trace;
+    sopts.use_replay = true;
+    sopts.port       = opts.port;
+    // the replay server is chatty
+    ostream null_out(nullptr);
+    boost::asio::io_service server_io_service;
+    // listens after construction, thus no race with the client
+    unique_ptr<Server::Main> server;
+    if (!loopback)
+      server = unique_ptr<Server::Main>(
+          new Server::Main(server_io_service, sopts, null_out));
+
+    string journal(opts.dir + "/journal");
+    char *argv[] = {
+      (char*)"imapdl", (char*)"--account", (char*)"bench",
+      (char*)"--config", (char*)rc.c_str(),
+      (char*)"--ssl", (char*)(use_tls ? "yes" : "no"),
+      (char*)"-v0",
+      (char*)"--journal", (char*)journal.c_str(),
+      (char*)"--flight_recorder", (char*)"0",
+      0
+    };
+    int argc = sizeof(argv)/sizeof(char*)-1;
+    IMAP::Copy::Options copts(argc, argv);
+    boost::log::sources::severity_logger<Log::Severity> lg(Log::create(
+          static_cast<Log::Severity>(copts.severity),
+          static_cast<Log::Severity>(copts.file_severity),
+          copts.logfile));
+    Net::Loopback::Client::Options lopts;
+    lopts.severity      = copts.severity;
+    lopts.file_severity = copts.file_severity;
+    lopts.script        = trace;
+
+    Result r;
+    r.transport = transport;
+    string error;
+    thread server_thread;
+    if (server)
+      server_thread = thread([&server_io_service, &error]() {
+          try {
+            server_io_service.run();
+          } catch (const exception &e) {
+            error = e.what();
+          }
+        });
+
+    rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    auto start = chrono::steady_clock::now();
+    try {
+      boost::asio::io_service io_service;
+      boost::asio::ssl::context context(boost::asio::ssl::context::sslv23);
+      unique_ptr<Net::Client::Base> net_client;
+      if (loopback)
+        net_client = unique_ptr<Net::Client::Base>(
+            new Net::Loopback::Client::Base(io_service, lopts, lg));
+      else if (use_tls)
+        net_client = unique_ptr<Net::Client::Base>(
+            new Net::TCP::SSL::Client::Base(io_service, context, copts, lg));
+      else
+        net_client = unique_ptr<Net::Client::Base>(
+            new Net::TCP::Client::Base(io_service, copts, lg));
+      IMAP::Copy::Client client(copts, *net_client, lg);
+      io_service.run();
+    } catch (...) {
+      if (server_thread.joinable()) {
+        server_io_service.stop();
+        server_thread.join();
+      }
+      throw;
+    }
+    auto stop = chrono::steady_clock::now();
+    if (server_thread.joinable())
+      server_thread.join();
+    getrusage(RUSAGE_SELF, &after);
+    Log::finish();
+    if (!error.empty())
+      throw runtime_error("replay server: " + error);
+
+    r.seconds      = chrono::duration<double>(stop - start).count();
+    // includes the server thread
+    r.user_seconds = to_seconds(after.ru_utime) - to_seconds(before.ru_utime);
+    r.sys_seconds  = to_seconds(after.ru_stime) - to_seconds(before.ru_stime);
+    r.process_peak_rss_kb = after.ru_maxrss;
+    for (fs::directory_iterator i(maildir + "/new"), e; i != e; ++i) {
+      ++r.messages;
+      r.bytes += fs::file_size(i->path());
+    }
+    return r;
+  }
+
+  void print_json(ostream &o, const Options &opts, const Bench::Session_Stats &stats,
+      const vector<Result> &results)
+  {
+    o << "{\n"
+      << "  \"count\": " << opts.count << ",\n"
+      << "  \"distribution\": \"" << opts.distribution << "\",\n"
+      << "  \"seed\": " << opts.seed << ",\n"
+      << "  \"literal_bytes\": " << stats.bytes << ",\n"
+      << "  \"runs\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+      auto &r = results[i];
+      o << "    {\n"
+        << "      \"transport\": \"" << r.transport << "\",\n"
+        << "      \"messages\": " << r.messages << ",\n"
+        << "      \"bytes\": " << r.bytes << ",\n"
+        << "      \"seconds\": " << r.seconds << ",\n"
+        << "      \"messages_per_second\": " << (r.messages / r.seconds) << ",\n"
+        << "      \"mb_per_second\": " << (r.bytes / r.seconds / 1e6) << ",\n"
+        << "      \"cpu_user_seconds\": " << r.user_seconds << ",\n"
+        << "      \"cpu_sys_seconds\": " << r.sys_seconds << ",\n"
+        << "      \"process_peak_rss_kb\": " << r.process_peak_rss_kb << "\n"
+        << "    }" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    o << "  ]\n}\n";
+  }
+
+}
+
+int main(int argc, char **argv)
+{
+  try {
+    Options opts(argc, argv);
+    fs::create_directories(opts.dir);
+
+    Bench::Session_Options sopts;
+    sopts.count        = opts.count;
+    sopts.distribution = Bench::to_distribution(opts.distribution);
+    sopts.seed         = opts.seed;
+    sopts.username     = username;
+    sopts.password     = password;
+    string trace(opts.dir + "/session.trace");
+    auto stats = Bench::generate(trace, sopts);
+
+    vector<Result> results;
+    for (auto &t : opts.transports)
+      results.push_back(run(opts, trace, t));
+
+    cout << "messages: " << stats.messages << " (" << opts.distribution
+      << "), literal bytes: " << stats.bytes << '\n';
+    for (auto &r : results) {
+      cout << setw(8) << left << r.transport << right << fixed << setprecision(3)
+        << ": " << r.seconds << " s, "
+        << (r.messages / r.seconds) << " msg/s, "
+        << (r.bytes / r.seconds / 1e6) << " MB/s, cpu "
+        << r.user_seconds << " s user " << r.sys_seconds << " s sys, "
+        << "process peak RSS " << r.process_peak_rss_kb << " KiB\n";
+      if (r.messages != stats.messages)
+        throw runtime_error("not all messages were downloaded");
+    }
+    cout.unsetf(ios::floatfield);
+    if (opts.json == "-") {
+      print_json(cout, opts, stats, results);
+    } else if (!opts.json.empty()) {
+      ofstream f;
+      f.exceptions(ofstream::failbit | ofstream::badbit);
+      f.open(opts.json);
+      print_json(f, opts, stats, results);
+    }
+    fs::remove_all(opts.dir + "/maildir");
+  } catch (const exception &e) {
+    cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,134 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "message.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+namespace Bench {
+
+  Distribution to_distribution(const std::string &s)
+  {
+    if (s == "tiny")
+      return Distribution::TINY;
+    if (s == "typical")
+      return Distribution::TYPICAL;
+    if (s == "large")
+      return Distribution::LARGE;
+    if (s == "mixed")
+      return Distribution::MIXED;
+    throw invalid_argument("unknown size distribution: " + s);
+  }
+  const char *name(Distribution d)
+  {
+    switch (d) {
+      case Distribution::TINY:    return "tiny";
+      case Distribution::TYPICAL: return "typical";
+      case Distribution::LARGE:   return "large";
+      case Distribution::MIXED:   return "mixed";
+    }
+    return "";
+  }
+
+  Message_Generator::Message_Generator(unsigned seed, Distribution d)
+    : rng_(seed), distribution_(d)
+  {
+  }
+  size_t Message_Generator::tiny()
+  {
+    return uniform_int_distribution<size_t>(512, 2048)(rng_);
+  }
+  size_t Message_Generator::typical()
+  {
+    double x = lognormal_distribution<double>(log(20000.0), 1.0)(rng_);
+    return size_t(std::min(std::max(x, 2048.0), 256.0 * 1024));
+  }
+  size_t Message_Generator::large()
+  {
+    return uniform_int_distribution<size_t>(1024 * 1024, 8 * 1024 * 1024)(rng_);
+  }
+  size_t Message_Generator::size()
+  {
+    switch (distribution_) {
+      case Distribution::TINY:    return tiny();
+      case Distribution::TYPICAL: return typical();
+      case Distribution::LARGE:   return large();
+      case Distribution::MIXED:
+        {
+          unsigned x = uniform_int_distribution<unsigned>(0, 99)(rng_);
+          if (x < 60)
+            return tiny();
+          if (x < 95)
+            return typical();
+          return large();
+        }
+    }
+    return 0;
+  }
+  // printable, without the IMAP/MIME special cases
+  void Message_Generator::fill_line(string &s, size_t n)
+  {
+    static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789 .,";
+    uniform_int_distribution<unsigned> d(0, sizeof alphabet - 2);
+    for (size_t i = 0; i < n; ++i)
+      s.push_back(alphabet[d(rng_)]);
+    s += "\r\n";
+  }
+  std::string Message_Generator::fetch_response(size_t i, size_t &literal_bytes)
+  {
+    ostringstream h;
+    h << "Date: Sat, 3 May 2014 22:27:17 +0200\r\n"
+      << "From: Bench <bench@example.org>\r\n"
+      << "Subject: message " << i << "\r\n";
+    string fields(h.str());
+    ostringstream m;
+    m << fields
+      << "To: user@example.org\r\n"
+      << "Message-ID: <" << i << ".bench@example.org>\r\n"
+      << "MIME-Version: 1.0\r\n"
+      << "Content-Type: text/plain; charset=us-ascii\r\n"
+      << "\r\n";
+    fields += "\r\n";
+    string msg(m.str());
+    size_t n = std::max(size(), msg.size() + 3);
+    msg.reserve(n);
+    while (msg.size() < n) {
+      size_t k = std::min<size_t>(76, n - msg.size());
+      fill_line(msg, k < 3 ? 0 : k - 2);
+    }
+    ostringstream o;
+    o << "* " << i << " FETCH (FLAGS (\\Recent) UID " << i
+      << " BODY[HEADER.FIELDS (date from subject)] {" << fields.size() << "}\r\n"
+      << fields
+      << " BODY[] {" << msg.size() << "}\r\n";
+    string r(o.str());
+    r += msg;
+    r += ")\r\n";
+    literal_bytes += msg.size();
+    return r;
+  }
+
+}
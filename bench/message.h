@@ -0,0 +1,59 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef BENCH_MESSAGE_H
+#define BENCH_MESSAGE_H
+
+#include <random>
+#include <string>
+#include <stddef.h>
+
+namespace Bench {
+
+  enum class Distribution {
+    TINY,    // 0.5 to 2 KiB
+    TYPICAL, // log-normal around 20 KiB
+    LARGE,   // 1 to 8 MiB, i.e. attachments
+    MIXED    // 60 % tiny, 35 % typical, 5 % large
+  };
+  Distribution to_distribution(const std::string &s);
+  const char *name(Distribution d);
+
+  // Synthetic messages with CRLF line endings, as an IMAP server sends them
+  class Message_Generator {
+    private:
+      std::mt19937 rng_;
+      Distribution distribution_;
+
+      size_t tiny();
+      size_t typical();
+      size_t large();
+      void fill_line(std::string &s, size_t n);
+    public:
+      Message_Generator(unsigned seed, Distribution d);
+      size_t size();
+      // untagged FETCH response of message i with a header fields literal
+      // and a body literal - the size of the latter is added to literal_bytes
+      std::string fetch_response(size_t i, size_t &literal_bytes);
+  };
+
+}
+
+#endif
@@ -0,0 +1,363 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+
+// Microbenchmark of the Ragel generated automata: each one reads a synthetic
+// corpus in chunks of different sizes (as they arrive from the network)
+// and the throughput is reported in bytes per cycle and MB/s.
+//
+// The build creates one executable per Ragel code generation style
+// (parser_bench_T0, parser_bench_F1, parser_bench_G2) such that the styles
+// can be compared side by side, e.g. via the run_parser_bench target.
+
+#include "corpus.h"
+
+#include <imap/client_parser.h>
+#include <imap/server_parser.h>
+#include <mime/header_decoder.h>
+#include <mime/base64_decoder.h>
+#include <mime/q_decoder.h>
+#include <ascii/control_sanitizer.h>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#endif
+
+// set by the build system to the ragel code generation option, e.g. G2
+#ifndef IMAPDL_RAGEL_STYLE
+  #define IMAPDL_RAGEL_STYLE T0
+#endif
+#define IMAPDL_STR_(x) #x
+#define IMAPDL_STR(x) IMAPDL_STR_(x)
+
+using namespace std;
+namespace po = boost::program_options;
+using namespace Memory;
+
+namespace {
+
+  struct Options {
+    size_t         size_mib     {16};
+    string         distribution {"mixed"};
+    unsigned       seed         {23};
+    unsigned       repeat       {5};
+    vector<size_t> chunks       {1, 16, 256, 4096, 65536};
+    vector<string> machines;
+    string         json;
+
+    Options(int argc, char **argv);
+  };
+  Options::Options(int argc, char **argv)
+  {
+    po::options_description desc("Options");
+    desc.add_options()
+      ("help,h", "this help screen")
+      ("size", po::value<size_t>(&size_mib)->default_value(size_mib),
+       "corpus size per automaton in MiB")
+      ("messages", po::value<string>(&distribution)->default_value(distribution),
+       "message size distribution of the FETCH corpus: "
+       "tiny, typical, large or mixed")
+      ("seed", po::value<unsigned>(&seed)->default_value(seed),
+       "seed of the corpus generator")
+      ("repeat", po::value<unsigned>(&repeat)->default_value(repeat),
+       "runs per measurement, the fastest one is reported")
+      ("chunk", po::value<vector<size_t> >(&chunks)->multitoken(),
+       "chunk sizes in bytes (default: 1 16 256 4096 65536)")
+      ("machine", po::value<vector<string> >(&machines)->multitoken(),
+       "only run these automata: client, client_raw, server, header, "
+       "base64, q, sanitizer")
+      ("json", po::value<string>(&json)->default_value(""),
+       "also write the results as JSON to this file (- means stdout)")
+      ;
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    if (vm.count("help")) {
+      cout << "call: " << *argv << " OPTION*\n" << desc << '\n';
+      exit(0);
+    }
+    po::notify(vm);
+    if (!repeat)
+      throw invalid_argument("--repeat must be at least 1");
+    for (auto c : chunks)
+      if (!c)
+        throw invalid_argument("chunk size must be greater than 0");
+  }
+
+  // time stamp counter, i.e. reference cycles - 0 where unavailable
+  uint64_t cycles()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  template <typename Machine>
+    void feed(Machine &m, const string &unit, size_t chunk)
+    {
+      const char *p = unit.data();
+      const char *e = p + unit.size();
+      while (p < e) {
+        const char *q = p + std::min(chunk, size_t(e - p));
+        m.read(p, q);
+        p = q;
+      }
+    }
+
+  struct Client_Callback : public IMAP::Client::Callback::Null {
+    Buffer::Vector        buffer;
+    Buffer::Vector        tag_buffer;
+    IMAP::Client::Parser *parser    {nullptr};
+    bool                  full_body {false};
+    size_t                literal   {0};
+
+    void imap_section_empty() override
+    {
+      full_body = true;
+    }
+    void imap_body_section_inner() override
+    {
+      if (full_body)
+        parser->set_literal_sink(true);
+    }
+    void imap_body_section_end() override
+    {
+      parser->set_literal_sink(false);
+      full_body = false;
+    }
+    void imap_literal_data(const char *begin, const char *end) override
+    {
+      literal += end - begin;
+    }
+  };
+
+  // like Copy::Client, i.e. with CRLF conversion into the buffer,
+  // or with the --raw literal sink
+  void run_client(const Bench::Corpus::Units &units, size_t chunk, bool raw)
+  {
+    Client_Callback cb;
+    IMAP::Client::Parser p(cb.buffer, cb.tag_buffer, cb);
+    if (raw) {
+      cb.parser = &p;
+      p.set_convert_crlf(false);
+    }
+    for (auto &u : units)
+      feed(p, u, chunk);
+    p.verify_finished();
+  }
+
+  void run_server(const Bench::Corpus::Units &units, size_t chunk)
+  {
+    Buffer::Vector buffer, tag_buffer;
+    IMAP::Server::Callback::Null cb;
+    IMAP::Server::Parser p(buffer, tag_buffer, cb);
+    for (auto &u : units)
+      feed(p, u, chunk);
+  }
+
+  // without charset conversion, which would dominate the measurement
+  void pass_through(const std::pair<const char*, const char*> & /* charset */,
+      const std::pair<const char*, const char*> & /* lang */,
+      const std::pair<const char*, const char*> &inp,
+      std::string &out)
+  {
+    out.assign(inp.first, inp.second);
+  }
+
+  void run_header(const Bench::Corpus::Units &units, size_t chunk)
+  {
+    Buffer::Vector field, body;
+    size_t fields = 0;
+    MIME::Header::Decoder d(field, body, [&fields](){ ++fields; }, pass_through);
+    d.set_ending_policy(MIME::Header::Decoder::Ending::LF);
+    for (auto &u : units) {
+      d.clear();
+      feed(d, u, chunk);
+      d.verify_finished();
+    }
+  }
+
+  template <typename Decoder>
+    void run_decoder(const Bench::Corpus::Units &units, size_t chunk)
+    {
+      Buffer::Vector v;
+      for (auto &u : units) {
+        v.clear();
+        Decoder d(v);
+        feed(d, u, chunk);
+      }
+    }
+
+  void run_sanitizer(const Bench::Corpus::Units &units, size_t chunk)
+  {
+    Buffer::Vector v;
+    for (auto &u : units) {
+      v.clear();
+      ASCII::Control::Sanitizer s(v);
+      feed(s, u, chunk);
+    }
+  }
+
+  struct Machine {
+    string                 name;
+    Bench::Corpus::Units   units;
+    function<void(const Bench::Corpus::Units&, size_t)> run;
+  };
+
+  struct Result {
+    string   machine;
+    size_t   chunk   {0};
+    size_t   bytes   {0};
+    double   seconds {0};
+    uint64_t cycles  {0};
+
+    double bytes_per_cycle() const { return cycles ? double(bytes) / cycles : 0; }
+    double mb_per_second()   const { return bytes / seconds / 1e6; }
+  };
+
+  Result measure(const Machine &m, size_t chunk, unsigned repeat)
+  {
+    Result r;
+    r.machine = m.name;
+    r.chunk   = chunk;
+    r.bytes   = Bench::Corpus::size(m.units);
+    for (unsigned i = 0; i < repeat; ++i) {
+      auto     start = chrono::steady_clock::now();
+      uint64_t c     = cycles();
+      m.run(m.units, chunk);
+      c              = cycles() - c;
+      double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      if (!i || s < r.seconds) {
+        r.seconds = s;
+        r.cycles  = c;
+      }
+    }
+    return r;
+  }
+
+  vector<Machine> create_machines(const Options &opts)
+  {
+    size_t n = opts.size_mib * 1024 * 1024;
+    auto d = Bench::to_distribution(opts.distribution);
+    using namespace Bench::Corpus;
+    vector<Machine> r = {
+      { "client",     fetch_responses(n, opts.seed, d),
+        [](const Units &u, size_t c) { run_client(u, c, false); } },
+      { "client_raw", Units(),
+        [](const Units &u, size_t c) { run_client(u, c, true);  } },
+      { "server",     client_commands(n, opts.seed), run_server },
+      { "header",     header_blocks(n, opts.seed), run_header },
+      { "base64",     base64_runs(n, opts.seed), run_decoder<MIME::Base64::Decoder> },
+      { "q",          q_runs(n, opts.seed), run_decoder<MIME::Q::Decoder> },
+      { "sanitizer",  control_text(n, opts.seed), run_sanitizer }
+    };
+    r[1].units = r[0].units;
+    if (!opts.machines.empty()) {
+      for (auto &name : opts.machines)
+        if (find_if(r.begin(), r.end(),
+              [&name](const Machine &m) { return m.name == name; }) == r.end())
+          throw invalid_argument("unknown automaton: " + name);
+      r.erase(remove_if(r.begin(), r.end(), [&opts](const Machine &m) {
+            return find(opts.machines.begin(), opts.machines.end(), m.name)
+              == opts.machines.end(); }), r.end());
+    }
+    return r;
+  }
+
+  void print_json(ostream &o, const Options &opts, const vector<Result> &results)
+  {
+    o << "{\n"
+      << "  \"ragel_style\": \"" << IMAPDL_STR(IMAPDL_RAGEL_STYLE) << "\",\n"
+      << "  \"seed\": " << opts.seed << ",\n"
+      << "  \"results\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+      auto &r = results[i];
+      o << "    {\n"
+        << "      \"machine\": \"" << r.machine << "\",\n"
+        << "      \"chunk\": " << r.chunk << ",\n"
+        << "      \"bytes\": " << r.bytes << ",\n"
+        << "      \"seconds\": " << r.seconds << ",\n"
+        << "      \"cycles\": " << r.cycles << ",\n"
+        << "      \"bytes_per_cycle\": " << r.bytes_per_cycle() << ",\n"
+        << "      \"mb_per_second\": " << r.mb_per_second() << "\n"
+        << "    }" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    o << "  ]\n}\n";
+  }
+
+}
+
+int main(int argc, char **argv)
+{
+  try {
+    Options opts(argc, argv);
+    auto machines = create_machines(opts);
+
+    cout << "Ragel style: -" << IMAPDL_STR(IMAPDL_RAGEL_STYLE) << '\n'
+      << setw(12) << left << "automaton" << right
+      << setw(8)  << "chunk"
+      << setw(12) << "bytes"
+      << setw(12) << "B/cycle"
+      << setw(12) << "MB/s" << '\n';
+    vector<Result> results;
+    for (auto &m : machines) {
+      for (auto chunk : opts.chunks) {
+        results.push_back(measure(m, chunk, opts.repeat));
+        auto &r = results.back();
+        cout << setw(12) << left << r.machine << right
+          << setw(8)  << r.chunk
+          << setw(12) << r.bytes
+          << fixed << setprecision(3)
+          << setw(12) << r.bytes_per_cycle()
+          << setprecision(1)
+          << setw(12) << r.mb_per_second() << '\n';
+        cout.unsetf(ios::floatfield);
+      }
+    }
+    if (opts.json == "-") {
+      print_json(cout, opts, results);
+    } else if (!opts.json.empty()) {
+      ofstream f;
+      f.exceptions(ofstream::failbit | ofstream::badbit);
+      f.open(opts.json);
+      print_json(f, opts, results);
+    }
+  } catch (const exception &e) {
+    cerr << "Error: " << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
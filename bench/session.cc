@@ -0,0 +1,86 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "session.h"
+
+#include <trace/trace.h>
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace Bench {
+
+  namespace {
+
+    void push(Trace::Writer &w, Trace::Type type, const string &s)
+    {
+      Trace::Record_View r;
+      r.type  = type;
+      r.begin = s.data();
+      r.end   = s.data() + s.size();
+      w.push(r);
+    }
+
+  }
+
+  Session_Stats generate(const std::string &filename, const Session_Options &opts)
+  {
+    if (!opts.count)
+      throw invalid_argument("bench session needs at least one message");
+    Session_Stats stats;
+    Message_Generator g(opts.seed, opts.distribution);
+    Trace::Writer w(filename);
+    push(w, Trace::Type::RECEIVED, "* OK [CAPABILITY IMAP4 IMAP4rev1 LITERAL+ ID "
+        "AUTH=PLAIN SASL-IR] bench server ready\r\n");
+    push(w, Trace::Type::SENT, "A000 LOGIN " + opts.username + ' '
+        + opts.password + "\r\n");
+    push(w, Trace::Type::RECEIVED, "A000 OK [CAPABILITY IMAP4 IMAP4rev1 LITERAL+ "
+        "ID UIDPLUS] User logged in\r\n");
+    push(w, Trace::Type::SENT, "A001 SELECT INBOX\r\n");
+    {
+      ostringstream o;
+      o << "* FLAGS (\\Answered \\Flagged \\Draft \\Deleted \\Seen)\r\n"
+        << "* OK [PERMANENTFLAGS (\\Answered \\Flagged \\Draft \\Deleted \\Seen \\*)]  \r\n"
+        << "* " << opts.count << " EXISTS\r\n"
+        << "* " << opts.count << " RECENT\r\n"
+        << "* OK [UIDVALIDITY 4223]  \r\n"
+        << "* OK [UIDNEXT " << (opts.count + 1) << "]  \r\n"
+        << "A001 OK [READ-WRITE] Completed\r\n";
+      push(w, Trace::Type::RECEIVED, o.str());
+    }
+    push(w, Trace::Type::SENT, "A002 FETCH 1:* (UID FLAGS BODY.PEEK[HEADER.FIELDS "
+        "(date from subject)] BODY.PEEK[])\r\n");
+    for (size_t i = 1; i <= opts.count; ++i) {
+      string r(g.fetch_response(i, stats.bytes));
+      if (i == opts.count)
+        r += "A002 OK Completed\r\n";
+      push(w, Trace::Type::RECEIVED, r);
+      ++stats.messages;
+    }
+    push(w, Trace::Type::SENT, "A003 LOGOUT\r\n");
+    push(w, Trace::Type::RECEIVED, "* BYE LOGOUT received\r\nA003 OK Completed\r\n");
+    push(w, Trace::Type::DISCONNECT, string());
+    w.finish();
+    return stats;
+  }
+
+}
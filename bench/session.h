@@ -0,0 +1,52 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef BENCH_SESSION_H
+#define BENCH_SESSION_H
+
+#include "message.h"
+
+#include <string>
+#include <stddef.h>
+
+namespace Bench {
+
+  struct Session_Options {
+    size_t       count        {100};
+    Distribution distribution {Distribution::MIXED};
+    unsigned     seed         {23};
+    std::string  username;
+    std::string  password;
+  };
+
+  struct Session_Stats {
+    size_t messages {0};
+    // literal bytes, i.e. with CRLF line endings
+    size_t bytes    {0};
+  };
+
+  // Writes a trace of a complete download session (LOGIN, SELECT, FETCH,
+  // LOGOUT) with synthetic messages - as the example server replays it
+  // to a client that isn't configured to delete.
+  Session_Stats generate(const std::string &filename, const Session_Options &opts);
+
+}
+
+#endif
@@ -18,6 +18,11 @@ else
   ninja-build check
 fi
 
+if [[ $build_flags == *alloc_accounting=true* ]]; then
+  # log the measured allocations per message, cf. unittest/alloc.cc
+  ./ut --run_test=alloc --log_level=message
+fi
+
 if [[ $build_flags == *coverage* || $CXXFLAGS == *--coverage* || $CFLAGS == *--coverage* ]]; then
   /srv/src/ci/gen-coverage.py
 fi
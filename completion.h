@@ -0,0 +1,256 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Move-only replacement for std::function as completion handler of
+// an async_* call. Callables up to inline_size bytes (e.g. a lambda
+// that captures a few pointers) are stored in place. Larger ones (e.g.
+// a lambda that captures another Completion) go into a block that is
+// recycled per thread - thus, a command/response chain doesn't allocate
+// in the steady state.
+template <typename Signature> class Completion;
+
+namespace Completion_Detail {
+
+  class Pool {
+    public:
+      static const size_t block_size = 256;
+    private:
+      static const size_t max_free = 32;
+      void   *free_[max_free];
+      size_t  n_ {0};
+    public:
+      Pool() =default;
+      Pool(const Pool &) =delete;
+      Pool &operator=(const Pool &) =delete;
+      ~Pool()
+      {
+        while (n_)
+          ::operator delete(free_[--n_]);
+      }
+      void *get()
+      {
+        if (n_)
+          return free_[--n_];
+        return ::operator new(block_size);
+      }
+      void put(void *p)
+      {
+        if (n_ < max_free)
+          free_[n_++] = p;
+        else
+          ::operator delete(p);
+      }
+  };
+
+  inline Pool &pool()
+  {
+    static thread_local Pool p;
+    return p;
+  }
+
+}
+
+template <typename R, typename... Args>
+class Completion<R(Args...)> {
+  public:
+    static const size_t inline_size = 6 * sizeof(void*);
+  private:
+    using Storage = typename std::aligned_storage<inline_size>::type;
+
+    template <typename F>
+    struct Fits : std::integral_constant<bool,
+        sizeof(F) <= inline_size
+        && std::alignment_of<F>::value <= std::alignment_of<Storage>::value
+        && std::is_nothrow_move_constructible<F>::value> {};
+
+    template <typename F>
+    struct Pooled : std::integral_constant<bool,
+        sizeof(F) <= Completion_Detail::Pool::block_size
+        && std::alignment_of<F>::value <= std::alignment_of<Storage>::value> {};
+
+    struct Ops {
+      R    (*invoke) (Storage &s, Args... args);
+      // moves the callable from src into the empty dst and destroys it in src
+      void (*move)   (Storage &dst, Storage &src);
+      void (*destroy)(Storage &s);
+      bool inline_;
+    };
+
+    template <typename F>
+    struct Inline {
+      static F &target(Storage &s)
+      {
+        return *reinterpret_cast<F*>(&s);
+      }
+      static void create(Storage &s, F &&f)
+      {
+        new (&s) F(std::move(f));
+      }
+      static R invoke(Storage &s, Args... args)
+      {
+        return target(s)(std::forward<Args>(args)...);
+      }
+      static void move(Storage &dst, Storage &src)
+      {
+        new (&dst) F(std::move(target(src)));
+        target(src).~F();
+      }
+      static void destroy(Storage &s)
+      {
+        target(s).~F();
+      }
+    };
+
+    template <typename F>
+    struct Outline {
+      static F *&target(Storage &s)
+      {
+        return *reinterpret_cast<F**>(&s);
+      }
+      static void create(Storage &s, F &&f)
+      {
+        if (Pooled<F>::value) {
+          void *p = Completion_Detail::pool().get();
+          try {
+            target(s) = new (p) F(std::move(f));
+          } catch (...) {
+            Completion_Detail::pool().put(p);
+            throw;
+          }
+        } else {
+          target(s) = new F(std::move(f));
+        }
+      }
+      static R invoke(Storage &s, Args... args)
+      {
+        return (*target(s))(std::forward<Args>(args)...);
+      }
+      static void move(Storage &dst, Storage &src)
+      {
+        new (&dst) F*(target(src));
+      }
+      static void destroy(Storage &s)
+      {
+        F *f = target(s);
+        if (Pooled<F>::value) {
+          f->~F();
+          Completion_Detail::pool().put(f);
+        } else {
+          delete f;
+        }
+      }
+    };
+
+    template <typename F, typename Model>
+    static const Ops *ops()
+    {
+      static const Ops o = { &Model::invoke, &Model::move, &Model::destroy,
+        Fits<F>::value };
+      return &o;
+    }
+
+    mutable Storage  storage_;
+    const Ops       *ops_ {nullptr};
+
+    template <typename F>
+    void create(F &&f, std::true_type)
+    {
+      Inline<F>::create(storage_, std::move(f));
+      ops_ = ops<F, Inline<F> >();
+    }
+    template <typename F>
+    void create(F &&f, std::false_type)
+    {
+      Outline<F>::create(storage_, std::move(f));
+      ops_ = ops<F, Outline<F> >();
+    }
+    void reset()
+    {
+      if (ops_) {
+        ops_->destroy(storage_);
+        ops_ = nullptr;
+      }
+    }
+  public:
+    Completion() =default;
+    Completion(std::nullptr_t)
+    {
+    }
+    template <typename F, typename = typename std::enable_if<
+      !std::is_same<typename std::decay<F>::type, Completion>::value>::type>
+    Completion(F f)
+    {
+      create(std::move(f), Fits<F>());
+    }
+    Completion(Completion &&o) noexcept
+      :
+        ops_(o.ops_)
+    {
+      if (ops_) {
+        ops_->move(storage_, o.storage_);
+        o.ops_ = nullptr;
+      }
+    }
+    Completion &operator=(Completion &&o) noexcept
+    {
+      if (this != &o) {
+        reset();
+        if (o.ops_) {
+          o.ops_->move(storage_, o.storage_);
+          ops_ = o.ops_;
+          o.ops_ = nullptr;
+        }
+      }
+      return *this;
+    }
+    Completion(const Completion &) =delete;
+    Completion &operator=(const Completion &) =delete;
+    ~Completion()
+    {
+      reset();
+    }
+
+    explicit operator bool() const
+    {
+      return ops_;
+    }
+    // i.e. stored without a pool block
+    bool is_inline() const
+    {
+      return ops_ && ops_->inline_;
+    }
+    R operator()(Args... args) const
+    {
+      if (!ops_)
+        throw std::bad_function_call();
+      return ops_->invoke(storage_, std::forward<Args>(args)...);
+    }
+};
+
+#endif
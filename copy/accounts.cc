@@ -0,0 +1,374 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "accounts.h"
+#include "client.h"
+
+#include <exception.h>
+#include <net/tcp_client.h>
+#include <trace/trace.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/signal_set.hpp>
+#include <boost/log/sources/record_ostream.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+namespace IMAP {
+  namespace Copy {
+
+    // accounts with equal keys can use the same context,
+    // cf. Net::TCP::SSL::Client::Options::apply()
+    static string context_key(const Options &o)
+    {
+      ostringstream k;
+      k << o.tls1 << '\n' << (o.fingerprint.empty() ? o.ca_file : string())
+        << '\n' << o.ca_path;
+      return k.str();
+    }
+
+    Accounts::Accounts(int argc, char **argv, const Options &opts,
+        boost::log::sources::severity_logger<Log::Severity> &lg)
+      :
+        lg_(lg),
+        opts_(opts)
+    {
+      auto names = opts_.account_list();
+      if (names.empty())
+        THROW_MSG("No accounts to run");
+      for (auto &name : names) {
+        unique_ptr<Options> o(new Options(argc, argv, name));
+        account_opts_.push_back(std::move(o));
+      }
+      check();
+      for (auto &o : account_opts_) {
+        if (!o->use_ssl)
+          continue;
+        auto &c = contexts_[context_key(*o)];
+        if (!c) {
+          c.reset(new boost::asio::ssl::context(
+                boost::asio::ssl::context::sslv23));
+          o->apply(*c);
+        }
+      }
+      results_.resize(account_opts_.size());
+      started_.resize(account_opts_.size());
+
+      if (opts_.poll) {
+        random_.seed(random_device()());
+        uniform_real_distribution<double> d(0, 1);
+        auto now = chrono::steady_clock::now();
+        for (auto &o : account_opts_) {
+          unique_ptr<Net::SSL::Session> s(new Net::SSL::Session);
+          sessions_.push_back(std::move(s));
+          schedules_.emplace_back(o->interval, o->max_interval, opts_.jitter);
+          due_.push_back(now + schedules_.back().first(d(random_)));
+        }
+      }
+    }
+
+    void Accounts::check() const
+    {
+      if (opts_.pipeline)
+        THROW_MSG("--pipeline can't be combined with several accounts");
+      // the per-account defaults (e.g. $HOME/.config/imapdl/ACCOUNT.journal)
+      // are distinct - explicitly configured files must be, as well
+      // (except for the resolve cache, which is shared by design and
+      // serialized by Net::Resolve_Cache)
+      map<string, string> seen;
+      auto f = [&seen](const string &what, const string &filename,
+          const string &account) {
+        if (filename.empty())
+          return;
+        auto r = seen.insert(make_pair(filename, account));
+        if (!r.second) {
+          ostringstream o;
+          o << "Accounts " << r.first->second << " and " << account
+            << " use the same " << what << ": " << filename;
+          THROW_MSG(o.str());
+        }
+      };
+      for (auto &o : account_opts_) {
+        f("journal file", o->journal_file, o->account);
+        f("trace file", o->tracefile, o->account);
+        if (o->flight_recorder)
+          f("flight recorder file", o->flight_recorder_file, o->account);
+        f("metrics file", o->metrics_json, o->account);
+        f("metrics file", o->metrics_file, o->account);
+      }
+    }
+
+    boost::asio::ssl::context &Accounts::context(const Options &o)
+    {
+      // only read after the constructor, thus no locking
+      return *contexts_.at(context_key(o));
+    }
+
+    bool Accounts::take(size_t &i)
+    {
+      unique_lock<mutex> lock(mutex_);
+      for (;;) {
+        bool pending = false;
+        for (size_t j = 0; j < started_.size(); ++j) {
+          if (started_[j])
+            continue;
+          pending = true;
+          auto &n = host_sessions_[account_opts_[j]->host];
+          if (opts_.max_host_sessions && n >= opts_.max_host_sessions)
+            continue;
+          started_[j] = true;
+          ++n;
+          i = j;
+          return true;
+        }
+        if (!pending)
+          return false;
+        cond_.wait(lock);
+      }
+    }
+
+    void Accounts::release(size_t i)
+    {
+      {
+        lock_guard<mutex> lock(mutex_);
+        --host_sessions_[account_opts_[i]->host];
+      }
+      cond_.notify_all();
+    }
+
+    void Accounts::work(
+        boost::log::sources::severity_logger<Log::Severity> &lg)
+    {
+      size_t i = 0;
+      while (take(i)) {
+        run_one(i, lg);
+        release(i);
+      }
+    }
+
+    void Accounts::run_one(size_t i,
+        boost::log::sources::severity_logger<Log::Severity> &lg)
+    {
+      auto &o = *account_opts_[i];
+      // each thread only writes its own element
+      auto &r = results_[i];
+      r = Account_Result();
+      r.account = o.account;
+      r.host    = o.host;
+      auto start = chrono::steady_clock::now();
+
+      unique_ptr<Trace::Ring> flight_recorder;
+      if (o.flight_recorder)
+        flight_recorder = unique_ptr<Trace::Ring>(
+            new Trace::Ring(size_t(o.flight_recorder) * 1024 * 1024));
+
+      IMAPDL_LOG_SEV(lg, Log::MSG) << "Account " << o.account
+        << ": connecting to " << o.host;
+      try {
+        boost::asio::io_service io_service;
+        unique_ptr<Net::Client::Base> net_client;
+        if (o.use_ssl) {
+          unique_ptr<Net::TCP::SSL::Client::Base> c(
+              new Net::TCP::SSL::Client::Base(io_service, context(o), o, lg,
+                false));
+          if (!sessions_.empty())
+            c->set_session(sessions_[i].get());
+          net_client = std::move(c);
+        } else {
+          unique_ptr<Net::Client::Base> c(
+              new Net::TCP::Client::Base(io_service, o, lg));
+          net_client = std::move(c);
+        }
+        net_client->set_flight_recorder(flight_recorder.get());
+        Client client(o, *net_client, lg);
+
+        io_service.run();
+
+        r.messages = client.messages();
+        r.bytes    = client.bytes_read();
+        r.ok       = true;
+      } catch (const exception &e) {
+        r.error = e.what();
+        IMAPDL_LOG_SEV(lg, Log::ERROR) << "Account " << o.account << ": "
+          << e.what();
+        if (flight_recorder && !flight_recorder->empty()) {
+          try {
+            flight_recorder->dump(o.flight_recorder_file);
+            IMAPDL_LOG_SEV(lg, Log::ERROR) << "Wrote last messages to "
+              << o.flight_recorder_file << " (see replay)";
+          } catch (const exception &f) {
+            IMAPDL_LOG_SEV(lg, Log::ERROR)
+              << "Could not write flight recorder: " << f.what();
+          }
+        }
+      }
+      r.seconds = chrono::duration<double>(
+          chrono::steady_clock::now() - start).count();
+    }
+
+    bool Accounts::take_due(size_t &i)
+    {
+      unique_lock<mutex> lock(mutex_);
+      for (;;) {
+        if (stop_)
+          return false;
+        bool found = false;
+        size_t next = 0;
+        for (size_t j = 0; j < started_.size(); ++j) {
+          if (started_[j])
+            continue;
+          if (opts_.max_host_sessions && host_sessions_[account_opts_[j]->host]
+              >= opts_.max_host_sessions)
+            continue;
+          if (!found || due_[j] < due_[next]) {
+            found = true;
+            next = j;
+          }
+        }
+        if (found && due_[next] <= chrono::steady_clock::now()) {
+          started_[next] = true;
+          ++host_sessions_[account_opts_[next]->host];
+          i = next;
+          return true;
+        }
+        if (found)
+          cond_.wait_until(lock, due_[next]);
+        else
+          cond_.wait(lock);
+      }
+    }
+
+    void Accounts::reschedule(size_t i,
+        boost::log::sources::severity_logger<Log::Severity> &lg)
+    {
+      auto &r = results_[i];
+      Schedule::Duration delay;
+      {
+        lock_guard<mutex> lock(mutex_);
+        started_[i] = false;
+        --host_sessions_[account_opts_[i]->host];
+        uniform_real_distribution<double> d(0, 1);
+        delay = schedules_[i].next(r.ok, r.messages, d(random_));
+        due_[i] = chrono::steady_clock::now() + delay;
+      }
+      cond_.notify_all();
+      IMAPDL_LOG_SEV(lg, Log::MSG) << "Account " << r.account << ": "
+        << (r.ok ? "" : "failed, ") << r.messages
+        << " messages - next poll in "
+        << chrono::duration_cast<chrono::seconds>(delay).count() << " s";
+    }
+
+    void Accounts::stop()
+    {
+      {
+        lock_guard<mutex> lock(mutex_);
+        stop_ = true;
+      }
+      cond_.notify_all();
+    }
+
+    void Accounts::poll_work(
+        boost::log::sources::severity_logger<Log::Severity> &lg)
+    {
+      size_t i = 0;
+      while (take_due(i)) {
+        run_one(i, lg);
+        reschedule(i, lg);
+      }
+    }
+
+    void Accounts::run_workers(void (Accounts::*worker)(
+          boost::log::sources::severity_logger<Log::Severity> &),
+        boost::asio::io_service *io_service)
+    {
+      size_t n = min(size_t(max(opts_.max_sessions, 1u)),
+          account_opts_.size());
+      IMAPDL_LOG_SEV(lg_, Log::MSG) << "Running " << account_opts_.size()
+        << " accounts with up to " << n << " sessions";
+      // copied here, before any of the threads runs
+      vector<boost::log::sources::severity_logger<Log::Severity> > lgs(n, lg_);
+      vector<thread> threads;
+      threads.reserve(n);
+      for (size_t i = 0; i < n; ++i)
+        threads.emplace_back(worker, this, std::ref(lgs[i]));
+      if (io_service)
+        io_service->run();
+      for (auto &t : threads)
+        t.join();
+    }
+
+    bool Accounts::run()
+    {
+      run_workers(&Accounts::work, nullptr);
+      return all_of(results_.begin(), results_.end(),
+          [](const Account_Result &r) { return r.ok; });
+    }
+
+    void Accounts::poll()
+    {
+      // a running Client also gets the signal and quits early
+      boost::asio::io_service io_service;
+      boost::asio::signal_set signals(io_service, SIGINT, SIGTERM);
+      signals.async_wait([this](const boost::system::error_code &ec,
+            int signal_number)
+          {
+            if (!ec)
+              IMAPDL_LOG_SEV(lg_, Log::MSG) << "Got signal: " << signal_number
+                << " - stopping";
+            stop();
+          });
+      run_workers(&Accounts::poll_work, &io_service);
+    }
+
+    const std::vector<Account_Result> &Accounts::results() const
+    {
+      return results_;
+    }
+
+    void Accounts::print_summary(std::ostream &o) const
+    {
+      size_t failed = 0, messages = 0, bytes = 0;
+      for (auto &r : results_) {
+        o << setw(16) << left << r.account << ' ' << setw(24) << r.host
+          << right << ' ' << (r.ok ? "OK   " : "ERROR") << ' '
+          << setw(8) << r.messages << " msgs "
+          << setw(10) << fixed << setprecision(2)
+          << double(r.bytes) / 1024 / 1024 << " MiB "
+          << setw(8) << r.seconds << " s";
+        if (!r.ok)
+          o << " - " << r.error;
+        o << '\n';
+        failed   += !r.ok;
+        messages += r.messages;
+        bytes    += r.bytes;
+      }
+      o << results_.size() << " accounts, " << failed << " failed, "
+        << messages << " messages, " << fixed << setprecision(2)
+        << double(bytes) / 1024 / 1024 << " MiB\n";
+    }
+
+  }
+}
@@ -0,0 +1,122 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef IMAP_COPY_ACCOUNTS_H
+#define IMAP_COPY_ACCOUNTS_H
+
+#include "options.h"
+#include "schedule.h"
+
+#include <log/log.h>
+#include <net/ssl_util.h>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ssl/context.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+namespace IMAP {
+  namespace Copy {
+
+    struct Account_Result {
+      std::string account;
+      std::string host;
+      bool        ok       {false};
+      std::string error;
+      size_t      messages {0};
+      size_t      bytes    {0};
+      double      seconds  {0};
+    };
+
+    // Runs several accounts of one configuration file at the same time.
+    //
+    // Each running account gets its own io_service on one of
+    // max_sessions threads, thus a slow server doesn't hold up the
+    // others. At most max_host_sessions accounts talk to the same host
+    // at a time. Accounts with the same TLS settings share one SSL
+    // context.
+    //
+    // With --poll, the accounts are run again and again, as dictated by
+    // their Schedule, until SIGINT/SIGTERM. The process, the SSL
+    // contexts and the TLS sessions (for abbreviated handshakes) are
+    // kept between the polls.
+    class Accounts {
+      private:
+        boost::log::sources::severity_logger<Log::Severity> &lg_;
+        const Options &opts_;
+        std::vector<std::unique_ptr<Options> > account_opts_;
+        std::map<std::string, std::unique_ptr<boost::asio::ssl::context> >
+          contexts_;
+        std::vector<Account_Result> results_;
+        std::vector<std::unique_ptr<Net::SSL::Session> > sessions_;
+
+        std::mutex                      mutex_;
+        std::condition_variable         cond_;
+        std::vector<bool>               started_;
+        std::map<std::string, unsigned> host_sessions_;
+
+        // only used with --poll, guarded by mutex_
+        std::vector<Schedule>                              schedules_;
+        std::vector<std::chrono::steady_clock::time_point> due_;
+        std::mt19937                                       random_;
+        bool                                               stop_ {false};
+
+        void check() const;
+        boost::asio::ssl::context &context(const Options &o);
+        bool take(size_t &i);
+        void release(size_t i);
+        bool take_due(size_t &i);
+        void reschedule(size_t i,
+            boost::log::sources::severity_logger<Log::Severity> &lg);
+        void stop();
+        void work(boost::log::sources::severity_logger<Log::Severity> &lg);
+        void poll_work(
+            boost::log::sources::severity_logger<Log::Severity> &lg);
+        // runs the workers until they return, meanwhile also io_service
+        void run_workers(void (Accounts::*worker)(
+              boost::log::sources::severity_logger<Log::Severity> &),
+            boost::asio::io_service *io_service);
+        void run_one(size_t i,
+            boost::log::sources::severity_logger<Log::Severity> &lg);
+      public:
+        Accounts(int argc, char **argv, const Options &opts,
+            boost::log::sources::severity_logger<Log::Severity> &lg);
+
+        // returns false if one account failed
+        bool run();
+        // returns after SIGINT/SIGTERM
+        void poll();
+        const std::vector<Account_Result> &results() const;
+        void print_summary(std::ostream &o) const;
+    };
+
+  }
+}
+
+#endif
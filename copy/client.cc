@@ -25,6 +25,7 @@ using namespace Memory;
 #include "state.h"
 #include "options.h"
 #include <exception.h>
+#include <alloc/accounting.h>
 
 #include <boost/log/sources/record_ostream.hpp>
 //#include <boost/log/attributes/named_scope.hpp>
@@ -40,6 +41,9 @@ namespace fs = boost::filesystem;
 
 #include "journal.h"
 
+#include <sys/stat.h>
+#include <fcntl.h>
+
 #include <boost/asio/yield.hpp>
 
 namespace IMAP {
@@ -53,21 +57,34 @@ namespace IMAP {
         lg_(lg),
         opts_(opts),
         client_(net_client),
-        app_(opts_.host, client_, lg_),
+        resolve_cache_(opts_.resolve_cache.empty() ? nullptr
+            : new Net::Resolve_Cache(opts_.resolve_cache,
+                std::chrono::seconds(opts_.resolve_ttl),
+                opts_.host, opts_.service)),
+        app_(opts_.host, client_, lg_, resolve_cache_.get()),
         signals_(client_.io_service(), SIGINT, SIGTERM),
         login_timer_(client_.io_service()),
         maildir_(opts_.maildir),
         tmp_dir_(maildir_.tmp_dir_fd()),
+        literal_sink_(maildir_.tmp_dir_fd()),
         parser_(buffer_proxy_, tag_buffer_, *this),
         mailbox_(opts_.mailbox),
         fetch_timer_(client_, lg_),
-        header_printer_(opts_, buffer_, lg_)
+        header_printer_(opts_, buffer_, lg_),
+        metrics_timer_(client_.io_service()),
+        stages_(opts_.perf ? new Perf::Stages : nullptr)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       buffer_proxy_.set(&buffer_);
+      if (opts_.raw)
+        parser_.set_convert_crlf(false);
       read_journal();
       do_signal_wait();
-      app_.async_start([this](){
+      do_metrics_wait();
+      // Net::Client::Application takes std::function, thus not timed()
+      auto start = Metrics::Clock::now();
+      app_.async_start([this, start](){
+            metrics_.add_phase(Metrics::Phase::CONNECT, Metrics::Clock::now() - start);
             //state_ = State::ESTABLISHED;
             do_read();
             do_pre_login();
@@ -80,44 +97,96 @@ namespace IMAP {
       } catch (...) {
         // don't throw exceptions in destructor ...
       }
+      try {
+        write_metrics();
+      } catch (...) {
+      }
     }
 
     void Client::read_journal()
     {
       if (fs::exists(opts_.journal_file)) {
         Journal journal;
-        BOOST_LOG_SEV(lg_, Log::MSG) << "Reading journal " << opts_.journal_file << " ...";
+        IMAPDL_LOG_SEV(lg_, Log::MSG) << "Reading journal " << opts_.journal_file << " ...";
         journal.read(opts_.journal_file);
         uidvalidity_ = journal.uidvalidity_;
         uids_ = journal.uids_;
         mailbox_ = journal.mailbox_;
-        need_cleanup_ = true;
-        fs::remove(opts_.journal_file);
+        metrics_.set_journal_replay(uids_.size());
+        need_cleanup_ = !uids_.empty();
+        if (opts_.del && need_cleanup_) {
+          // compact what was appended last time, then keep appending
+          journal.write(opts_.journal_file);
+          journal_writer_.open(opts_.journal_file);
+        } else {
+          fs::remove(opts_.journal_file);
+        }
       }
     }
     void Client::write_journal()
     {
-      if (uids_.empty())
+      journal_writer_.close();
+      if (uids_.empty() || !opts_.del) {
+        if (fs::exists(opts_.journal_file))
+          fs::remove(opts_.journal_file);
         return;
-      if (!opts_.del)
-        return;
-      BOOST_LOG_SEV(lg_, Log::MSG) << "Writing journal " << opts_.journal_file << " ...";
-      Journal journal(opts_.mailbox, uidvalidity_, uids_);
+      }
+      IMAPDL_LOG_SEV(lg_, Log::MSG) << "Writing journal " << opts_.journal_file << " ...";
+      Journal journal(mailbox_, uidvalidity_, uids_);
       journal.write(opts_.journal_file);
     }
+    void Client::write_metrics()
+    {
+      metrics_.set_bytes(client_.bytes_read(), client_.bytes_written());
+      metrics_.write(opts_.metrics_json, opts_.metrics_file);
+    }
+    // periodically - for long runs, besides at exit
+    void Client::do_metrics_wait()
+    {
+      if (!opts_.metrics_interval
+          || (opts_.metrics_json.empty() && opts_.metrics_file.empty()))
+        return;
+      metrics_timer_.expires_from_now(std::chrono::seconds(opts_.metrics_interval));
+      metrics_timer_.async_wait([this](const boost::system::error_code &ec)
+          {
+            if (ec) {
+              if (ec.value() == boost::asio::error::operation_aborted)
+                return;
+              THROW_ERROR(ec);
+            }
+            write_metrics();
+            do_metrics_wait();
+          });
+    }
+    // Done_Fn is move-only, and C++11 lambdas can't capture by move,
+    // thus, std::bind() is used for passing it on
+    Client::Done_Fn Client::timed(Metrics::Phase phase, Done_Fn fn)
+    {
+      auto start = Metrics::Clock::now();
+      return std::bind([this, phase, start](Done_Fn &fn) {
+        metrics_.add_phase(phase, Metrics::Clock::now() - start);
+        fn();
+      }, std::move(fn));
+    }
+
+    void Client::clear_uids()
+    {
+      uids_.clear();
+      journal_writer_.clear();
+    }
 
     void Client::do_signal_wait()
     {
       signals_.async_wait([this]( const boost::system::error_code &ec, int signal_number)
           {
-            BOOST_LOG_FUNCTION();
+            IMAPDL_LOG_FUNCTION();
             if (ec) {
               if (ec.value() == boost::system::errc::operation_canceled) {
               } else {
                 THROW_ERROR(ec);
               }
             } else {
-              BOOST_LOG_SEV(lg_, Log::ERROR) << "Got signal: " << signal_number;
+              IMAPDL_LOG_SEV(lg_, Log::ERROR) << "Got signal: " << signal_number;
               if (signaled_) {
                 ostringstream o;
                 o << "Got a signal (" << signal_number
@@ -132,38 +201,38 @@ namespace IMAP {
           });
     }
 
-    void Client::async_login_capabilities(std::function<void(void)> fn)
+    void Client::async_login_capabilities(Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
-      auto cap_fn = [this, fn](){
-        cond_async_capabilities(fn);
-      };
-      async_login(cap_fn);
+      IMAPDL_LOG_FUNCTION();
+      auto cap_fn = std::bind([this](Done_Fn &fn){
+        cond_async_capabilities(std::move(fn));
+      }, std::move(fn));
+      async_login(std::move(cap_fn));
     }
 
-    void Client::async_cleanup(std::function<void(void)> fn)
+    void Client::async_cleanup(Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
-      auto finish_fn = [this, fn](){
-        uids_.clear();
+      IMAPDL_LOG_FUNCTION();
+      Done_Fn finish_fn = std::bind([this](Done_Fn &fn){
+        clear_uids();
         mailbox_ = opts_.mailbox;
-        BOOST_LOG_SEV(lg_, Log::MSG) << "Deleting messages from last time ... finished";
+        IMAPDL_LOG_SEV(lg_, Log::MSG) << "Deleting messages from last time ... finished";
         fn();
-      };
-      auto expunge_fn = [this, finish_fn](){
-       async_uid_or_simple_expunge(finish_fn);
-      };
-      auto store_fn = [this, expunge_fn](){
-        async_store(expunge_fn);
-      };
-      async_select(store_fn);
+      }, std::move(fn));
+      Done_Fn expunge_fn = std::bind([this](Done_Fn &finish_fn){
+       async_uid_or_simple_expunge(std::move(finish_fn));
+      }, std::move(finish_fn));
+      Done_Fn store_fn = std::bind([this](Done_Fn &expunge_fn){
+        async_store(std::move(expunge_fn));
+      }, std::move(expunge_fn));
+      async_select(std::move(store_fn));
     }
 
     // Boost ASIO stackless coroutine in combination
     // with classical std::bind()s to supply the completion handler
     void Client::do_download()
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       reenter (download_coroutine_) {
         yield async_select(bind(&Client::do_download, this));
         if (exists_) {
@@ -176,10 +245,10 @@ namespace IMAP {
             yield async_uid_or_simple_expunge(bind(&Client::do_download, this));
           }
         } else {
-          BOOST_LOG_SEV(lg_, Log::MSG) << "Mailbox " << opts_.mailbox
+          IMAPDL_LOG_SEV(lg_, Log::MSG) << "Mailbox " << opts_.mailbox
             << " is empty.";
         }
-        uids_.clear();
+        clear_uids();
         yield async_logout(bind(&Client::do_download, this));
         do_quit();
       }
@@ -190,11 +259,11 @@ namespace IMAP {
     // (less characters to type than using std::bind() ...)
     void Client::do_fetch_header()
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       reenter (fetch_header_coroutine_) {
         yield async_select      ([this](){do_fetch_header();});
         yield async_fetch_header([this](){do_fetch_header();});
-        uids_.clear();
+        clear_uids();
         yield async_logout      ([this](){do_fetch_header();});
         do_quit();
       }
@@ -212,21 +281,26 @@ namespace IMAP {
     // std::function() of 24 byte lambda                   : 32 byte
     // std::function() of 24 byte std::bind()              : 32 byte
     //
+    // std::function() allocates for targets larger than 16 byte. Done_Fn
+    // (a Completion, 64 byte) stores targets up to 48 byte in place, i.e.
+    // the list_fn below doesn't allocate. Larger ones - e.g. the ones
+    // capturing another Done_Fn in timed() - use recycled blocks.
+    //
     // coroutine object -> sizeof(int)                     :  4 byte
     void Client::do_list()
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       auto finish_fn = [this](){
         do_quit();
       };
       auto logout_fn = [this, finish_fn](){
-        uids_.clear();
+        clear_uids();
         async_logout(finish_fn);
       };
       auto list_fn = [this, logout_fn](){
         async_list(logout_fn);
       };
-      async_select(list_fn);
+      async_select(std::move(list_fn));
     }
 
     void Client::do_pre_login()
@@ -235,7 +309,7 @@ namespace IMAP {
       login_timer_.async_wait([this](
           const boost::system::error_code &ec)
         {
-          BOOST_LOG_FUNCTION();
+          IMAPDL_LOG_FUNCTION();
           if (ec && ec.value() != boost::system::errc::operation_canceled) {
             THROW_ERROR(ec);
           } else {
@@ -271,10 +345,10 @@ namespace IMAP {
       }
     }
 
-    void Client::cond_async_capabilities(std::function<void(void)> fn)
+    void Client::cond_async_capabilities(Done_Fn fn)
     {
       if (capabilities_.empty()) {
-        async_capabilities(fn);
+        async_capabilities(timed(Metrics::Phase::LOGIN, std::move(fn)));
       } else {
         BOOST_LOG(lg_) << "not fetching capabilities (already received)";
         fn();
@@ -282,30 +356,32 @@ namespace IMAP {
     }
 
 
-    void Client::async_login(std::function<void(void)> fn)
+    void Client::async_login(Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       using namespace IMAP::Server::Response;
       if (capabilities_.find(Capability::IMAP4rev1) == capabilities_.end())
         THROW_MSG("Server has not IMAP4rev1 capability");
       if (capabilities_.find(Capability::LOGINDISABLED) != capabilities_.end())
         THROW_MSG("Cannot login because server has LOGINDISABLED");
-      BOOST_LOG_SEV(lg_, Log::DEBUG) << "Clearing capabilities";
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Clearing capabilities";
       capabilities_.clear();
       exists_ = 0;
       recent_ = 0;
       // Don't reset them on login in case the values are loaded from a journal
       //uidvalidity_ = 0;
       //uids_.clear();
-      IMAP::Client::Base::async_login(opts_.username, opts_.password, fn);
+      IMAP::Client::Base::async_login(opts_.username, opts_.password,
+          timed(Metrics::Phase::LOGIN, std::move(fn)));
     }
 
-    void Client::async_select(std::function<void(void)> fn)
+    void Client::async_select(Done_Fn fn)
     {
-      IMAP::Client::Base::async_select(mailbox_, fn);
+      IMAP::Client::Base::async_select(mailbox_,
+          timed(Metrics::Phase::SELECT, std::move(fn)));
     }
 
-    void Client::async_fetch(std::function<void(void)> fn)
+    void Client::async_fetch(Done_Fn fn)
     {
       vector<pair<uint32_t, uint32_t> > set = {
         {1, numeric_limits<uint32_t>::max()}
@@ -325,10 +401,15 @@ namespace IMAP {
       atts.emplace_back(Fetch::BODY_PEEK);
 
       state_ = State::FETCHING;
-      IMAP::Client::Base::async_fetch(set, atts, fn);
+      client_.set_quick_ack(true);
+      IMAP::Client::Base::async_fetch(set, atts,
+          timed(Metrics::Phase::FETCH, std::bind([this](Done_Fn &fn){
+            client_.set_quick_ack(false);
+            fn();
+          }, std::move(fn))));
     }
 
-    void Client::async_fetch_header(std::function<void(void)> fn)
+    void Client::async_fetch_header(Done_Fn fn)
     {
       vector<pair<uint32_t, uint32_t> > set = {
         {1, numeric_limits<uint32_t>::max()}
@@ -347,57 +428,79 @@ namespace IMAP {
           IMAP::Section_Attribute(IMAP::Section::HEADER_FIELDS, std::move(fields)));
 
       state_ = State::FETCHING;
-      IMAP::Client::Base::async_fetch(set, atts, fn);
+      IMAP::Client::Base::async_fetch(set, atts,
+          timed(Metrics::Phase::FETCH, std::move(fn)));
     }
-    void Client::async_list(std::function<void(void)> fn)
+    void Client::async_list(Done_Fn fn)
     {
-      IMAP::Client::Base::async_list(opts_.list_reference, opts_.list_mailbox, fn);
+      IMAP::Client::Base::async_list(opts_.list_reference, opts_.list_mailbox,
+          timed(Metrics::Phase::LIST, std::move(fn)));
     }
 
-    void Client::async_store(std::function<void(void)> fn)
+    void Client::async_store(Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       vector<pair<uint32_t, uint32_t> > set;
       uids_.copy(set);
       vector<IMAP::Flag> flags;
       flags.emplace_back(IMAP::Flag::DELETED);
-      IMAP::Client::Base::async_store(set, flags, fn);
+      IMAP::Client::Base::async_store(set, flags,
+          timed(Metrics::Phase::STORE, std::move(fn)));
+    }
+
+    size_t Client::messages() const
+    {
+      return fetch_timer_.messages();
+    }
+    size_t Client::bytes_read() const
+    {
+      return client_.bytes_read();
     }
 
     bool Client::has_uidplus() const
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       auto i = capabilities_.find(IMAP::Server::Response::Capability::UIDPLUS);
       BOOST_LOG(lg_) << "Has UIDPLUS capability: " << (i != capabilities_.end());
       return i != capabilities_.end();
     }
 
-    void Client::async_uid_or_simple_expunge(std::function<void(void)> fn)
+    void Client::async_uid_or_simple_expunge(Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       if (has_uidplus())
-        async_uid_expunge(fn);
+        async_uid_expunge(timed(Metrics::Phase::EXPUNGE, std::move(fn)));
       else
-        async_expunge(fn);
+        async_expunge(timed(Metrics::Phase::EXPUNGE, std::move(fn)));
+    }
+
+    void Client::async_logout(Done_Fn fn)
+    {
+      IMAP::Client::Base::async_logout(timed(Metrics::Phase::LOGOUT, std::move(fn)));
     }
 
-    void Client::async_uid_expunge(std::function<void(void)> fn)
+    void Client::async_uid_expunge(Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       vector<pair<uint32_t, uint32_t> > set;
       uids_.copy(set);
-      IMAP::Client::Base::async_uid_expunge(set, fn);
+      IMAP::Client::Base::async_uid_expunge(set, std::move(fn));
     }
 
 
     void Client::do_read()
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      if (stages_)
+        stages_->enter(Perf::Stage::NET_READ);
+      IMAPDL_ALLOC_TAG("net read");
       client_.async_read_some([this](
             const boost::system::error_code &ec,
             size_t size)
           {
-            BOOST_LOG_FUNCTION();
+            IMAPDL_LOG_FUNCTION();
+            if (stages_)
+              stages_->leave();
             if (ec) {
               if (          state_ == State::LOGGED_OUT
                   && (
@@ -416,20 +519,62 @@ namespace IMAP {
                      )
                 )
               {
-                //BOOST_LOG_SEV(lg_, Log::DEBUG) << "do_read() -> do_shutdown()";
+                //IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "do_read() -> do_shutdown()";
                 //do_shutdown();
               } else {
-                BOOST_LOG_SEV(lg_, Log::DEBUG) << "do_read() fail: " << ec.message();
+                IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "do_read() fail: " << ec.message();
                 THROW_ERROR(ec);
               }
             } else {
-              parser_.read(client_.input().data(), client_. input().data() + size);
-              if (state_ != State::LOGGED_OUT) // && client_.is_open())
+              double cpu = thread_cpu_seconds();
+              {
+                Perf::Scope scope(stages_.get(), Perf::Stage::PARSE);
+                IMAPDL_ALLOC_TAG("parse");
+                parser_.read(client_.input().data(), client_. input().data() + size);
+              }
+              metrics_.add_parser_cpu(thread_cpu_seconds() - cpu);
+              if (splice_ && parser_.literal_pending())
+                do_splice();
+              else if (state_ != State::LOGGED_OUT) // && client_.is_open())
                 do_read();
             }
           });
     }
 
+    // the rest of a message literal goes directly from the socket into
+    // the maildir file - where the transport supports it
+    void Client::do_splice()
+    {
+      IMAPDL_LOG_FUNCTION();
+      if (stages_)
+        stages_->enter(Perf::Stage::FILE_WRITE);
+      client_.async_splice(literal_sink_.fd(), parser_.literal_pending(), [this](
+            const boost::system::error_code &ec,
+            size_t size)
+          {
+            IMAPDL_LOG_FUNCTION();
+            if (stages_)
+              stages_->leave();
+            // also on error, these bytes are in the file
+            parser_.skip_literal(size);
+            if (ec == boost::asio::error::operation_not_supported) {
+              IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Transport doesn't support splicing"
+                " - falling back to reads";
+              splice_ = false;
+              do_read();
+              return;
+            }
+            if (ec) {
+              IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "do_splice() fail: " << ec.message();
+              THROW_ERROR(ec);
+            }
+            if (parser_.literal_pending())
+              do_splice();
+            else
+              do_read();
+          });
+    }
+
     void Client::write_command(vector<char> &cmd)
     {
       client_.push_write(cmd);
@@ -437,19 +582,30 @@ namespace IMAP {
 
     void Client::do_quit()
     {
-      BOOST_LOG_FUNCTION();
-      BOOST_LOG_SEV(lg_, Log::DEBUG) << "do_quit()";
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "do_quit()";
       state_ = State::LOGGED_OUT;
       app_.async_finish([this](){
             signals_.cancel();
+            metrics_timer_.cancel();
+            if (stages_) {
+              ostringstream o;
+              stages_->print(o, fetch_timer_.messages());
+              IMAPDL_LOG_SEV(lg_, Log::MSG) << "Time per stage:\n" << o.str();
+            }
+            if (Alloc::enabled()) {
+              ostringstream o;
+              Alloc::print(o, fetch_timer_.messages());
+              IMAPDL_LOG_SEV(lg_, Log::MSG) << "Heap allocations:\n" << o.str();
+            }
           });
     }
 
 
     void Client::imap_status_code_capability_begin()
     {
-      BOOST_LOG_FUNCTION();
-      BOOST_LOG_SEV(lg_, Log::DEBUG) << "Clearing capabilities";
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Clearing capabilities";
       capabilities_.clear();
     }
     void Client::imap_capability_begin()
@@ -457,45 +613,46 @@ namespace IMAP {
     }
     void Client::imap_capability(IMAP::Server::Response::Capability capability)
     {
-      BOOST_LOG_FUNCTION();
-      BOOST_LOG_SEV(lg_, Log::DEBUG) << "Got capability: " << capability;
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Got capability: " << capability;
       capabilities_.insert(capability);
     }
     void Client::imap_status_code_capability_end()
     {
-      BOOST_LOG_FUNCTION();
-      BOOST_LOG_SEV(lg_, Log::DEBUG) << "finished retrieving capabilties";
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "finished retrieving capabilties";
       login_timer_.cancel();
     }
     void Client::imap_data_exists(uint32_t number)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       BOOST_LOG(lg_) << "Mailbox " << opts_.mailbox << " contains " << number
         << " messages";
       exists_ = number;
     }
     void Client::imap_data_recent(uint32_t number)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       BOOST_LOG(lg_) << "Mailbox " << opts_.mailbox << " has " << number
         << " RECENT messages";
       recent_ = number;
     }
     void Client::imap_status_code_uidvalidity(uint32_t n)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       BOOST_LOG(lg_) << "UIDVALIDITY: " << n;
       if (uidvalidity_ != n) {
-        BOOST_LOG_SEV(lg_, Log::DEBUG) << "Replacing UIDVALIDITY "
+        IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Replacing UIDVALIDITY "
           << uidvalidity_ << " with " << n;
-        uids_.clear();
+        clear_uids();
       }
       uidvalidity_ = n;
     }
 
     void Client::imap_data_fetch_begin(uint32_t number)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_ALLOC_TAG("fetch");
       flags_.clear();
       if (state_ == State::FETCHING) {
         BOOST_LOG(lg_) << "Fetching message: " << number;
@@ -509,10 +666,19 @@ namespace IMAP {
     }
     void Client::imap_data_fetch_end()
     {
+      IMAPDL_ALLOC_TAG("fetch");
       if (!last_uid_)
         THROW_MSG("Did not retrieve any UID");
-      BOOST_LOG_SEV(lg_, Log::DEBUG) << "Storing UID: " << last_uid_;
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Storing UID: " << last_uid_;
       uids_.push(last_uid_);
+      if (opts_.del && state_ == State::FETCHING && opts_.task == Task::DOWNLOAD) {
+        // the message is in the maildir at this point, thus it must be
+        // on disk before the server is told to delete it
+        if (!journal_writer_.is_open())
+          journal_writer_.open(opts_.journal_file);
+        journal_writer_.push(mailbox_, uidvalidity_, last_uid_);
+        journal_writer_.sync();
+      }
     }
     void Client::imap_section_empty()
     {
@@ -526,34 +692,66 @@ namespace IMAP {
     {
       if (state_ == State::FETCHING) {
         if (full_body_) {
-          string filename;
-          maildir_.create_tmp_name(filename);
-          Buffer::File f(tmp_dir_, filename);
-          file_buffer_ = std::move(f);
-          buffer_proxy_.set(&file_buffer_);
+          IMAPDL_ALLOC_TAG("maildir tmp");
+          fetch_timer_.first_literal();
+          literal_start_ = Metrics::Clock::now();
+          maildir_.create_tmp_name(tmp_name_);
+          if (opts_.raw) {
+            literal_sink_.open(tmp_name_);
+            parser_.set_literal_sink(true);
+          } else {
+            Buffer::File f(tmp_dir_, tmp_name_);
+            file_buffer_ = std::move(f);
+            buffer_proxy_.set(&file_buffer_);
+          }
         }
       }
     }
     void Client::imap_body_section_end()
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       if (state_ == State::FETCHING) {
         if (full_body_) {
-          buffer_proxy_.set(&buffer_);
-          file_buffer_.close();
-          if (flags_.empty()) {
-            maildir_.move_to_new();
-          } else  {
-            BOOST_LOG_SEV(lg_, Log::DEBUG) << "Using maildir flags: " << flags_;
-            maildir_.move_to_cur(flags_);
+          auto close_start = Metrics::Clock::now();
+          {
+            Perf::Scope scope(stages_.get(), Perf::Stage::FILE_WRITE);
+            if (opts_.raw) {
+              parser_.set_literal_sink(false);
+              literal_sink_.close();
+            } else {
+              buffer_proxy_.set(&buffer_);
+              file_buffer_.close();
+            }
           }
+          struct stat st;
+          size_t size = ::fstatat(maildir_.tmp_dir_fd(), tmp_name_.c_str(), &st, 0)
+            ? 0 : st.st_size;
+          {
+            Perf::Scope scope(stages_.get(), Perf::Stage::MAILDIR_MOVE);
+            IMAPDL_ALLOC_TAG("maildir move");
+            if (flags_.empty()) {
+              maildir_.move_to_new();
+            } else  {
+              IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Using maildir flags: " << flags_;
+              maildir_.move_to_cur(flags_);
+            }
+          }
+          auto now = Metrics::Clock::now();
+          metrics_.delivered(size, now - literal_start_, now - close_start);
           full_body_ = false;
           fetch_timer_.increase_messages();
         } else {
+          Perf::Scope scope(stages_.get(), Perf::Stage::HEADER_PRINT);
+          IMAPDL_ALLOC_TAG("header print");
           header_printer_.print();
         }
       }
     }
+    void Client::imap_literal_data(const char *begin, const char *end)
+    {
+      Perf::Scope scope(stages_.get(), Perf::Stage::FILE_WRITE);
+      literal_sink_.write(begin, end);
+    }
     void Client::imap_flag(Flag flag)
     {
       switch (flag) {
@@ -578,9 +776,9 @@ namespace IMAP {
     }
     void Client::imap_uid(uint32_t number)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       if (state_ == State::FETCHING) {
-        BOOST_LOG_SEV(lg_, Log::DEBUG) << "UID: " << number;
+        IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "UID: " << number;
         last_uid_ = number;
       }
     }
@@ -593,7 +791,7 @@ namespace IMAP {
     {
       using namespace IMAP::Server::Response;
       if (buffer_.empty()) {
-        BOOST_LOG_SEV(lg_, Log::MSG) << "NIL-Mailbox";
+        IMAPDL_LOG_SEV(lg_, Log::MSG) << "NIL-Mailbox";
         return;
       }
       string m(buffer_.begin(), buffer_.end());
@@ -602,7 +800,7 @@ namespace IMAP {
         x = '+';
       else if (oflags_.find(OFlag::HASNOCHILDREN) != oflags_.end())
           x = '|';
-      BOOST_LOG_SEV(lg_, Log::MSG) << "Mailbox: -" << x << ' ' << m;
+      IMAPDL_LOG_SEV(lg_, Log::MSG) << "Mailbox: -" << x << ' ' << m;
     }
     void Client::imap_list_oflag(IMAP::Server::Response::OFlag o)
     {
@@ -26,13 +26,18 @@
 #include <copy/state.h>
 #include <copy/fetch_timer.h>
 #include <copy/header_printer.h>
+#include <copy/journal.h>
+#include <copy/literal_sink.h>
+#include <copy/metrics.h>
 
 #include <net/tcp_client.h>
 #include <net/client_application.h>
+#include <net/resolve_cache.h>
 #include <imap/client_parser.h>
 #include <imap/client_writer.h>
 #include <imap/client_base.h>
 #include <log/log.h>
+#include <perf/stages.h>
 #include <maildir/maildir.h>
 #include <buffer/buffer.h>
 #include <buffer/file.h>
@@ -43,6 +48,7 @@
 #include <chrono>
 #include <vector>
 #include <functional>
+#include <memory>
 
 #include <boost/asio/basic_waitable_timer.hpp>
 
@@ -56,6 +62,7 @@ namespace IMAP {
         boost::log::sources::severity_logger<Log::Severity> &lg_;
         const Options          &opts_;
         Net::Client::Base      &client_;
+        std::unique_ptr<Net::Resolve_Cache> resolve_cache_;
         Net::Client::Application app_;
         boost::asio::signal_set signals_;
         unsigned                signaled_ {0};
@@ -65,9 +72,11 @@ namespace IMAP {
         Maildir                 maildir_;
         Memory::Dir             tmp_dir_;
         Memory::Buffer::File    file_buffer_;
+        Literal_Sink            literal_sink_;
         IMAP::Client::Parser    parser_;
 
         bool          need_cleanup_ {false};
+        bool          splice_       {true};
         State         state_        {State::DISCONNECTED };
 
         unsigned      exists_      {0};
@@ -75,6 +84,7 @@ namespace IMAP {
         unsigned      uidvalidity_ {0};
         uint32_t      last_uid_    {0};
         Sequence_Set  uids_;
+        Journal_Writer journal_writer_;
         std::unordered_set<IMAP::Server::Response::Capability> capabilities_;
         bool          full_body_   {false};
         std::string   flags_;
@@ -84,12 +94,25 @@ namespace IMAP {
         Fetch_Timer    fetch_timer_;
         Header_Printer header_printer_;
 
+        Metrics        metrics_;
+        boost::asio::basic_waitable_timer<std::chrono::steady_clock> metrics_timer_;
+        Metrics::Clock::time_point literal_start_;
+        std::string    tmp_name_;
+        // only with --perf
+        std::unique_ptr<Perf::Stages> stages_;
+
         void read_journal();
         void write_journal();
+        void clear_uids();
 
         void do_signal_wait();
+        void do_metrics_wait();
+        void write_metrics();
+        // fn that adds the time until it is called to the phase
+        Done_Fn timed(Metrics::Phase phase, Done_Fn fn);
 
         void do_read();
+        void do_splice();
         void write_command(vector<char> &cmd);
 
         bool has_uidplus() const;
@@ -97,17 +120,18 @@ namespace IMAP {
         // specialized download client functions
         void do_pre_login();
         void do_post_login();
-        void async_login_capabilities(std::function<void(void)> fn);
-        void cond_async_capabilities(std::function<void(void)> fn);
-        void async_login(std::function<void(void)> fn);
-        void async_select(std::function<void(void)> fn);
-        void async_fetch_header(std::function<void(void)> fn);
-        void async_fetch(std::function<void(void)> fn);
-        void async_list(std::function<void(void)> fn);
-        void async_store(std::function<void(void)> fn);
-        void async_uid_or_simple_expunge(std::function<void(void)> fn);
-        void async_uid_expunge(std::function<void(void)> fn);
-        void async_cleanup(std::function<void(void)> fn);
+        void async_login_capabilities(Done_Fn fn);
+        void cond_async_capabilities(Done_Fn fn);
+        void async_login(Done_Fn fn);
+        void async_select(Done_Fn fn);
+        void async_fetch_header(Done_Fn fn);
+        void async_fetch(Done_Fn fn);
+        void async_list(Done_Fn fn);
+        void async_store(Done_Fn fn);
+        void async_uid_or_simple_expunge(Done_Fn fn);
+        void async_uid_expunge(Done_Fn fn);
+        void async_cleanup(Done_Fn fn);
+        void async_logout(Done_Fn fn);
         void do_list();
         void do_fetch_header();
         void do_download();
@@ -119,6 +143,9 @@ namespace IMAP {
             boost::log::sources::severity_logger< Log::Severity > &lg);
         ~Client();
 
+        size_t messages() const;
+        size_t bytes_read() const;
+
       protected:
         void imap_status_code_capability_begin() override;
         void imap_capability_begin() override;
@@ -133,6 +160,7 @@ namespace IMAP {
         void imap_section_empty() override;
         void imap_body_section_inner() override;
         void imap_body_section_end() override;
+        void imap_literal_data(const char *begin, const char *end) override;
         void imap_flag(Flag flag) override;
         void imap_uid(uint32_t number) override;
 
@@ -49,7 +49,7 @@ namespace IMAP {
         (fetch_stop - start_);
       size_t b = client_.bytes_read() - bytes_start_;
       double r = (double(b)*1024.0)/(double(d.count())*1000.0);
-      BOOST_LOG_SEV(lg_, Log::MSG) << "Fetched " << messages_
+      IMAPDL_LOG_SEV(lg_, Log::MSG) << "Fetched " << messages_
         << " messages (" << b << " bytes) in " << double(d.count())/1000.0
         << " s (@ " << r << " KiB/s)";
     }
@@ -59,6 +59,7 @@ namespace IMAP {
       start_ = chrono::steady_clock::now();
       bytes_start_ = client_.bytes_read();
       stopped_ = false;
+      got_literal_ = false;
 
       resume();
     }
@@ -68,7 +69,7 @@ namespace IMAP {
       timer_.expires_from_now(std::chrono::seconds(1));
       timer_.async_wait([this](const boost::system::error_code &ec)
           {
-            BOOST_LOG_FUNCTION();
+            IMAPDL_LOG_FUNCTION();
             if (stopped_)
               return;
             if (ec) {
@@ -87,6 +88,15 @@ namespace IMAP {
       print();
       timer_.cancel();
     }
+    void Fetch_Timer::first_literal()
+    {
+      if (got_literal_)
+        return;
+      got_literal_ = true;
+      auto d = chrono::duration_cast<chrono::microseconds>
+        (chrono::steady_clock::now() - start_);
+      BOOST_LOG(lg_) << "First literal after " << double(d.count())/1000.0 << " ms";
+    }
     void Fetch_Timer::increase_messages()
     {
       ++messages_;
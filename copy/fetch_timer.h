@@ -42,6 +42,7 @@ namespace IMAP {
         size_t bytes_start_ {0};
         size_t messages_  {0};
         bool stopped_ {false};
+        bool got_literal_ {false};
       public:
         Fetch_Timer(
             Net::Client::Base &client,
@@ -52,6 +53,8 @@ namespace IMAP {
         void stop();
         void print();
         void increase_messages();
+        // logs the time to the first message literal (once per start())
+        void first_literal();
         size_t messages() const;
     };
 
@@ -64,7 +64,7 @@ namespace IMAP {
           || static_cast<Log::Severity>(opts_.file_severity)
                  >= Log::Severity::DEBUG) {
         string s(buffer_.begin(), buffer_.end());
-        BOOST_LOG_SEV(lg_, Log::DEBUG) << "Header: |" << s << "|";
+        IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Header: |" << s << "|";
       }
       header_decoder_.clear();
       fields_.clear();
@@ -72,10 +72,10 @@ namespace IMAP {
         header_decoder_.read(buffer_.begin(), buffer_.end());
         header_decoder_.verify_finished();
       } catch (const std::runtime_error &e) {
-        BOOST_LOG_SEV(lg_, Log::ERROR) << e.what();
+        IMAPDL_LOG_SEV(lg_, Log::ERROR) << e.what();
       }
       for (auto &i : fields_) {
-        BOOST_LOG_SEV(lg_, Log::INFO)
+        IMAPDL_LOG_SEV(lg_, Log::INFO)
           << setw(10) << left << i.first << ' ' << i.second;
       }
       pretty_print();
@@ -94,7 +94,7 @@ namespace IMAP {
           line_.append(" / ");
         ++j;
       }
-      BOOST_LOG_SEV(lg_, Log::MSG) << line_;
+      IMAPDL_LOG_SEV(lg_, Log::MSG) << line_;
     }
 
 
@@ -21,18 +21,35 @@
 #include "journal.h"
 //#include "client.h"
 
+#include <exception.h>
+
 #include <boost/archive/text_iarchive.hpp>
-#include <boost/archive/text_oarchive.hpp>
+#include <boost/serialization/string.hpp>
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/utility.hpp>
 #include <boost/serialization/version.hpp>
 #include <boost/serialization/tracking.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/crc.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <ixxx/posix.h>
 
 #include <fstream>
+#include <iterator>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <errno.h>
 using namespace std;
 
 #include "sequence_set.h"
 
+namespace fs = boost::filesystem;
+using namespace ixxx;
+
+// the previous journal format
 namespace boost {
   namespace serialization {
 
@@ -51,6 +68,69 @@ BOOST_CLASS_TRACKING(IMAP::Copy::Journal, boost::serialization::track_never)
 namespace IMAP {
   namespace Copy {
 
+    static const char magic[8] = { 'i', 'm', 'a', 'p', 'd', 'l', 'J', '1' };
+
+    static void put_varint(string &s, uint32_t x)
+    {
+      while (x >= 0x80) {
+        s.push_back(char(x | 0x80));
+        x >>= 7;
+      }
+      s.push_back(char(x));
+    }
+    static bool get_varint(const char *&p, const char *e, uint32_t &x)
+    {
+      x = 0;
+      for (unsigned shift = 0; p != e && shift < 35; shift += 7) {
+        unsigned char c = *p++;
+        x |= uint32_t(c & 0x7f) << shift;
+        if (!(c & 0x80))
+          return true;
+      }
+      return false;
+    }
+
+    // payload has to start at offset 6 of s, i.e. there is room for
+    // the type and the largest length varint
+    static void finish_record(string &s, char type)
+    {
+      string head;
+      head.push_back(type);
+      put_varint(head, uint32_t(s.size() - 6));
+      size_t off = 6 - head.size();
+      s.replace(off, head.size(), head);
+      boost::crc_32_type crc;
+      crc.process_block(s.data() + off, s.data() + s.size());
+      uint32_t c = crc.checksum();
+      for (unsigned i = 0; i < 4; ++i)
+        s.push_back(char(c >> (8 * i)));
+      s.erase(0, off);
+    }
+    static void append_runs(string &s,
+        const vector<pair<uint32_t, uint32_t> > &v)
+    {
+      uint32_t prev = 0;
+      for (auto &x : v) {
+        put_varint(s, x.first - prev);
+        put_varint(s, x.second - x.first);
+        prev = x.second;
+      }
+    }
+    static void write_all(int fd, const string &s)
+    {
+      const char *p = s.data();
+      const char *e = p + s.size();
+      while (p != e)
+        p += posix::write(fd, p, e - p);
+    }
+    static void sync_data(int fd)
+    {
+      if (fdatasync(fd) == -1) {
+        boost::system::error_code ec(errno, boost::system::system_category());
+        THROW_ERROR(ec);
+      }
+    }
+
     Journal::Journal(const string &mailbox, uint32_t uidvalidity, const Sequence_Set &set)
       :
         mailbox_(mailbox),
@@ -62,23 +142,207 @@ namespace IMAP {
     {
     }
 
+    static void add_run(vector<pair<uint32_t, uint32_t> > &v,
+        uint32_t first, uint32_t last)
+    {
+      if (!v.empty() && v.back().second != UINT32_MAX
+          && first <= v.back().second + 1 && first >= v.back().first) {
+        if (last > v.back().second)
+          v.back().second = last;
+        return;
+      }
+      v.emplace_back(first, last);
+    }
+
     void Journal::read(const std::string &filename)
     {
-      ifstream f;
-      f.exceptions(ofstream::failbit | ofstream::badbit );
-      f.open(filename, ofstream::in | ofstream::binary);
-      boost::archive::text_iarchive a(f);
-      a >> *this;
+      string s;
+      {
+        ifstream f;
+        f.exceptions(ofstream::failbit | ofstream::badbit );
+        f.open(filename, ofstream::in | ofstream::binary);
+        f.exceptions(ofstream::badbit);
+        s.assign(istreambuf_iterator<char>(f), istreambuf_iterator<char>());
+      }
+      mailbox_.clear();
+      uidvalidity_ = 0;
+      uids_.clear();
+      if (s.size() < sizeof magic && !memcmp(s.data(), magic, s.size()))
+        return;
+      if (s.size() < sizeof magic || memcmp(s.data(), magic, sizeof magic)) {
+        ifstream f;
+        f.exceptions(ofstream::failbit | ofstream::badbit );
+        f.open(filename, ofstream::in | ofstream::binary);
+        // a failbit exception escaping the archive would terminate
+        f.exceptions(ofstream::badbit);
+        boost::archive::text_iarchive a(f);
+        a >> *this;
+        return;
+      }
+      const char *p = s.data() + sizeof magic;
+      const char *e = s.data() + s.size();
+      while (p != e) {
+        const char *b = p;
+        char type = *p++;
+        uint32_t n = 0;
+        if (!get_varint(p, e, n) || size_t(e - p) < size_t(n) + 4)
+          break;
+        const char *payload = p;
+        const char *payload_end = p + n;
+        p = payload_end + 4;
+        uint32_t c = 0;
+        for (unsigned i = 0; i < 4; ++i)
+          c |= uint32_t(static_cast<unsigned char>(payload_end[i])) << (8 * i);
+        boost::crc_32_type crc;
+        crc.process_block(b, payload_end);
+        if (crc.checksum() != c)
+          break;
+        const char *q = payload;
+        switch (type) {
+          case 'M':
+            {
+              uint32_t v = 0;
+              if (!get_varint(q, payload_end, v))
+                return;
+              string m(q, payload_end);
+              if (m != mailbox_ || v != uidvalidity_)
+                uids_.clear();
+              mailbox_ = std::move(m);
+              uidvalidity_ = v;
+            }
+            break;
+          case 'U':
+            {
+              uint32_t prev = 0;
+              while (q != payload_end) {
+                uint32_t delta = 0, len = 0;
+                if (!get_varint(q, payload_end, delta)
+                    || !get_varint(q, payload_end, len))
+                  return;
+                uint32_t first = prev + delta;
+                prev = first + len;
+                add_run(uids_, first, prev);
+              }
+            }
+            break;
+          case 'C':
+            uids_.clear();
+            break;
+          default:
+            return;
+        }
+      }
     }
     void Journal::write(const std::string &filename)
     {
-      ofstream f;
-      f.exceptions(ofstream::failbit | ofstream::badbit );
-      f.open(filename, ofstream::out | ofstream::binary);
-      boost::archive::text_oarchive a(f);
-      a << *this;
+      string s(magic, sizeof magic);
+      {
+        string r(6, 0);
+        put_varint(r, uidvalidity_);
+        r += mailbox_;
+        finish_record(r, 'M');
+        s += r;
+      }
+      if (!uids_.empty()) {
+        string r(6, 0);
+        append_runs(r, uids_);
+        finish_record(r, 'U');
+        s += r;
+      }
+      string tmp(filename);
+      tmp += ".tmp";
+      int fd = posix::open(tmp, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0600);
+      try {
+        write_all(fd, s);
+        sync_data(fd);
+      } catch (...) {
+        ::close(fd);
+        throw;
+      }
+      posix::close(fd);
+      fs::rename(tmp, filename);
+      // make the rename itself durable
+      fs::path dir(fs::path(filename).parent_path());
+      int dir_fd = posix::open(dir.empty() ? string(".") : dir.string(),
+          O_RDONLY | O_CLOEXEC);
+      try {
+        posix::fsync(dir_fd);
+      } catch (...) {
+        ::close(dir_fd);
+        throw;
+      }
+      posix::close(dir_fd);
     }
 
+    Journal_Writer::Journal_Writer()
+    {
+    }
+    Journal_Writer::~Journal_Writer()
+    {
+      if (fd_ != -1)
+        ::close(fd_);
+    }
+    void Journal_Writer::open(const std::string &filename)
+    {
+      if (fd_ != -1)
+        THROW_LOGIC_MSG("journal is already open");
+      fd_ = posix::open(filename, O_CREAT | O_APPEND | O_WRONLY | O_CLOEXEC, 0600);
+      struct stat st;
+      posix::fstat(fd_, &st);
+      if (!st.st_size)
+        write_all(fd_, string(magic, sizeof magic));
+      has_mailbox_ = false;
+    }
+    bool Journal_Writer::is_open() const
+    {
+      return fd_ != -1;
+    }
+    void Journal_Writer::append()
+    {
+      write_all(fd_, buffer_);
+    }
+    void Journal_Writer::push(const std::string &mailbox, uint32_t uidvalidity,
+        uint32_t uid)
+    {
+      buffer_.clear();
+      if (!has_mailbox_ || mailbox != mailbox_ || uidvalidity != uidvalidity_) {
+        string r(6, 0);
+        put_varint(r, uidvalidity);
+        r += mailbox;
+        finish_record(r, 'M');
+        buffer_ += r;
+        mailbox_ = mailbox;
+        uidvalidity_ = uidvalidity;
+        has_mailbox_ = true;
+      }
+      string r(6, 0);
+      put_varint(r, uid);
+      put_varint(r, 0);
+      finish_record(r, 'U');
+      buffer_ += r;
+      append();
+    }
+    void Journal_Writer::clear()
+    {
+      if (fd_ == -1)
+        return;
+      buffer_.assign(6, 0);
+      finish_record(buffer_, 'C');
+      append();
+    }
+    void Journal_Writer::sync()
+    {
+      if (fd_ != -1)
+        sync_data(fd_);
+    }
+    void Journal_Writer::close()
+    {
+      if (fd_ == -1)
+        return;
+      int fd = fd_;
+      fd_ = -1;
+      posix::close(fd);
+    }
 
   }
 }
@@ -31,6 +31,22 @@ class Sequence_Set;
 namespace IMAP {
   namespace Copy {
 
+    // Binary journal file format:
+    //
+    //     magic record*
+    //     record = type length payload crc32
+    //
+    // length is a varint (LEB128), crc32 (little endian) covers
+    // type, length and payload. Record types:
+    //
+    //     'M' varint(uidvalidity) mailbox-name - switch mailbox, i.e.
+    //         forget the UIDs if mailbox or uidvalidity change
+    //     'U' (varint(first - previous last) varint(last - first))* -
+    //         add UID runs, delta-encoded
+    //     'C' - forget the UIDs (i.e. they are expunged)
+    //
+    // Reading stops at the first incomplete or corrupt record,
+    // e.g. one that was torn by a crash.
     struct Journal {
       std::string mailbox_;
       uint32_t uidvalidity_ {0};
@@ -38,10 +54,37 @@ namespace IMAP {
 
       Journal();
       Journal(const std::string &mailbox, uint32_t uidvalidity, const Sequence_Set &set);
+      // also reads the old Boost text archive format
       void read(const std::string &filename);
+      // compacted, replaces the file atomically
       void write(const std::string &filename);
     };
 
+    // Appends to a journal file - appended records are durable after sync()
+    class Journal_Writer {
+      private:
+        int         fd_          {-1};
+        std::string mailbox_;
+        uint32_t    uidvalidity_ {0};
+        bool        has_mailbox_ {false};
+        std::string buffer_;
+
+        void append();
+      public:
+        Journal_Writer();
+        ~Journal_Writer();
+        Journal_Writer(const Journal_Writer &) =delete;
+        Journal_Writer &operator=(const Journal_Writer &) =delete;
+
+        void open(const std::string &filename);
+        bool is_open() const;
+        void push(const std::string &mailbox, uint32_t uidvalidity, uint32_t uid);
+        // no-op if not open
+        void clear();
+        void sync();
+        void close();
+    };
+
   }
 }
 
@@ -0,0 +1,78 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "literal_sink.h"
+
+#include <exception.h>
+
+#include <ixxx/posix.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace ixxx;
+
+namespace IMAP {
+  namespace Copy {
+
+    Literal_Sink::Literal_Sink(int dir_fd)
+      :
+        dir_fd_(dir_fd)
+    {
+    }
+    Literal_Sink::~Literal_Sink()
+    {
+      if (fd_ != -1)
+        ::close(fd_);
+    }
+    void Literal_Sink::open(const std::string &filename)
+    {
+      if (fd_ != -1)
+        THROW_LOGIC_MSG("literal sink file is already open");
+      fd_ = posix::openat(dir_fd_, filename,
+          O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0666);
+    }
+    void Literal_Sink::write(const char *begin, const char *end)
+    {
+      while (begin != end) {
+        auto r = posix::write(fd_, begin, end - begin);
+        begin += r;
+      }
+    }
+    void Literal_Sink::close()
+    {
+      if (fd_ == -1)
+        return;
+      posix::fsync(fd_);
+      int fd = fd_;
+      fd_ = -1;
+      posix::close(fd);
+    }
+    bool Literal_Sink::is_open() const
+    {
+      return fd_ != -1;
+    }
+    int Literal_Sink::fd() const
+    {
+      return fd_;
+    }
+
+  }
+}
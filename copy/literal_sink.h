@@ -0,0 +1,53 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef COPY_LITERAL_SINK_H
+#define COPY_LITERAL_SINK_H
+
+#include <string>
+
+namespace IMAP {
+  namespace Copy {
+
+    // Writes a message literal directly into a file of the maildir tmp
+    // directory, i.e. the content doesn't go through the parser buffers
+    // (cf. IMAP::Client::Parser::set_literal_sink()).
+    class Literal_Sink {
+      private:
+        int dir_fd_ {-1};
+        int fd_     {-1};
+      public:
+        Literal_Sink(int dir_fd);
+        ~Literal_Sink();
+        Literal_Sink(const Literal_Sink &) =delete;
+        Literal_Sink &operator=(const Literal_Sink &) =delete;
+
+        void open(const std::string &filename);
+        void write(const char *begin, const char *end);
+        // syncs the content to disk
+        void close();
+        bool is_open() const;
+        int fd() const;
+    };
+
+  }
+}
+
+#endif
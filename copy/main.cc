@@ -19,8 +19,11 @@
 
 }}} */
 #include "client.h"
+#include "accounts.h"
 #include "options.h"
+#include <net/pipeline.h>
 #include <log/log.h>
+#include <trace/trace.h>
 
 using namespace IMAP::Copy;
 
@@ -28,6 +31,7 @@ using namespace IMAP::Copy;
 #include <exception>
 #include <iostream>
 #include <memory>
+#include <sstream>
 using namespace std;
 
 #include <boost/log/sources/record_ostream.hpp>
@@ -44,46 +48,100 @@ int main(int argc, char **argv)
             static_cast<Log::Severity>(opts.file_severity),
             opts.logfile));
 
+    if (opts.multi()) {
+      bool ok = false;
+      try {
+        Accounts accounts(argc, argv, opts, lg);
+        if (opts.poll) {
+          accounts.poll();
+          ok = true;
+        } else {
+          ok = accounts.run();
+        }
+        ostringstream o;
+        accounts.print_summary(o);
+        IMAPDL_LOG_SEV(lg, Log::MSG) << "Summary:\n" << o.str();
+      } catch (const exception &e) {
+        IMAPDL_LOG_SEV(lg, Log::ERROR) << e.what();
+      }
+      Log::finish();
+      return ok ? 0 : 1;
+    }
+
+    // outlives the clients, thus it can be dumped after an exception
+    unique_ptr<Trace::Ring> flight_recorder;
+    if (opts.flight_recorder)
+      flight_recorder = unique_ptr<Trace::Ring>(
+          new Trace::Ring(size_t(opts.flight_recorder) * 1024 * 1024));
+
     try {
       BOOST_LOG(lg) << "Startup.";
       BOOST_LOG(lg) << "Username: |" << opts.username << "|";
-      BOOST_LOG_SEV(lg, Log::INSANE) << "Password: |" << opts.password << "|";
+      IMAPDL_LOG_SEV(lg, Log::INSANE) << "Password: |" << opts.password << "|";
       BOOST_LOG(lg) << "Parsing options ... done";
 
       boost::asio::io_service io_service;
       boost::asio::ssl::context context(boost::asio::ssl::context::sslv23);
 
+      // with a pipeline, the connection is driven by a second thread
+      boost::asio::io_service net_io_service;
+      boost::log::sources::severity_logger<Log::Severity> net_lg(lg);
+      auto &nio = opts.pipeline ? net_io_service : io_service;
+      auto &nlg = opts.pipeline ? net_lg         : lg;
+
       unique_ptr<Net::Client::Base> net_client;
       if (opts.use_ssl) {
         unique_ptr<Net::Client::Base> c(
-            new Net::TCP::SSL::Client::Base(io_service, context, opts, lg));
+            new Net::TCP::SSL::Client::Base(nio, context, opts, nlg));
         net_client = std::move(c);
       } else {
         unique_ptr<Net::Client::Base> c(
-            new Net::TCP::Client::Base(io_service, opts, lg));
+            new Net::TCP::Client::Base(nio, opts, nlg));
         net_client = std::move(c);
       }
-      IMAP::Copy::Client client(opts, *net_client, lg);
+      net_client->set_flight_recorder(flight_recorder.get());
+      unique_ptr<Net::Client::Base> pipeline;
+      if (opts.pipeline) {
+        unique_ptr<Net::Client::Base> c(
+            new Net::Client::Pipeline(io_service, net_io_service, *net_client,
+              opts.pipeline, lg));
+        pipeline = std::move(c);
+      }
+      IMAP::Copy::Client client(opts, pipeline ? *pipeline : *net_client, lg);
 
       io_service.run();
     } catch (const exception &e) {
-      BOOST_LOG_SEV(lg, Log::ERROR) << e.what();
+      IMAPDL_LOG_SEV(lg, Log::ERROR) << e.what();
 
       auto tfu = boost::get_error_info<boost::throw_function>(e);
       auto tfi = boost::get_error_info<boost::throw_file>(e);
       auto tl  = boost::get_error_info<boost::throw_line>(e);
-      BOOST_LOG_SEV(lg, Log::DEBUG) << "in "
+      IMAPDL_LOG_SEV(lg, Log::DEBUG) << "in "
         << (tfu?*tfu:"") << " (" << (tfi?*tfi:"") << ':' << (tl?*tl:0) << ")"
         ;
       auto si = boost::get_error_info<boost::log::current_scope_info>(e);
       if (si)
-        BOOST_LOG_SEV(lg, Log::DEBUG) << "Scope stack: " << *si;
-
-      //BOOST_LOG_SEV(lg, Log::ERROR) << boost::diagnostic_information(e);
+        IMAPDL_LOG_SEV(lg, Log::DEBUG) << "Scope stack: " << *si;
+
+      //IMAPDL_LOG_SEV(lg, Log::ERROR) << boost::diagnostic_information(e);
+
+      if (flight_recorder && !flight_recorder->empty()) {
+        try {
+          flight_recorder->dump(opts.flight_recorder_file);
+          IMAPDL_LOG_SEV(lg, Log::ERROR) << "Wrote last messages to "
+            << opts.flight_recorder_file << " (see replay)";
+        } catch (const exception &f) {
+          IMAPDL_LOG_SEV(lg, Log::ERROR) << "Could not write flight recorder: "
+            << f.what();
+        }
+      }
 
+      Log::finish();
       return 1;
     }
+    Log::finish();
   } catch (const exception &e) {
+    Log::finish();
     cerr << "Error: " << e.what() << '\n';
     return 1;
   }
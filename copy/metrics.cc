@@ -0,0 +1,225 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "metrics.h"
+
+#include <enum.h>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <time.h>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace IMAP {
+  namespace Copy {
+
+    static const char *const phase_map[] = {
+      "connect",
+      "login",
+      "select",
+      "list",
+      "fetch",
+      "store",
+      "expunge",
+      "logout"
+    };
+    std::ostream &operator<<(std::ostream &o, Metrics::Phase p)
+    {
+      o << enum_str(phase_map, p);
+      return o;
+    }
+
+    static double to_seconds(Metrics::Clock::duration d)
+    {
+      return chrono::duration<double>(d).count();
+    }
+
+    double thread_cpu_seconds()
+    {
+      struct timespec ts;
+      if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        return 0;
+      return double(ts.tv_sec) + double(ts.tv_nsec) / 1e9;
+    }
+
+    Metrics::Histogram::Histogram(std::vector<double> bounds)
+      :
+        bounds_(std::move(bounds)),
+        counts_(bounds_.size() + 1)
+    {
+    }
+    void Metrics::Histogram::observe(double v)
+    {
+      auto i = lower_bound(bounds_.begin(), bounds_.end(), v);
+      ++counts_[i - bounds_.begin()];
+      sum_ += v;
+      ++count_;
+    }
+    void Metrics::Histogram::print_json(std::ostream &o) const
+    {
+      o << "{ \"count\": " << count_ << ", \"sum\": " << sum_
+        << ", \"buckets\": [";
+      uint64_t n = 0;
+      for (size_t i = 0; i < bounds_.size(); ++i) {
+        n += counts_[i];
+        o << (i ? ", " : " ") << "[" << bounds_[i] << ", " << n << "]";
+      }
+      o << " ] }";
+    }
+    void Metrics::Histogram::print_prometheus(std::ostream &o,
+        const char *name, const char *help) const
+    {
+      o << "# HELP " << name << ' ' << help << '\n'
+        << "# TYPE " << name << " histogram\n";
+      uint64_t n = 0;
+      for (size_t i = 0; i < bounds_.size(); ++i) {
+        n += counts_[i];
+        o << name << "_bucket{le=\"" << bounds_[i] << "\"} " << n << '\n';
+      }
+      o << name << "_bucket{le=\"+Inf\"} " << count_ << '\n'
+        << name << "_sum " << sum_ << '\n'
+        << name << "_count " << count_ << '\n';
+    }
+
+    Metrics::Metrics()
+      :
+        message_size_({ 1024, 4096, 16384, 65536, 262144, 1048576,
+            4194304, 16777216, 67108864 }),
+        delivery_seconds_({ 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05,
+            0.1, 0.5, 1, 5 }),
+        fsync_seconds_({ 0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05,
+            0.1, 0.5, 1, 5 })
+    {
+    }
+
+    void Metrics::set_bytes(size_t read, size_t written)
+    {
+      bytes_read_    = read;
+      bytes_written_ = written;
+    }
+    void Metrics::delivered(size_t size, Clock::duration latency,
+        Clock::duration fsync)
+    {
+      ++messages_;
+      message_size_.observe(size);
+      delivery_seconds_.observe(to_seconds(latency));
+      fsync_seconds_.observe(to_seconds(fsync));
+    }
+    void Metrics::add_parser_cpu(double seconds)
+    {
+      parser_cpu_ += seconds;
+    }
+    void Metrics::add_phase(Phase phase, Clock::duration d)
+    {
+      phase_seconds_[size_t(phase) - 1] += to_seconds(d);
+    }
+    void Metrics::set_journal_replay(size_t uids)
+    {
+      journal_replay_ = uids;
+    }
+
+    void Metrics::print_json(std::ostream &o) const
+    {
+      o << setprecision(9)
+        << "{\n"
+        << "  \"bytes_read\": " << bytes_read_ << ",\n"
+        << "  \"bytes_written\": " << bytes_written_ << ",\n"
+        << "  \"messages\": " << messages_ << ",\n"
+        << "  \"journal_replay_uids\": " << journal_replay_ << ",\n"
+        << "  \"parser_cpu_seconds\": " << parser_cpu_ << ",\n"
+        << "  \"phase_seconds\": {";
+      for (size_t i = 0; i < phase_seconds_.size(); ++i)
+        o << (i ? ", " : " ") << '"' << phase_map[i] << "\": "
+          << phase_seconds_[i];
+      o << " },\n"
+        << "  \"message_size_bytes\": ";
+      message_size_.print_json(o);
+      o << ",\n  \"delivery_seconds\": ";
+      delivery_seconds_.print_json(o);
+      o << ",\n  \"fsync_seconds\": ";
+      fsync_seconds_.print_json(o);
+      o << "\n}\n";
+    }
+
+    void Metrics::print_prometheus(std::ostream &o) const
+    {
+      o << setprecision(9)
+        << "# HELP imapdl_bytes_read_total Bytes read from the IMAP server.\n"
+        << "# TYPE imapdl_bytes_read_total counter\n"
+        << "imapdl_bytes_read_total " << bytes_read_ << '\n'
+        << "# HELP imapdl_bytes_written_total Bytes written to the IMAP server.\n"
+        << "# TYPE imapdl_bytes_written_total counter\n"
+        << "imapdl_bytes_written_total " << bytes_written_ << '\n'
+        << "# HELP imapdl_messages_total Messages delivered into the maildir.\n"
+        << "# TYPE imapdl_messages_total counter\n"
+        << "imapdl_messages_total " << messages_ << '\n'
+        << "# HELP imapdl_journal_replay_uids UIDs read from the journal"
+           " of an interrupted run.\n"
+        << "# TYPE imapdl_journal_replay_uids gauge\n"
+        << "imapdl_journal_replay_uids " << journal_replay_ << '\n'
+        << "# HELP imapdl_parser_cpu_seconds_total CPU time spent in the"
+           " response parser, including its callbacks.\n"
+        << "# TYPE imapdl_parser_cpu_seconds_total counter\n"
+        << "imapdl_parser_cpu_seconds_total " << parser_cpu_ << '\n'
+        << "# HELP imapdl_phase_seconds_total Wall time per protocol phase.\n"
+        << "# TYPE imapdl_phase_seconds_total counter\n";
+      for (size_t i = 0; i < phase_seconds_.size(); ++i)
+        o << "imapdl_phase_seconds_total{phase=\"" << phase_map[i] << "\"} "
+          << phase_seconds_[i] << '\n';
+      message_size_.print_prometheus(o, "imapdl_message_size_bytes",
+          "Size of the delivered messages.");
+      delivery_seconds_.print_prometheus(o, "imapdl_delivery_seconds",
+          "Time from the start of a message literal until it is in the maildir.");
+      fsync_seconds_.print_prometheus(o, "imapdl_fsync_seconds",
+          "Time for closing (fsync) and moving a message file into the maildir.");
+    }
+
+    template <typename F>
+      static void write_atomically(const std::string &filename, F fn)
+      {
+        if (filename.empty())
+          return;
+        string tmp(filename);
+        tmp += ".tmp";
+        {
+          ofstream f;
+          f.exceptions(ofstream::failbit | ofstream::badbit);
+          f.open(tmp);
+          fn(f);
+        }
+        fs::rename(tmp, filename);
+      }
+
+    void Metrics::write(const std::string &json_file,
+        const std::string &prometheus_file) const
+    {
+      write_atomically(json_file,
+          [this](ostream &o) { print_json(o); });
+      write_atomically(prometheus_file,
+          [this](ostream &o) { print_prometheus(o); });
+    }
+
+  }
+}
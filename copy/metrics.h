@@ -0,0 +1,108 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef IMAP_COPY_METRICS_H
+#define IMAP_COPY_METRICS_H
+
+#include <array>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace IMAP {
+  namespace Copy {
+
+    // Run statistics - cheap enough to be always collected. They are
+    // written as JSON and/or in the Prometheus text format, e.g. for the
+    // textfile collector of the node exporter.
+    class Metrics {
+      public:
+        using Clock = std::chrono::steady_clock;
+
+        enum class Phase {
+          FIRST_,
+          CONNECT,
+          LOGIN,
+          SELECT,
+          LIST,
+          FETCH,
+          STORE,
+          EXPUNGE,
+          LOGOUT,
+          LAST_
+        };
+
+        // cumulative buckets, like a Prometheus histogram
+        class Histogram {
+          private:
+            std::vector<double>   bounds_;
+            // the last one is +Inf
+            std::vector<uint64_t> counts_;
+            double                sum_   {0};
+            uint64_t              count_ {0};
+          public:
+            Histogram(std::vector<double> bounds);
+            void observe(double v);
+            void print_json(std::ostream &o) const;
+            void print_prometheus(std::ostream &o, const char *name,
+                const char *help) const;
+        };
+
+      private:
+        size_t    bytes_read_     {0};
+        size_t    bytes_written_  {0};
+        size_t    messages_       {0};
+        size_t    journal_replay_ {0};
+        double    parser_cpu_     {0};
+        std::array<double, size_t(Phase::LAST_) - 1> phase_seconds_ {};
+        Histogram message_size_;
+        Histogram delivery_seconds_;
+        Histogram fsync_seconds_;
+
+      public:
+        Metrics();
+
+        void set_bytes(size_t read, size_t written);
+        // latency: from the start of the literal until the message is
+        // in the maildir, fsync: closing and moving the file
+        void delivered(size_t size, Clock::duration latency,
+            Clock::duration fsync);
+        void add_parser_cpu(double seconds);
+        void add_phase(Phase phase, Clock::duration d);
+        void set_journal_replay(size_t uids);
+
+        void print_json(std::ostream &o) const;
+        void print_prometheus(std::ostream &o) const;
+        // replaces the file(s) atomically - an empty filename is skipped
+        void write(const std::string &json_file,
+            const std::string &prometheus_file) const;
+    };
+    std::ostream &operator<<(std::ostream &o, Metrics::Phase p);
+
+    // CPU time of the calling thread in seconds
+    double thread_cpu_seconds();
+
+  }
+}
+
+#endif
@@ -57,6 +57,15 @@ namespace OPT {
   static const char LOCAL_ADDRESS[]  = "bind"          ;
   static const char LOCAL_PORT[]     = "lport"         ;
   static const char IP[]             = "ip"            ;
+  static const char CONNECT_DELAY[]  = "connect_delay" ;
+  static const char FAST_OPEN[]      = "fast_open"     ;
+  static const char NO_DELAY[]       = "no_delay"      ;
+  static const char QUICK_ACK[]      = "quick_ack"     ;
+  static const char RCVBUF[]         = "rcvbuf"        ;
+  static const char SNDBUF[]         = "sndbuf"        ;
+  static const char RESOLVE_CACHE[]  = "resolve_cache" ;
+  static const char RESOLVE_TTL[]    = "resolve_ttl"   ;
+  static const char PIPELINE[]       = "pipeline"      ;
 
   static const char FINGERPRINT[]    = "fp"            ;
   static const char CIPHER[]         = "cipher"        ;
@@ -68,14 +77,29 @@ namespace OPT {
   static const char TLS1[]           = "tls1"          ;
 
   static const char TRACEFILE[]      = "trace"         ;
+  static const char FLIGHT_RECORDER[] = "flight_recorder";
+  static const char FLIGHT_RECORDER_FILE[] = "flight_recorder_file";
+  static const char METRICS_JSON[]   = "metrics_json"  ;
+  static const char METRICS_FILE[]   = "metrics_prom"  ;
+  static const char METRICS_INTERVAL[] = "metrics_interval";
+  static const char PERF[]           = "perf"          ;
   static const char LOGFILE[]        = "log"           ;
 //  static const char SEVERITY[]       = "verbose"       ;
   static const char SEVERITY_S[]     = "verbose,v"     ;
   static const char FILE_SEVERITY[]  = "log_v"         ;
+  static const char LOG_BYTES[]      = "log_bytes"     ;
 
   static const char CONFIGFILE[]     = "config"        ;
 
   static const char ACCOUNT[]        = "account"       ;
+  static const char ALL_ACCOUNTS[]   = "all_accounts"  ;
+  static const char ACCOUNTS[]       = "accounts"      ;
+  static const char MAX_SESSIONS[]   = "max_sessions"  ;
+  static const char MAX_HOST_SESSIONS[] = "max_host_sessions";
+  static const char POLL[]           = "poll"          ;
+  static const char INTERVAL[]       = "interval"      ;
+  static const char MAX_INTERVAL[]   = "max_interval"  ;
+  static const char JITTER[]         = "jitter"        ;
 //  static const char DELETE[]         = "delete"        ;
   static const char DELETE_S[]       = "delete,d"      ;
   static const char MAILBOX[]        = "mailbox"       ;
@@ -83,6 +107,7 @@ namespace OPT {
   static const char GREETING_WAIT[]  = "gwait"         ;
   static const char SIMULATE_ERROR[] = "sim_error"     ;
   static const char JOURNAL_FILE[]   = "journal"       ;
+  static const char RAW[]            = "raw"           ;
   static const char FETCH_HEADER[]   = "header"        ;
   static const char LIST[]           = "list"          ;
   static const char LIST_REFERENCE[] = "list_reference";
@@ -98,6 +123,15 @@ namespace KEY {
   static const char LOCAL_PORT[]    = "lport"         ;
   static const char HOST[]          = "host"          ;
   static const char SERVICE[]       = "port"          ;
+  static const char CONNECT_DELAY[] = "connect_delay" ;
+  static const char FAST_OPEN[]     = "fast_open"     ;
+  static const char NO_DELAY[]      = "no_delay"      ;
+  static const char QUICK_ACK[]     = "quick_ack"     ;
+  static const char RCVBUF[]        = "rcvbuf"        ;
+  static const char SNDBUF[]        = "sndbuf"        ;
+  static const char RESOLVE_CACHE[] = "resolve_cache" ;
+  static const char RESOLVE_TTL[]   = "resolve_ttl"   ;
+  static const char PIPELINE[]      = "pipeline"      ;
 
   static const char SSL[]           = "ssl"           ;
   static const char FINGERPRINT[]   = "fingerprint"   ;
@@ -112,6 +146,9 @@ namespace KEY {
   static const char MAILBOX[]       = "mailbox"       ;
   static const char MAILDIR[]       = "maildir"       ;
   static const char JOURNAL_FILE[]   = "journal"       ;
+  static const char RAW[]           = "raw"           ;
+  static const char INTERVAL[]      = "interval"      ;
+  static const char MAX_INTERVAL[]  = "max_interval"  ;
 
   static const unordered_set<const char*> set = {
     USERNAME,
@@ -121,6 +158,15 @@ namespace KEY {
     LOCAL_PORT,
     HOST,
     SERVICE,
+    CONNECT_DELAY,
+    FAST_OPEN,
+    NO_DELAY,
+    QUICK_ACK,
+    RCVBUF,
+    SNDBUF,
+    RESOLVE_CACHE,
+    RESOLVE_TTL,
+    PIPELINE,
 
     SSL,
     FINGERPRINT,
@@ -134,7 +180,10 @@ namespace KEY {
     DELETE,
     MAILBOX,
     MAILDIR,
-    JOURNAL_FILE
+    JOURNAL_FILE,
+    RAW,
+    INTERVAL,
+    MAX_INTERVAL
   };
 }
 
@@ -170,6 +219,12 @@ namespace IMAP {
 
 
     Options::Options(int argc, char **argv)
+      :
+        Options(argc, argv, string())
+    {
+    }
+
+    Options::Options(int argc, char **argv, const std::string &the_account)
     {
       po::options_description hidden_group;
       //hidden_group.add_options()
@@ -201,8 +256,22 @@ namespace IMAP {
         configfile = vm[OPT::CONFIGFILE].as<string>();
       if (vm.count(OPT::ACCOUNT))
         account = vm[OPT::ACCOUNT].as<string>();
-      load();
+      if (!the_account.empty())
+        account = the_account;
+      bool top = the_account.empty()
+        && ((vm.count(OPT::ALL_ACCOUNTS) && vm[OPT::ALL_ACCOUNTS].as<bool>())
+            || vm.count(OPT::ACCOUNTS)
+            || (vm.count(OPT::POLL) && vm[OPT::POLL].as<bool>()));
+      // in multi mode the accounts are loaded one by one, later
+      if (top)
+        check_configfile();
+      else
+        load();
       po::notify(vm);
+      if (!the_account.empty())
+        account = the_account;
+      if (top)
+        return;
 
       fix();
       verify();
@@ -238,6 +307,28 @@ namespace IMAP {
         (OPT::HELP_S, "this help screen")
         (OPT::TRACEFILE, po::value<string>(&tracefile)->default_value(""),
            "trace file for capturing send/received messages")
+        (OPT::FLIGHT_RECORDER, po::value<unsigned>(&flight_recorder)->default_value(4),
+           "keep the last n MiB of send/received messages in memory and "
+           "write them to a trace file on error - 0 means disabled; message "
+           "bodies that are spliced into the maildir (--raw without TLS) "
+           "are recorded as 'X' bytes of the same length")
+        (OPT::FLIGHT_RECORDER_FILE, po::value<string>(&flight_recorder_file)
+         ->default_value("", "$HOME/.config/"  + string(ID::argv0) + "/$ACCOUNT.crash.trace"),
+           "trace file the flight recorder is dumped to")
+        (OPT::METRICS_JSON, po::value<string>(&metrics_json)->default_value(""),
+           "write run statistics as JSON to this file at exit")
+        (OPT::METRICS_FILE, po::value<string>(&metrics_file)->default_value(""),
+           "write run statistics in the Prometheus text format to this file "
+           "at exit, e.g. for the node exporter textfile collector (*.prom)")
+        (OPT::METRICS_INTERVAL, po::value<unsigned>(&metrics_interval)
+         ->default_value(0),
+           "also write the run statistics every n seconds - 0 means only at exit")
+        (OPT::PERF, po::value<bool>(&perf)
+         ->default_value(false, "false")
+         ->implicit_value(true, "true")->value_name("bool"),
+           "sample wall time and hardware counters (perf_event_open) per "
+           "stage (network read, parsing, header printing, file writes, "
+           "maildir moves) and report them at the end")
         (OPT::LOGFILE, po::value<string>(&logfile)->default_value(""),
            "also write log messages to a file")
         (OPT::SEVERITY_S,
@@ -250,6 +341,8 @@ namespace IMAP {
            ->default_value(0, "same as non-file")
            ->implicit_value(7), //->value_name("bool"),
            "default verbosity for log file, level, 0 means nothing - higher means more")
+        (OPT::LOG_BYTES, po::value<unsigned>(&log_bytes)->default_value(log_bytes),
+           "log at most n bytes of each read/write (verbosity 7) - 0 means all")
         ;
     }
     void Options_Priv::add_net_opts(po::options_description &net_group)
@@ -268,6 +361,41 @@ namespace IMAP {
            //->default_value("", "imaps or imap"),
            , "remote service name or port - usually imaps=993 (SSL) and imap=143"
            " (default: imaps or imap)")
+        (OPT::CONNECT_DELAY, po::value<unsigned>(&connect_delay)
+           //->default_value(250),
+           , "delay (in msec) before racing the next resolved address "
+           "(IPv6/IPv4 interleaved) - 0 means one attempt at a time (default: 250)")
+        (OPT::FAST_OPEN, po::value<bool>(&fast_open)
+           //->default_value(false, "false")
+           ->implicit_value(true, "true")->value_name("bool"),
+           "use TCP Fast Open (Linux), i.e. send the TLS ClientHello in the "
+           "SYN - requires SSL/TLS; since connect then completes immediately, "
+           "endpoints aren't raced (default: false)")
+        (OPT::NO_DELAY, po::value<bool>(&no_delay)
+           //->default_value(false, "false")
+           ->implicit_value(true, "true")->value_name("bool"),
+           "disable Nagle's algorithm (TCP_NODELAY) for command writes (default: false)")
+        (OPT::QUICK_ACK, po::value<bool>(&quick_ack)
+           //->default_value(false, "false")
+           ->implicit_value(true, "true")->value_name("bool"),
+           "acknowledge immediately (TCP_QUICKACK, Linux) while fetching (default: false)")
+        (OPT::RCVBUF, po::value<unsigned>(&rcvbuf)
+           //->default_value(0),
+           , "socket receive buffer size (SO_RCVBUF) - 0 means system default (default: 0)")
+        (OPT::SNDBUF, po::value<unsigned>(&sndbuf)
+           //->default_value(0),
+           , "socket send buffer size (SO_SNDBUF) - 0 means system default (default: 0)")
+        (OPT::RESOLVE_CACHE, po::value<string>(&resolve_cache)
+           //->default_value(""),
+           , "file for caching resolved addresses - cached addresses are used "
+           "immediately and refreshed in the background (default: \"\", i.e. no cache)")
+        (OPT::RESOLVE_TTL, po::value<unsigned>(&resolve_ttl)
+           //->default_value(3600),
+           , "time (in seconds) resolve cache entries are valid (default: 3600)")
+        (OPT::PIPELINE, po::value<unsigned>(&pipeline)
+           //->default_value(0),
+           , "read and decrypt on a separate thread that queues at most n "
+           "received buffers for parsing - 0 means single-threaded (default: 0)")
         ;
     }
     void Options_Priv::add_ssl_opts(po::options_description &ssl_group)
@@ -319,6 +447,35 @@ namespace IMAP {
       imap_group.add_options()
         (OPT::ACCOUNT, po::value<string>(&account)->default_value("default"),
            "account name - is used to find section in configuration file")
+        (OPT::ALL_ACCOUNTS, po::value<bool>(&all_accounts)
+         ->default_value(false, "false")
+         ->implicit_value(true, "true")->value_name("bool"),
+           "run all accounts of the configuration file concurrently, "
+           "each with its own journal")
+        (OPT::ACCOUNTS, po::value<vector<string> >(&accounts)->multitoken(),
+           "run these accounts concurrently")
+        (OPT::MAX_SESSIONS, po::value<unsigned>(&max_sessions)
+         ->default_value(max_sessions),
+           "maximum number of accounts running at the same time")
+        (OPT::MAX_HOST_SESSIONS, po::value<unsigned>(&max_host_sessions)
+         ->default_value(max_host_sessions),
+           "maximum number of connections to the same host - 0 means unlimited")
+        (OPT::POLL, po::value<bool>(&poll)
+         ->default_value(false, "false")
+         ->implicit_value(true, "true")->value_name("bool"),
+           "stay resident and poll the account(s) every interval seconds "
+           "until SIGINT/SIGTERM")
+        (OPT::INTERVAL, po::value<unsigned>(&interval)
+           //->default_value(300),
+           , "poll interval in seconds - accounts without new messages are "
+           "polled less often, failing ones exponentially less (default: 300)")
+        (OPT::MAX_INTERVAL, po::value<unsigned>(&max_interval)
+           //->default_value(3600),
+           , "upper bound of the backed off poll interval in seconds "
+           "(default: 3600)")
+        (OPT::JITTER, po::value<unsigned>(&jitter)->default_value(jitter),
+           "randomly vary the poll intervals by up to n percent, "
+           "thus logins to the same server are spread out")
         (OPT::CONFIGFILE,
            po::value<string>(&configfile)
            ->default_value("", "$HOME/.config/" + string(ID::argv0) + "/rc.json"),
@@ -347,6 +504,12 @@ namespace IMAP {
          ->default_value("", "$HOME/.config/"  + string(ID::argv0) + "/$ACCOUNT.journal"),
            "write already fetched and not yet expunged messages to a journal "
            "for expunging on the next connect")
+        (OPT::RAW, po::value<bool>(&raw)
+           //->default_value(false, "false")
+           ->implicit_value(true, "true")->value_name("bool"),
+           "store messages as received, i.e. with CRLF line endings - "
+           "message bodies then bypass the parser and are written directly "
+           "into the maildir (default: false)")
         (OPT::FETCH_HEADER, po::value<bool>(&fetch_header_only)
          ->default_value(false, "false")
          ->implicit_value(true, "true")
@@ -367,6 +530,8 @@ namespace IMAP {
     {
       if (maildir.substr(0, 2) == "~/")
         maildir = ansi::getenv("HOME") + maildir.substr(1);
+      if (resolve_cache.substr(0, 2) == "~/")
+        resolve_cache = ansi::getenv("HOME") + resolve_cache.substr(1);
       if (cert_host.empty())
         cert_host = host;
       if (cipher.empty())
@@ -387,6 +552,12 @@ namespace IMAP {
           << account << ".journal";
         journal_file = o.str();
       }
+      if (flight_recorder_file.empty()) {
+        ostringstream o;
+        o << ansi::getenv("HOME") << "/.config/" << ID::argv0 << '/'
+          << account << ".crash.trace";
+        flight_recorder_file = o.str();
+      }
       if (fetch_header_only)
         task = Task::FETCH_HEADER;
       if (list)
@@ -398,6 +569,10 @@ namespace IMAP {
         throw runtime_error("No host specified on the command line/in the rc file");
       if (maildir.empty())
         throw runtime_error("No maildir specified on the command line/in the rc file");
+      // the kernel would hold back the SYN until our first write - but
+      // without TLS, the server writes first
+      if (fast_open && !use_ssl)
+        throw runtime_error("TCP Fast Open (--fast_open) requires SSL/TLS");
     }
 
     static const char default_rc_file[] =
@@ -512,6 +687,15 @@ R"({
       local_port    = sub_tree.get<unsigned short> (KEY::LOCAL_PORT   , 0       );
       host          = sub_tree.get<string>         (KEY::HOST         , ""      );
       service       = sub_tree.get<string>         (KEY::SERVICE      , ""      );
+      connect_delay = sub_tree.get<unsigned>       (KEY::CONNECT_DELAY, 250     );
+      fast_open     = sub_tree.get<bool>           (KEY::FAST_OPEN    , false   );
+      no_delay      = sub_tree.get<bool>           (KEY::NO_DELAY     , false   );
+      quick_ack     = sub_tree.get<bool>           (KEY::QUICK_ACK    , false   );
+      rcvbuf        = sub_tree.get<unsigned>       (KEY::RCVBUF       , 0       );
+      sndbuf        = sub_tree.get<unsigned>       (KEY::SNDBUF       , 0       );
+      resolve_cache = sub_tree.get<string>         (KEY::RESOLVE_CACHE, ""      );
+      resolve_ttl   = sub_tree.get<unsigned>       (KEY::RESOLVE_TTL  , 3600    );
+      pipeline      = sub_tree.get<unsigned>       (KEY::PIPELINE     , 0       );
 
       use_ssl       = sub_tree.get<bool>           (KEY::SSL          , true    );
       fingerprint   = sub_tree.get<string>         (KEY::FINGERPRINT  , ""      );
@@ -526,7 +710,28 @@ R"({
       mailbox       = sub_tree.get<string>         (KEY::MAILBOX      , "INBOX" );
       maildir       = sub_tree.get<string>         (KEY::MAILDIR      , ""      );
       journal_file  = sub_tree.get<string>         (KEY::JOURNAL_FILE , ""      );
+      raw           = sub_tree.get<bool>           (KEY::RAW          , false   );
+      interval      = sub_tree.get<unsigned>       (KEY::INTERVAL     , 300     );
+      max_interval  = sub_tree.get<unsigned>       (KEY::MAX_INTERVAL , 3600    );
+    }
+    bool Options::multi() const
+    {
+      return all_accounts || !accounts.empty() || poll;
     }
+
+    std::vector<std::string> Options::account_list() const
+    {
+      if (!all_accounts)
+        return accounts.empty() ? vector<string>(1, account) : accounts;
+      boost::property_tree::ptree pt;
+      boost::property_tree::json_parser::read_json(configfile, pt);
+      vector<string> r;
+      for (auto &i : pt)
+        if (i.first.find("_comment") != 0)
+          r.push_back(i.first);
+      return r;
+    }
+
     std::ostream &Options::print(std::ostream &o) const
     {
       o << "username: " << username << '\n';
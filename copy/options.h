@@ -25,6 +25,7 @@
 
 #include <string>
 #include <ostream>
+#include <vector>
 
 namespace IMAP {
   namespace Copy {
@@ -39,15 +40,30 @@ namespace IMAP {
       public:
         Options();
         Options(int argc, char **argv);
+        // same command line, but for one of several accounts
+        Options(int argc, char **argv, const std::string &account);
         void fix();
         void verify();
         void check_configfile();
         void load();
         std::ostream &print(std::ostream &o) const;
 
+        // i.e. --all_accounts, --accounts or --poll
+        bool multi() const;
+        // the accounts to run in multi mode
+        std::vector<std::string> account_list() const;
+
         std::string logfile;
         bool        use_ssl        {true};
         std::string account;
+        bool        all_accounts   {false};
+        std::vector<std::string> accounts;
+        unsigned    max_sessions   {8};
+        unsigned    max_host_sessions {2};
+        bool        poll           {false};
+        unsigned    interval       {300};
+        unsigned    max_interval   {3600};
+        unsigned    jitter         {10};
         std::string configfile;
         std::string mailbox;
         std::string maildir;
@@ -57,6 +73,16 @@ namespace IMAP {
         unsigned    greeting_wait  {100};
         unsigned    simulate_error {0};
         std::string journal_file;
+        bool        raw            {false};
+        std::string resolve_cache;
+        unsigned    resolve_ttl    {3600};
+        unsigned    pipeline       {0};
+        unsigned    flight_recorder {4};
+        std::string flight_recorder_file;
+        std::string metrics_json;
+        std::string metrics_file;
+        unsigned    metrics_interval {0};
+        bool        perf           {false};
         bool        fetch_header_only {true};
         bool        list           {true};
         std::string list_reference;
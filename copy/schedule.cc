@@ -0,0 +1,77 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "schedule.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace IMAP {
+  namespace Copy {
+
+    Schedule::Schedule(unsigned interval, unsigned max_interval,
+        unsigned jitter)
+      :
+        interval_(max(interval, 1u)),
+        max_interval_(max(max_interval, interval_)),
+        jitter_(min(jitter, 100u))
+    {
+    }
+
+    Schedule::Duration Schedule::jittered(double seconds, double r) const
+    {
+      double f = 1.0 + double(jitter_) / 100.0 * (2.0 * r - 1.0);
+      return Duration(static_cast<Duration::rep>(seconds * f * 1000.0));
+    }
+
+    Schedule::Duration Schedule::first(double r) const
+    {
+      // spread the initial logins over the jitter window
+      return Duration(static_cast<Duration::rep>(
+            double(interval_) * double(jitter_) / 100.0 * r * 1000.0));
+    }
+
+    Schedule::Duration Schedule::next(bool ok, size_t messages, double r)
+    {
+      double seconds = interval_;
+      if (!ok) {
+        quiet_ = 0;
+        ++failures_;
+        seconds *= double(1u << min(failures_, 16u));
+      } else if (messages) {
+        quiet_    = 0;
+        failures_ = 0;
+      } else {
+        failures_ = 0;
+        ++quiet_;
+        seconds *= 1.0 + 0.25 * double(min(quiet_, 64u));
+      }
+      seconds = min(seconds, double(max_interval_));
+      return jittered(seconds, r);
+    }
+
+    unsigned Schedule::failures() const
+    {
+      return failures_;
+    }
+
+  }
+}
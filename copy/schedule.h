@@ -0,0 +1,62 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef IMAP_COPY_SCHEDULE_H
+#define IMAP_COPY_SCHEDULE_H
+
+#include <chrono>
+#include <stddef.h>
+
+namespace IMAP {
+  namespace Copy {
+
+    // When to poll an account the next time.
+    //
+    // An account that just had new messages is polled again after the
+    // configured interval, a quiet one a little later each time and a
+    // failing one exponentially later - up to max_interval. All delays
+    // are varied by up to +/- jitter percent, thus accounts on the same
+    // server don't log in at the same time.
+    class Schedule {
+      public:
+        using Duration = std::chrono::milliseconds;
+      private:
+        unsigned interval_;
+        unsigned max_interval_;
+        unsigned jitter_;
+        unsigned failures_ {0};
+        unsigned quiet_    {0};
+
+        Duration jittered(double seconds, double r) const;
+      public:
+        // intervals in seconds, jitter in percent
+        Schedule(unsigned interval, unsigned max_interval, unsigned jitter);
+
+        // r is a random number in [0, 1)
+        Duration first(double r) const;
+        Duration next(bool ok, size_t messages, double r);
+
+        unsigned failures() const;
+    };
+
+  }
+}
+
+#endif
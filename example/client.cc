@@ -237,13 +237,6 @@ namespace Client {
         timer_(io_service),
         limit_timer_(io_service)
     {
-      if (use_log_) {
-        tracefile_.exceptions(ofstream::failbit | ofstream::badbit );
-        tracefile_.open(opts.tracefile, ofstream::out | ofstream::binary);
-        unique_ptr<boost::archive::text_oarchive> a(
-            new boost::archive::text_oarchive(tracefile_));
-        oarchive_ = std::move(a);
-      }
       if (!use_replay_) {
         in_.assign(posix::dup(STDIN_FILENO));
       }
@@ -269,7 +262,9 @@ namespace Client {
               tcp::resolver::iterator iterator
             ){
             if (!ec) {
-              start_ = chrono::steady_clock::now();
+              // timestamps are relative to the connection start
+              if (use_log_)
+                trace_writer_.start(opts_.tracefile);
               if (use_ssl_)
                 do_ssl_connect(iterator);
               else
@@ -283,9 +278,10 @@ namespace Client {
     }
     Main::~Main()
     {
-      if (use_log_) {
-        Trace::Record r(Trace::Type::END_OF_FILE);
-        *oarchive_ << r;
+      try {
+        trace_writer_.finish();
+      } catch (const std::exception &e) {
+        cerr << "Finishing trace failed: " << e.what() << '\n';
       }
       cout << "Client destructed\n";
     }
@@ -380,15 +376,7 @@ namespace Client {
           }
           ;
 
-      if (use_log_) {
-        Trace::Record r(Trace::Type::SENT,
-            std::chrono::duration_cast<chrono::milliseconds>(
-              (chrono::steady_clock::now()-start_)).count(),
-            write_queue_.front().data(),
-                              write_queue_.front().size());
-        start_ = chrono::steady_clock::now();
-        *oarchive_ << r;
-      }
+      trace_writer_.push(Trace::Type::SENT, write_queue_.front());
 
       if (use_ssl_)
       boost::asio::async_write(ssl_socket_,
@@ -463,11 +451,8 @@ namespace Client {
 
     void Main::start_replay()
     {
-      replayfile_.open(opts_.replayfile, ifstream::in | ifstream::binary);
-      replayfile_.exceptions(ifstream::failbit | ifstream::badbit);
-      unique_ptr<boost::archive::text_iarchive> a(
-          new boost::archive::text_iarchive(replayfile_));
-      iarchive_ = std::move(a);
+      replay_reader_ = unique_ptr<Trace::Reader>(
+          new Trace::Reader(opts_.replayfile));
 
       if (opts_.limit) {
         limit_timer_.expires_from_now(std::chrono::seconds(opts_.limit));
@@ -493,15 +478,14 @@ namespace Client {
 
     void Main::do_replay()
     {
-      Trace::Record r;
-      *iarchive_ >> r;
-      timer_.expires_from_now(std::chrono::milliseconds(r.timestamp));
+      Trace::Record_View r(replay_reader_->next());
+      timer_.expires_from_now(std::chrono::microseconds(r.timestamp));
       switch (r.type) {
         case Trace::Type::SENT:
           {
             timer_.async_wait([this, r](const boost::system::error_code &ec)
                 {
-                  vector<char> v(r.message.data(), r.message.data() + r.message.size());
+                  vector<char> v(r.begin, r.end);
                   bool write_in_progress = !write_queue_.empty();
                   write_queue_.push(std::move(v));
                   if (!write_in_progress)
@@ -515,7 +499,7 @@ namespace Client {
           {
             timer_.async_wait([this, r](const boost::system::error_code &ec)
                 {
-                  vector<char> v(r.message.data(), r.message.data() + r.message.size());
+                  vector<char> v(r.begin, r.end);
                   expected_data_ = std::move(v);
                   do_read();
                 }
@@ -525,6 +509,9 @@ namespace Client {
         case Trace::Type::DISCONNECT:
           do_close();
           break;
+        case Trace::Type::MARK:
+          do_replay();
+          break;
         case Trace::Type::END_OF_FILE:
           break;
       }
@@ -555,14 +542,8 @@ namespace Client {
             {
               pp_buffer(cout, "Read some: ", data_.data(), length);
 
-              if (use_log_) {
-                Trace::Record r(Trace::Type::RECEIVED,
-                    std::chrono::duration_cast<chrono::milliseconds>(
-                      (chrono::steady_clock::now()-start_)).count(),
-                    data_.data(), length);
-                start_ = chrono::steady_clock::now();
-                *oarchive_ << r;
-              }
+              trace_writer_.push(Trace::Type::RECEIVED,
+                  data_.data(), data_.data() + length);
 
               if (use_replay_) {
                 if (    length != expected_data_.size()
@@ -630,13 +611,7 @@ namespace Client {
       ssl_socket_.async_shutdown([this](const boost::system::error_code &ec)
           {
             cout << "Doing shutdown ...\n";
-            if (use_log_) {
-              Trace::Record r(Trace::Type::DISCONNECT,
-                  std::chrono::duration_cast<chrono::milliseconds>(
-                    (chrono::steady_clock::now()-start_)).count());
-              start_ = chrono::steady_clock::now();
-              *oarchive_ << r;
-            }
+            trace_writer_.push(Trace::Type::DISCONNECT);
             if (ec) {
               cout << "SSL shutdown error: " << ec.message() << '\n';
 
@@ -27,13 +27,14 @@
 #include <array>
 #include <queue>
 #include <vector>
-#include <boost/archive/text_iarchive.hpp>
-#include <boost/archive/text_oarchive.hpp>
+#include <memory>
 #include <boost/asio.hpp>
 #include <boost/asio/signal_set.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/asio/steady_timer.hpp>
 
+#include <trace/trace.h>
+
 namespace Client {
 
   using namespace std;
@@ -66,7 +67,6 @@ namespace Client {
   class Main {
     private:
       const Options &opts_;
-      chrono::time_point<std::chrono::steady_clock> start_;
 
       tcp::resolver resolver_;
       tcp::socket socket_;
@@ -86,13 +86,11 @@ namespace Client {
       unsigned signaled_ {0};
 
       bool use_log_ { false };
-      ofstream tracefile_;
-      unique_ptr<boost::archive::text_oarchive> oarchive_;
+      Trace::Writer trace_writer_;
 
       bool use_replay_ { false };
       vector<char> expected_data_;
-      ifstream replayfile_;
-      unique_ptr<boost::archive::text_iarchive> iarchive_;
+      unique_ptr<Trace::Reader> replay_reader_;
       // asio::steady_timer timer_;
       // workaround: boost autodetection of std::chrono
       // does not seem to work in all boost versions
@@ -0,0 +1,576 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "imap_session.h"
+#include "mailbox.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <time.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+using namespace std;
+
+namespace Server {
+
+  static const char capabilities[] = "IMAP4rev1 UIDPLUS ID";
+
+  Maildir_Session::Maildir_Session(
+      asio::io_service& io_service, asio::ssl::context& context,
+      const Options &opts, Main &parent)
+    :
+      out_(parent.out()),
+      opts_(opts),
+      mailbox_(parent.mailbox()),
+      stats_(parent.stats()),
+      socket_(io_service),
+      ssl_socket_(io_service, context),
+      parser_(buffer_, tag_buffer_, *this)
+  {
+    SSL_set_cipher_list(ssl_socket_.native_handle(), opts_.cipher.c_str());
+  }
+  Maildir_Session::Maildir_Session(
+      tcp::socket &&socket,
+      asio::io_service& io_service, asio::ssl::context& context,
+      const Options &opts, Main &parent)
+    :
+      out_(parent.out()),
+      opts_(opts),
+      mailbox_(parent.mailbox()),
+      stats_(parent.stats()),
+      socket_(std::move(socket)),
+      ssl_socket_(io_service, context),
+      parser_(buffer_, tag_buffer_, *this)
+  {
+  }
+  Maildir_Session::~Maildir_Session() =default;
+
+  ssl_socket::lowest_layer_type &Maildir_Session::socket()
+  {
+    return ssl_socket_.lowest_layer();
+  }
+
+  void Maildir_Session::start()
+  {
+    auto self(shared_from_this());
+
+    text_ = "* OK [CAPABILITY ";
+    text_ += capabilities;
+    text_ += "] imapdl example server ready\r\n";
+    flush_text();
+    if (opts_.use_ssl) {
+      ssl_socket_.async_handshake(boost::asio::ssl::stream_base::server,
+          [this, self](const boost::system::error_code &ec)
+          {
+            if (!ec)
+              do_write();
+            else
+              out_ << "handshake error: " << ec.message() << '\n';
+          });
+    } else {
+      do_write();
+    }
+  }
+
+  void Maildir_Session::do_read()
+  {
+    auto self(shared_from_this());
+
+    auto f = [this, self](const boost::system::error_code &ec,
+        std::size_t length)
+    {
+      if (ec) {
+        if (ec != asio::error::eof)
+          out_ << "read error: " << ec.message() << '\n';
+        return;
+      }
+      stats_.bytes_read += length;
+      try {
+        parser_.read(data_.data(), data_.data() + length);
+      } catch (const std::exception &e) {
+        out_ << "closing session: " << e.what() << '\n';
+        text_ += "* BYE ";
+        text_ += e.what();
+        text_ += "\r\n";
+        logged_out_ = true;
+      }
+      flush_text();
+      if (buffers_.empty())
+        do_read();
+      else
+        do_write();
+    };
+    if (opts_.use_ssl)
+      ssl_socket_.async_read_some(asio::buffer(data_), f);
+    else
+      socket_.async_read_some(asio::buffer(data_), f);
+  }
+
+  // Responses are written before the next read, i.e. pipelined commands
+  // don't let the output grow without bound.
+  void Maildir_Session::do_write()
+  {
+    auto self(shared_from_this());
+
+    auto f = [this, self](const boost::system::error_code &ec,
+        std::size_t length)
+    {
+      stats_.bytes_written += length;
+      buffers_.clear();
+      texts_.clear();
+      mappings_.clear();
+      if (ec) {
+        out_ << "write error: " << ec.message() << '\n';
+        return;
+      }
+      if (logged_out_)
+        do_close();
+      else
+        do_read();
+    };
+    // with a plain socket the buffers are gathered with writev()
+    if (opts_.use_ssl)
+      asio::async_write(ssl_socket_, buffers_, f);
+    else
+      asio::async_write(socket_, buffers_, f);
+  }
+
+  void Maildir_Session::do_close()
+  {
+    auto self(shared_from_this());
+    if (opts_.use_ssl) {
+      ssl_socket_.async_shutdown([this, self](const boost::system::error_code &)
+          {
+            socket().close();
+          });
+    } else {
+      boost::system::error_code ec;
+      socket_.shutdown(tcp::socket::shutdown_both, ec);
+      socket_.close(ec);
+    }
+  }
+
+  std::string Maildir_Session::tag() const
+  {
+    return string(tag_buffer_.begin(), tag_buffer_.end());
+  }
+
+  void Maildir_Session::write_tagged(const char *status, const char *text)
+  {
+    text_ += tag();
+    text_ += ' ';
+    text_ += status;
+    text_ += ' ';
+    text_ += text;
+    text_ += "\r\n";
+    answered_ = true;
+  }
+
+  void Maildir_Session::flush_text()
+  {
+    if (text_.empty())
+      return;
+    texts_.push_back(std::move(text_));
+    text_.clear();
+    buffers_.emplace_back(texts_.back().data(), texts_.back().size());
+  }
+
+  void Maildir_Session::write_body(const char *begin, const char *end)
+  {
+    text_ += '{';
+    text_ += to_string(end - begin);
+    text_ += "}\r\n";
+    flush_text();
+    if (begin != end)
+      buffers_.emplace_back(begin, end - begin);
+  }
+
+  void Maildir_Session::write_flags(unsigned flags)
+  {
+    static const pair<unsigned, const char*> names[] = {
+      { Mailbox::ANSWERED, "\\Answered" },
+      { Mailbox::FLAGGED,  "\\Flagged"  },
+      { Mailbox::DELETED,  "\\Deleted"  },
+      { Mailbox::SEEN,     "\\Seen"     },
+      { Mailbox::DRAFT,    "\\Draft"    }
+    };
+    text_ += "FLAGS (";
+    bool first = true;
+    for (auto &n : names) {
+      if (!(flags & n.first))
+        continue;
+      if (!first)
+        text_ += ' ';
+      text_ += n.second;
+      first = false;
+    }
+    text_ += ')';
+  }
+
+  // '*' denotes the largest number in use and ranges are unordered,
+  // e.g. 10:* is equivalent to 5:10 in a mailbox with 5 messages
+  template <typename F>
+    void Maildir_Session::for_each(bool uid,
+        const IMAP::Server::Sequence_Ranges &set, F f)
+    {
+      if (selected_.empty())
+        return;
+      const uint32_t star = numeric_limits<uint32_t>::max();
+      uint32_t last = uid ? selected_.back().uid : uint32_t(selected_.size());
+      for (auto &r : set) {
+        uint32_t a = r.first  == star ? last : r.first;
+        uint32_t b = r.second == star ? last : r.second;
+        if (b < a)
+          swap(a, b);
+        if (uid) {
+          auto i = lower_bound(selected_.begin(), selected_.end(), a,
+              [](const Entry &e, uint32_t x) { return e.uid < x; });
+          for (; i != selected_.end() && i->uid <= b; ++i)
+            f(size_t(i - selected_.begin()));
+        } else {
+          b = min(b, uint32_t(selected_.size()));
+          for (uint32_t i = a; i <= b; ++i)
+            f(size_t(i - 1));
+        }
+      }
+    }
+
+  static const char *header_end(const char *begin, const char *end)
+  {
+    const char *p = begin;
+    while (p != end) {
+      const char *q = static_cast<const char*>(memchr(p, '\n', end - p));
+      if (!q)
+        return end;
+      if (q == p || (q == p + 1 && *p == '\r'))
+        return q + 1;
+      p = q + 1;
+    }
+    return end;
+  }
+
+  static void header_fields(const char *begin, const char *end,
+      const vector<string> &names, bool negate, string &out)
+  {
+    bool keep = false;
+    const char *p = begin;
+    while (p != end) {
+      const char *q = static_cast<const char*>(memchr(p, '\n', end - p));
+      q = q ? q + 1 : end;
+      if (q - p <= 2 && (*p == '\n' || *p == '\r'))
+        break;
+      // continuation lines belong to the previous field
+      if (*p != ' ' && *p != '\t') {
+        const char *colon = static_cast<const char*>(memchr(p, ':', q - p));
+        boost::iterator_range<const char*> name(p, colon ? colon : p);
+        keep = negate;
+        for (auto &n : names)
+          if (boost::iequals(name, n)) {
+            keep = !negate;
+            break;
+          }
+      }
+      if (keep)
+        out.append(p, q);
+      p = q;
+    }
+    out += "\r\n";
+  }
+
+  static void write_section(string &o, const IMAP::Server::Fetch_Attribute &a)
+  {
+    o += "BODY[";
+    switch (a.section) {
+      case IMAP::Section::HEADER: o += "HEADER"; break;
+      case IMAP::Section::TEXT:   o += "TEXT";   break;
+      case IMAP::Section::HEADER_FIELDS:
+      case IMAP::Section::HEADER_FIELDS_NOT:
+        o += a.section == IMAP::Section::HEADER_FIELDS
+          ? "HEADER.FIELDS (" : "HEADER.FIELDS.NOT (";
+        for (auto &h : a.headers) {
+          if (&h != &a.headers.front())
+            o += ' ';
+          o += h;
+        }
+        o += ')';
+        break;
+      default:
+        break;
+    }
+    o += "] ";
+  }
+
+  // ENVELOPE, BODYSTRUCTURE and body part sections aren't implemented
+  // and thus omitted from the response
+  void Maildir_Session::write_fetch(size_t i, bool uid,
+      const std::vector<IMAP::Server::Fetch_Attribute> &atts)
+  {
+    using IMAP::Client::Fetch;
+    Entry &e = selected_[i];
+    const Mailbox::Message &m = mailbox_.messages()[e.index];
+    const Mapping *mapping = nullptr;
+    auto map = [this, &m, &mapping]() {
+      if (!mapping) {
+        mappings_.emplace_back(new Mapping(m.path));
+        mapping = mappings_.back().get();
+      }
+      return mapping;
+    };
+
+    text_ += "* ";
+    text_ += to_string(i + 1);
+    text_ += " FETCH (";
+    bool first = true;
+    auto sep = [this, &first]() {
+      if (!first)
+        text_ += ' ';
+      first = false;
+    };
+    // UID FETCH responses always include the UID
+    if (uid && none_of(atts.begin(), atts.end(),
+          [](const IMAP::Server::Fetch_Attribute &a) {
+            return a.fetch == Fetch::UID; })) {
+      sep();
+      text_ += "UID ";
+      text_ += to_string(e.uid);
+    }
+    for (auto &a : atts) {
+      switch (a.fetch) {
+        case Fetch::UID:
+          sep();
+          text_ += "UID ";
+          text_ += to_string(e.uid);
+          break;
+        case Fetch::FLAGS:
+          sep();
+          write_flags(e.flags);
+          break;
+        case Fetch::RFC822_SIZE:
+          sep();
+          text_ += "RFC822.SIZE ";
+          text_ += to_string(m.size);
+          break;
+        case Fetch::INTERNALDATE:
+          {
+            sep();
+            struct tm t;
+            gmtime_r(&m.mtime, &t);
+            char b[32];
+            strftime(b, sizeof b, "\"%d-%b-%Y %H:%M:%S +0000\"", &t);
+            text_ += "INTERNALDATE ";
+            text_ += b;
+          }
+          break;
+        case Fetch::RGC822:
+          sep();
+          text_ += "RFC822 ";
+          write_body(map()->begin(), map()->end());
+          break;
+        case Fetch::RFC822_HEADER:
+          sep();
+          text_ += "RFC822.HEADER ";
+          write_body(map()->begin(),
+              header_end(map()->begin(), map()->end()));
+          break;
+        case Fetch::RFC822_TEXT:
+          sep();
+          text_ += "RFC822.TEXT ";
+          write_body(header_end(map()->begin(), map()->end()),
+              map()->end());
+          break;
+        case Fetch::BODY:
+        case Fetch::BODY_PEEK:
+          {
+            if (a.part)
+              break;
+            sep();
+            write_section(text_, a);
+            const char *b = map()->begin();
+            const char *h = header_end(b, map()->end());
+            switch (a.section) {
+              case IMAP::Section::HEADER:
+                write_body(b, h);
+                break;
+              case IMAP::Section::TEXT:
+                write_body(h, map()->end());
+                break;
+              case IMAP::Section::HEADER_FIELDS:
+              case IMAP::Section::HEADER_FIELDS_NOT:
+                {
+                  string s;
+                  header_fields(b, h, a.headers,
+                      a.section == IMAP::Section::HEADER_FIELDS_NOT, s);
+                  text_ += '{';
+                  text_ += to_string(s.size());
+                  text_ += "}\r\n";
+                  text_ += s;
+                }
+                break;
+              default:
+                write_body(b, map()->end());
+                break;
+            }
+          }
+          break;
+        default:
+          break;
+      }
+      if (!read_only_ && (a.fetch == Fetch::BODY || a.fetch == Fetch::RGC822
+            || a.fetch == Fetch::RFC822_TEXT))
+        e.flags |= Mailbox::SEEN;
+    }
+    text_ += ")\r\n";
+  }
+
+  bool Maildir_Session::imapd_login(const Memory::Buffer::Base & /* userid */,
+      const Memory::Buffer::Base & /* password */)
+  {
+    write_tagged("OK", "LOGIN completed");
+    return true;
+  }
+  void Maildir_Session::imapd_capability()
+  {
+    text_ += "* CAPABILITY ";
+    text_ += capabilities;
+    text_ += "\r\n";
+    write_tagged("OK", "CAPABILITY completed");
+  }
+  void Maildir_Session::imapd_noop()
+  {
+    write_tagged("OK", "NOOP completed");
+  }
+  void Maildir_Session::imapd_logout()
+  {
+    text_ += "* BYE logging out\r\n";
+    write_tagged("OK", "LOGOUT completed");
+    logged_out_ = true;
+  }
+  bool Maildir_Session::imapd_select(const Memory::Buffer::Base & /* mailbox */,
+      bool read_only)
+  {
+    selected_.clear();
+    boost::iterator_range<const char*> name(buffer_.begin(), buffer_.end());
+    if (!boost::iequals(name, "INBOX")) {
+      write_tagged("NO", "[NONEXISTENT] only INBOX exists");
+      return false;
+    }
+    read_only_ = read_only;
+    const auto &ms = mailbox_.messages();
+    selected_.resize(ms.size());
+    for (size_t i = 0; i < ms.size(); ++i) {
+      selected_[i].index = i;
+      selected_[i].uid   = ms[i].uid;
+      selected_[i].flags = ms[i].flags;
+    }
+    ostringstream o;
+    o << "* FLAGS (\\Answered \\Flagged \\Deleted \\Seen \\Draft)\r\n"
+      << "* " << selected_.size() << " EXISTS\r\n"
+      << "* 0 RECENT\r\n"
+      << "* OK [PERMANENTFLAGS (\\Answered \\Flagged \\Deleted \\Seen"
+         " \\Draft)] limited\r\n"
+      << "* OK [UIDVALIDITY " << mailbox_.uidvalidity() << "] UIDs valid\r\n"
+      << "* OK [UIDNEXT " << mailbox_.uid_next() << "] predicted next UID\r\n";
+    text_ += o.str();
+    write_tagged("OK", read_only ? "[READ-ONLY] EXAMINE completed"
+        : "[READ-WRITE] SELECT completed");
+    return true;
+  }
+  void Maildir_Session::imapd_close()
+  {
+    // deleted messages would be removed silently, but the session
+    // state is discarded anyway
+    selected_.clear();
+    write_tagged("OK", "CLOSE completed");
+  }
+  void Maildir_Session::imapd_fetch(bool uid,
+      const IMAP::Server::Sequence_Ranges &set,
+      const std::vector<IMAP::Server::Fetch_Attribute> &atts)
+  {
+    for_each(uid, set, [this, uid, &atts](size_t i) {
+        write_fetch(i, uid, atts);
+      });
+    write_tagged("OK", uid ? "UID FETCH completed" : "FETCH completed");
+  }
+  void Maildir_Session::imapd_store(bool uid,
+      const IMAP::Server::Sequence_Ranges &set,
+      IMAP::Client::Store_Mode mode, bool silent,
+      const std::vector<IMAP::Flag> &flags)
+  {
+    unsigned bits = 0;
+    for (auto f : flags)
+      if (f != IMAP::Flag::RECENT)
+        bits |= 1u << unsigned(f);
+    for_each(uid, set, [this, uid, mode, silent, bits](size_t i) {
+        Entry &e = selected_[i];
+        switch (mode) {
+          case IMAP::Client::Store_Mode::ADD:    e.flags |= bits;  break;
+          case IMAP::Client::Store_Mode::REMOVE: e.flags &= ~bits; break;
+          default:                               e.flags = bits;   break;
+        }
+        if (silent)
+          return;
+        text_ += "* ";
+        text_ += to_string(i + 1);
+        text_ += " FETCH (";
+        write_flags(e.flags);
+        if (uid) {
+          text_ += " UID ";
+          text_ += to_string(e.uid);
+        }
+        text_ += ")\r\n";
+      });
+    write_tagged("OK", uid ? "UID STORE completed" : "STORE completed");
+  }
+  void Maildir_Session::imapd_expunge(bool uid,
+      const IMAP::Server::Sequence_Ranges &set)
+  {
+    vector<bool> marked(selected_.size(), !uid);
+    if (uid)
+      for_each(true, set, [&marked](size_t i) { marked[i] = true; });
+    for (size_t i = 0; i < selected_.size(); ++i)
+      marked[i] = marked[i] && (selected_[i].flags & Mailbox::DELETED);
+    // descending, such that the announced sequence numbers stay valid
+    for (size_t i = selected_.size(); i > 0; --i) {
+      if (!marked[i-1])
+        continue;
+      text_ += "* ";
+      text_ += to_string(i);
+      text_ += " EXPUNGE\r\n";
+    }
+    size_t j = 0;
+    for (size_t i = 0; i < selected_.size(); ++i)
+      if (!marked[i])
+        selected_[j++] = selected_[i];
+    selected_.resize(j);
+    write_tagged("OK", uid ? "UID EXPUNGE completed" : "EXPUNGE completed");
+  }
+  // commands without a dedicated callback (e.g. LIST or ID) are just
+  // acknowledged
+  void Maildir_Session::imapd_command_end()
+  {
+    if (!answered_)
+      write_tagged("OK", "completed");
+    answered_ = false;
+  }
+
+}
@@ -0,0 +1,127 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef EXAMPLE_IMAP_SESSION_H
+#define EXAMPLE_IMAP_SESSION_H
+
+#include "server.h"
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <buffer/buffer.h>
+#include <imap/server_parser.h>
+
+namespace Server {
+
+  class Mailbox;
+  class Mapping;
+
+  // Serves a maildir as INBOX to an IMAP client, e.g. imapdl.
+  //
+  // Commands are parsed with the IMAP::Server::Parser, message bodies are
+  // written directly from read-only file mappings. Any credentials are
+  // accepted. STORE and EXPUNGE only change the state of the session,
+  // the maildir on disk isn't modified.
+  class Maildir_Session : public std::enable_shared_from_this<Maildir_Session>,
+                          private IMAP::Server::Callback::Base {
+    private:
+      class Entry {
+        public:
+          size_t   index {0};
+          uint32_t uid   {0};
+          unsigned flags {0};
+      };
+
+      ostream &out_;
+      const Options &opts_;
+      const Mailbox &mailbox_;
+      Stats &stats_;
+
+      tcp::socket socket_;
+      ssl_socket ssl_socket_;
+      std::array<char, 16 * 1024> data_;
+
+      Memory::Buffer::Vector buffer_;
+      Memory::Buffer::Vector tag_buffer_;
+      IMAP::Server::Parser parser_;
+
+      std::vector<Entry> selected_;
+      bool read_only_  {false};
+      bool answered_   {false};
+      bool logged_out_ {false};
+
+      // pending output - buffers_ points into texts_ and mappings_
+      std::string text_;
+      std::deque<std::string> texts_;
+      std::vector<asio::const_buffer> buffers_;
+      std::vector<std::unique_ptr<Mapping> > mappings_;
+
+      std::string tag() const;
+      void write_tagged(const char *status, const char *text);
+      void write_body(const char *begin, const char *end);
+      void flush_text();
+      void write_flags(unsigned flags);
+      void write_fetch(size_t i, bool uid,
+          const std::vector<IMAP::Server::Fetch_Attribute> &atts);
+      template <typename F>
+        void for_each(bool uid, const IMAP::Server::Sequence_Ranges &set,
+            F f);
+
+      void do_read();
+      void do_write();
+      void do_close();
+
+      bool imapd_login(const Memory::Buffer::Base &userid,
+          const Memory::Buffer::Base &password) override;
+      void imapd_capability() override;
+      void imapd_noop() override;
+      void imapd_logout() override;
+      bool imapd_select(const Memory::Buffer::Base &mailbox,
+          bool read_only) override;
+      void imapd_close() override;
+      void imapd_fetch(bool uid, const IMAP::Server::Sequence_Ranges &set,
+          const std::vector<IMAP::Server::Fetch_Attribute> &atts) override;
+      void imapd_store(bool uid, const IMAP::Server::Sequence_Ranges &set,
+          IMAP::Client::Store_Mode mode, bool silent,
+          const std::vector<IMAP::Flag> &flags) override;
+      void imapd_expunge(bool uid,
+          const IMAP::Server::Sequence_Ranges &set) override;
+      void imapd_command_end() override;
+    public:
+      Maildir_Session(asio::io_service& io_service,
+          asio::ssl::context& context,
+          const Options &opts, Main &parent);
+      Maildir_Session(tcp::socket &&socket,
+          asio::io_service& io_service, asio::ssl::context& context,
+          const Options &opts, Main &parent);
+      ~Maildir_Session();
+
+      void start();
+
+      ssl_socket::lowest_layer_type &socket();
+  };
+
+}
+
+#endif
@@ -0,0 +1,215 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "mailbox.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <maildir/maildir.h>
+
+using namespace std;
+
+namespace Server {
+
+  static void throw_errno(const string &what)
+  {
+    throw system_error(errno, system_category(), what);
+  }
+
+  Mapping::Mapping(const std::string &filename)
+  {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+      throw_errno("open message " + filename);
+    struct stat st;
+    if (::fstat(fd, &st) == -1) {
+      ::close(fd);
+      throw_errno("stat message " + filename);
+    }
+    size_ = st.st_size;
+    if (size_) {
+      map_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        ::close(fd);
+        throw_errno("mmap message " + filename);
+      }
+      ::madvise(map_, size_, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+  }
+  Mapping::~Mapping()
+  {
+    if (map_)
+      ::munmap(map_, size_);
+  }
+  const char *Mapping::begin() const
+  {
+    return static_cast<const char*>(map_);
+  }
+  const char *Mapping::end() const
+  {
+    return begin() + size_;
+  }
+
+
+  Mailbox::Mailbox(const std::string &path)
+    :
+      path_(path),
+      uidvalidity_(::time(nullptr))
+  {
+    read_dir("new");
+    read_dir("cur");
+    // by file name, i.e. new/ and cur/ are merged
+    auto name = [](const Message &m) {
+      return m.path.c_str() + m.path.rfind('/') + 1;
+    };
+    sort(messages_.begin(), messages_.end(),
+        [&name](const Message &a, const Message &b) {
+          return strcmp(name(a), name(b)) < 0;
+        });
+    uint32_t uid = 1;
+    for (auto &m : messages_)
+      m.uid = uid++;
+  }
+
+  // Maildir flags, e.g. "1234.P12Q3.host:2,RS", to IMAP flags
+  static unsigned to_flags(const char *name)
+  {
+    const char *info = strstr(name, ":2,");
+    if (!info)
+      return 0;
+    unsigned r = 0;
+    for (const char *p = info + 3; *p; ++p) {
+      switch (*p) {
+        case 'R': r |= Mailbox::ANSWERED; break;
+        case 'F': r |= Mailbox::FLAGGED;  break;
+        case 'T': r |= Mailbox::DELETED;  break;
+        case 'S': r |= Mailbox::SEEN;     break;
+        case 'D': r |= Mailbox::DRAFT;    break;
+      }
+    }
+    return r;
+  }
+
+  void Mailbox::read_dir(const std::string &sub)
+  {
+    string dirname(path_ + '/' + sub);
+    DIR *dir = ::opendir(dirname.c_str());
+    if (!dir)
+      throw_errno("open maildir sub directory " + dirname);
+    for (;;) {
+      errno = 0;
+      struct dirent *e = ::readdir(dir);
+      if (!e)
+        break;
+      if (*e->d_name == '.')
+        continue;
+      Message m;
+      m.path = dirname + '/' + e->d_name;
+      struct stat st;
+      if (::stat(m.path.c_str(), &st) == -1 || !S_ISREG(st.st_mode))
+        continue;
+      m.size  = st.st_size;
+      m.mtime = st.st_mtime;
+      m.flags = to_flags(e->d_name);
+      messages_.push_back(std::move(m));
+    }
+    int saved = errno;
+    ::closedir(dir);
+    if (saved) {
+      errno = saved;
+      throw_errno("read maildir sub directory " + dirname);
+    }
+  }
+
+  const std::vector<Mailbox::Message> &Mailbox::messages() const
+  {
+    return messages_;
+  }
+  uint32_t Mailbox::uidvalidity() const
+  {
+    return uidvalidity_;
+  }
+  uint32_t Mailbox::uid_next() const
+  {
+    return messages_.empty() ? 1 : messages_.back().uid + 1;
+  }
+
+  void Mailbox::generate(const std::string &path, size_t n, size_t size)
+  {
+    static const char *const words[] = {
+      "lorem", "ipsum", "dolor", "sit", "amet", "consectetur",
+      "adipiscing", "elit", "sed", "do", "eiusmod", "tempor"
+    };
+    static const size_t word_count = sizeof(words)/sizeof(words[0]);
+
+    Maildir maildir(path);
+    for (size_t i = 0; i < n; ++i) {
+      ostringstream o;
+      o << "Date: Mon, 3 Mar 2014 12:" << setw(2) << setfill('0') << (i / 60 % 60)
+        << ':' << setw(2) << (i % 60) << " +0100\r\n"
+        << "From: Sender " << i % 97 << " <sender" << i % 97
+        << "@example.org>\r\n"
+        << "To: Receiver <receiver@example.org>\r\n"
+        << "Subject: Synthetic message " << i << "\r\n"
+        << "Message-ID: <" << i << ".imapdl@example.org>\r\n"
+        << "\r\n";
+      size_t line = 0;
+      size_t k = i;
+      while (size_t(o.tellp()) < size) {
+        const char *w = words[k++ % word_count];
+        o << w;
+        line += strlen(w);
+        if (line > 70) {
+          o << "\r\n";
+          line = 0;
+        } else {
+          o << ' ';
+          ++line;
+        }
+      }
+      o << "\r\n";
+
+      string dirname, filename;
+      maildir.create_tmp_name(dirname, filename);
+      {
+        ofstream f(dirname + '/' + filename, ios::binary);
+        f.exceptions(ofstream::failbit | ofstream::badbit);
+        f << o.str();
+      }
+      maildir.move_to_new();
+    }
+  }
+
+}
@@ -0,0 +1,90 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef EXAMPLE_MAILBOX_H
+#define EXAMPLE_MAILBOX_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include <imap/imap.h>
+
+namespace Server {
+
+  // read-only mapping of a message file, unmapped on destruction
+  class Mapping {
+    private:
+      void       *map_  {nullptr};
+      size_t      size_ {0};
+    public:
+      Mapping(const Mapping &) =delete;
+      Mapping &operator=(const Mapping &) =delete;
+
+      Mapping(const std::string &filename);
+      ~Mapping();
+
+      const char *begin() const;
+      const char *end() const;
+  };
+
+  // The messages of a maildir (new/ and cur/), exported as one IMAP mailbox.
+  //
+  // UIDs are assigned in file name order, i.e. in delivery order
+  // for maildirs written by conforming MDAs. The files are never modified.
+  class Mailbox {
+    public:
+      enum Flag_Bit : unsigned {
+        ANSWERED = 1u << unsigned(IMAP::Flag::ANSWERED),
+        FLAGGED  = 1u << unsigned(IMAP::Flag::FLAGGED),
+        DELETED  = 1u << unsigned(IMAP::Flag::DELETED),
+        SEEN     = 1u << unsigned(IMAP::Flag::SEEN),
+        DRAFT    = 1u << unsigned(IMAP::Flag::DRAFT)
+      };
+      class Message {
+        public:
+          std::string path;
+          uint32_t    uid   {0};
+          size_t      size  {0};
+          time_t      mtime {0};
+          unsigned    flags {0};
+      };
+    private:
+      std::string          path_;
+      uint32_t             uidvalidity_ {0};
+      std::vector<Message> messages_;
+
+      void read_dir(const std::string &sub);
+    public:
+      Mailbox(const std::string &path);
+
+      const std::vector<Message> &messages() const;
+      uint32_t uidvalidity() const;
+      uint32_t uid_next() const;
+
+      // deliver n synthetic messages of about size bytes to new/
+      static void generate(const std::string &path, size_t n, size_t size);
+  };
+
+}
+
+#endif
@@ -19,28 +19,27 @@
 
 }}} */
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <stdlib.h>
 using namespace std;
 
-#include <boost/archive/text_iarchive.hpp>
-#include <boost/archive/text_oarchive.hpp>
-
 #include <trace/trace.h>
+#include <trace/analyzer.h>
 
 
 
-static void c_print_server(boost::archive::text_iarchive &iarchive, ostream &o)
+static void c_print_server(Trace::Reader &reader, ostream &o)
 {
   o << "const char * const received[] = {\n\n";
 
   for (;;) {
-    Trace::Record r;
-    iarchive >> r;
+    Trace::Record_View r(reader.next());
 
     switch (r.type) {
       case Trace::Type::SENT:
-        o << "// " << r.message << '\n';
+        o << "// ";
+        o.write(r.begin, r.size());
+        o << '\n';
         break;
       case Trace::Type::RECEIVED:
         // o << "R\"(" << r.message << ")\",\n";
@@ -48,7 +47,8 @@ static void c_print_server(boost::archive::text_iarchive &iarchive, ostream &o)
         // thus workaround:
         {
           o << R"(")";
-          for (auto c : r.message) {
+          for (const char *i = r.begin; i != r.end; ++i) {
+            char c = *i;
             switch (c) {
               case '\n':
                 o << R"(\n")" << "\n\"";
@@ -86,23 +86,40 @@ static void c_print_server(boost::archive::text_iarchive &iarchive, ostream &o)
 int main(int argc, char **argv)
 {
   if (argc < 2) {
-    cout << "Call: " << *argv << " LOGFILE\n";
+    cout << "Call: " << *argv << " LOGFILE [--cs | --convert NEWFILE"
+      " | --analyze [GAP_MS]]\n";
     return 1;
   }
 
   string logfile(argv[1]);
-  ifstream f(logfile, ifstream::in | ifstream::out);
-  f.exceptions(ifstream::badbit | ifstream::failbit );
-  boost::archive::text_iarchive iarchive(f);
+
+  if (argc > 3 && argv[2] == string("--convert")) {
+    Trace::convert(logfile, argv[3]);
+    return 0;
+  }
+
+  Trace::Reader reader(logfile);
 
   if (argc > 2 && argv[2] == string("--cs")) {
-    c_print_server(iarchive, cout);
+    c_print_server(reader, cout);
+    return 0;
+  }
+
+  if (argc > 2 && argv[2] == string("--analyze")) {
+    uint64_t gap = argc > 3 ? strtoul(argv[3], nullptr, 10) : 50;
+    Trace::Analyzer analyzer(gap * 1000);
+    for (;;) {
+      Trace::Record_View r(reader.next());
+      analyzer.push(r);
+      if (r.type == Trace::Type::END_OF_FILE)
+        break;
+    }
+    analyzer.print(cout);
     return 0;
   }
 
   for (;;) {
-    Trace::Record r;
-    iarchive >> r;
+    Trace::Record_View r(reader.next());
     cout << r;
     if (r.type == Trace::Type::END_OF_FILE)
       break;
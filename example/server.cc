@@ -19,6 +19,8 @@
 
 }}} */
 #include "server.h"
+#include "imap_session.h"
+#include "mailbox.h"
 #include <array>
 #include <chrono>
 #include <cstdlib>
@@ -28,11 +30,14 @@
 #include <memory>
 #include <queue>
 #include <sstream>
+#include <thread>
 #include <utility>
 using namespace std;
 
-#include <boost/archive/text_iarchive.hpp>
-#include <boost/archive/text_oarchive.hpp>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
 #include <boost/program_options.hpp>
 
 namespace po = boost::program_options;
@@ -54,6 +59,12 @@ namespace Server {
     static const char TRACEFILE[]     = "trace";
     static const char REPLAYFILE[]    = "replay";
     static const char LIMIT[]         = "limit";
+    static const char FAST_OPEN[]     = "fast_open";
+    static const char MAILDIR[]       = "maildir";
+    static const char GENERATE[]      = "generate";
+    static const char MESSAGE_SIZE[]  = "message_size";
+    static const char THREADS[]       = "threads";
+    static const char REUSE_PORT[]    = "reuse_port";
 
     static const char PORT[]          = "port";
     static const char DHPARAM[]       = "dhparam";
@@ -97,6 +108,25 @@ namespace Server {
        "replay a previously recorded tracefile")
       (OPT::LIMIT, po::value<unsigned>(&limit)->default_value(0),
        "time limit for replay session in seconds - 0 means unlimited")
+      (OPT::FAST_OPEN,
+       po::value<bool>(&fast_open)
+       ->default_value(false, "false")
+       ->implicit_value(true, "true")->value_name("bool"),
+       "accept TCP Fast Open connections (Linux)")
+      (OPT::MAILDIR, po::value<string>(&maildir)->default_value(""),
+       "serve this maildir as INBOX to any number of concurrent sessions")
+      (OPT::GENERATE, po::value<unsigned>(&generate)->default_value(0),
+       "first deliver that many synthetic messages to the maildir")
+      (OPT::MESSAGE_SIZE, po::value<unsigned>(&message_size)
+       ->default_value(4096),
+       "approximate size of the generated messages in bytes")
+      (OPT::THREADS, po::value<unsigned>(&threads)->default_value(1),
+       "number of threads, each with its own acceptor (SO_REUSEPORT)")
+      (OPT::REUSE_PORT,
+       po::value<bool>(&reuse_port)
+       ->default_value(false, "false")
+       ->implicit_value(true, "true")->value_name("bool"),
+       "bind with SO_REUSEPORT, e.g. for running several server processes")
       ;
     po::options_description hidden_group;
     hidden_group.add_options()
@@ -132,6 +162,48 @@ namespace Server {
     if (cipher.empty())
       cipher = Cipher::default_list(Cipher::to_class(cipher_preset));
     use_replay = !replayfile.empty();
+    use_maildir = !maildir.empty();
+    if (use_replay && use_maildir)
+      throw runtime_error("replay and maildir mode are mutually exclusive");
+    if (!threads)
+      threads = 1;
+    if (threads > 1) {
+      if (use_replay)
+        throw runtime_error("replay mode is single threaded");
+      reuse_port = true;
+    }
+  }
+
+
+  Stats &Stats::operator+=(const Stats &o)
+  {
+    connections   += o.connections;
+    bytes_read    += o.bytes_read;
+    bytes_written += o.bytes_written;
+    return *this;
+  }
+  void Stats::print(ostream &o, double seconds) const
+  {
+    double mib = 1024.0 * 1024.0;
+    o << "Connections: " << connections << '\n'
+      << "Read: " << bytes_read / mib << " MiB\n"
+      << "Written: " << bytes_written / mib << " MiB\n"
+      << "Time: " << seconds << " s\n";
+    if (seconds > 0)
+      o << "Throughput: " << connections / seconds << " connections/s, "
+        << (bytes_read + bytes_written) / mib / seconds << " MiB/s\n";
+  }
+
+
+  static shared_ptr<const Mailbox> load_mailbox(const Options &opts,
+      ostream &out)
+  {
+    if (opts.generate)
+      Mailbox::generate(opts.maildir, opts.generate, opts.message_size);
+    auto r = make_shared<const Mailbox>(opts.maildir);
+    out << "Serving " << r->messages().size() << " messages from "
+      << opts.maildir << '\n';
+    return r;
   }
 
 
@@ -150,8 +222,7 @@ namespace Server {
 
       queue<vector<char> > write_queue_;
       vector<char> expected_data_;
-      ifstream replayfile_;
-      unique_ptr<boost::archive::text_iarchive> iarchive_;
+      unique_ptr<Trace::Reader> replay_reader_;
       // asio::steady_timer timer_;
       // workaround: boost autodetection of std::chrono
       // does not seem to work in all boost versions
@@ -260,11 +331,8 @@ namespace Server {
   {
     auto self(shared_from_this());
 
-    replayfile_.open(opts_.replayfile, ifstream::in | ifstream::binary);
-    replayfile_.exceptions(ifstream::failbit | ifstream::badbit);
-    unique_ptr<boost::archive::text_iarchive> a(
-        new boost::archive::text_iarchive(replayfile_));
-    iarchive_ = std::move(a);
+    replay_reader_ = unique_ptr<Trace::Reader>(
+        new Trace::Reader(opts_.replayfile));
 
 
     do_replay();
@@ -274,10 +342,9 @@ namespace Server {
   {
     auto self(shared_from_this());
 
-    Trace::Record r;
-    *iarchive_ >> r;
-    out_ << "Replay expires in: " << r.timestamp << '\n';
-    timer_.expires_from_now(std::chrono::milliseconds(r.timestamp));
+    Trace::Record_View r(replay_reader_->next());
+    out_ << "Replay expires in: " << r.timestamp << " us\n";
+    timer_.expires_from_now(std::chrono::microseconds(r.timestamp));
     switch (r.type) {
       case Trace::Type::RECEIVED:
         {
@@ -285,7 +352,7 @@ namespace Server {
               {
                 if (!ec) {
                   out_ << "do_replay: RECEIVED\n";
-                  vector<char> v(r.message.data(), r.message.data() + r.message.size());
+                  vector<char> v(r.begin, r.end);
                   bool write_in_progress = !write_queue_.empty();
                   write_queue_.push(std::move(v));
                   if (!write_in_progress)
@@ -304,7 +371,7 @@ namespace Server {
           timer_.async_wait([this, self, r](const boost::system::error_code &ec)
               {
                 if (!ec) {
-                  vector<char> v(r.message.data(), r.message.data() + r.message.size());
+                  vector<char> v(r.begin, r.end);
                   expected_data_ = std::move(v);
                   do_read();
                   // wrong place to call do_replay() because do_read()
@@ -320,6 +387,10 @@ namespace Server {
       case Trace::Type::DISCONNECT:
         wait_for_disconnect();
         break;
+      case Trace::Type::MARK:
+        // connection phases were already replayed by establishing the session
+        do_replay();
+        break;
       case Trace::Type::END_OF_FILE:
         out_ << "do_replay: EOF\n";
         //do_close();
@@ -439,6 +510,7 @@ namespace Server {
     auto f = [this, self](const boost::system::error_code &ec, std::size_t length)
     {
       if (!ec) {
+        parent_.stats().bytes_read += length;
         pp_buffer(out_, "Read some: ", data_.data(), length);
 
         if (opts_.use_replay) {
@@ -508,8 +580,9 @@ namespace Server {
     auto self(shared_from_this());
 
     auto f = 
-      [this, self](const boost::system::error_code &ec, std::size_t /*length*/)
+      [this, self](const boost::system::error_code &ec, std::size_t length)
       {
+        parent_.stats().bytes_written += length;
         if (!ec) {
           do_read();
         }
@@ -527,8 +600,9 @@ namespace Server {
     if (write_queue_.empty())
       throw logic_error("do_write() called with empty queue");
 
-    auto f = [this, self](const boost::system::error_code &ec, std::size_t /*length*/)
+    auto f = [this, self](const boost::system::error_code &ec, std::size_t length)
         {
+          parent_.stats().bytes_written += length;
           if (!ec) {
             write_queue_.pop();
             if (!write_queue_.empty())
@@ -595,17 +669,19 @@ namespace Server {
 
 
   Main::Main(boost::asio::io_service& io_service, const Options &opts,
-      ostream &out)
+      ostream &out, shared_ptr<const Mailbox> mailbox)
     :
       out_(out),
       opts_(opts),
       io_service_(io_service),
-      acceptor_(io_service, tcp::endpoint(tcp::v6(), opts.port)),
+      acceptor_(io_service),
       socket_(io_service),
       context_(boost::asio::ssl::context::sslv23),
       signals_(io_service, SIGINT, SIGTERM),
-      limit_timer_(io_service)
+      limit_timer_(io_service),
+      mailbox_(std::move(mailbox))
   {
+    open_acceptor();
     Context::set_defaults(context_);
 
     //context_.set_password_callback(boost::bind(&Main::get_password, this));
@@ -613,6 +689,17 @@ namespace Server {
     context_.use_private_key_file(opts.key, boost::asio::ssl::context::pem);
     context_.use_tmp_dh_file(opts.dhparam);
 
+    if (opts_.fast_open) {
+#if defined(TCP_FASTOPEN)
+      int qlen = 16;
+      if (setsockopt(acceptor_.native_handle(), IPPROTO_TCP, TCP_FASTOPEN,
+            &qlen, sizeof qlen))
+        out_ << "setting TCP_FASTOPEN failed\n";
+#else
+      out_ << "TCP Fast Open isn't supported on this platform\n";
+#endif
+    }
+
     signals_.async_wait([this](
           const boost::system::error_code &ec,
           int signal_number
@@ -646,14 +733,54 @@ namespace Server {
           );
     }
 
+    if (opts_.use_maildir && !mailbox_)
+      mailbox_ = load_mailbox(opts_, out_);
+
     if (opts_.use_ssl)
       do_ssl_accept();
     else
       do_accept();
   }
+  Main::~Main() =default;
+
+  // equivalent to the acceptor constructor with an endpoint argument,
+  // except for the optional SO_REUSEPORT which has to be set before bind()
+  void Main::open_acceptor()
+  {
+    tcp::endpoint endpoint(tcp::v6(), opts_.port);
+    acceptor_.open(endpoint.protocol());
+    acceptor_.set_option(tcp::acceptor::reuse_address(true));
+    if (opts_.reuse_port) {
+#if defined(SO_REUSEPORT)
+      using reuse_port = asio::detail::socket_option::boolean<
+        SOL_SOCKET, SO_REUSEPORT>;
+      acceptor_.set_option(reuse_port(true));
+#else
+      throw runtime_error("SO_REUSEPORT isn't supported on this platform");
+#endif
+    }
+    acceptor_.bind(endpoint);
+    acceptor_.listen();
+  }
 
   void Main::do_ssl_accept()
   {
+    if (opts_.use_maildir) {
+      auto new_session = std::make_shared<Maildir_Session>(io_service_,
+          context_, opts_, *this);
+      acceptor_.async_accept(new_session->socket(),
+          [this, new_session](const boost::system::error_code &ec)
+          {
+            if (!ec) {
+              ++stats_.connections;
+              new_session->start();
+              do_ssl_accept();
+            } else {
+              out_ << "accept ERROR: " << ec.message() << '\n';
+            }
+          });
+      return;
+    }
     // note that there is always one session object ready to take over
     // on start, immediately a new object is created,
     // waiting for its start ...
@@ -663,6 +790,7 @@ namespace Server {
         [this, new_session](const boost::system::error_code &ec)
         {
           if (!ec) {
+            ++stats_.connections;
             new_session->start();
 
             if (opts_.use_replay) {
@@ -682,6 +810,13 @@ namespace Server {
         [this](const boost::system::error_code &ec)
         {
           if (!ec) {
+            ++stats_.connections;
+            if (opts_.use_maildir) {
+              std::make_shared<Maildir_Session>(std::move(socket_),
+                io_service_, context_, opts_, *this)->start();
+              do_accept();
+              return;
+            }
             std::make_shared<session>(std::move(socket_),
               io_service_, context_, opts_, *this
               )->start();
@@ -702,5 +837,59 @@ namespace Server {
     limit_timer_.cancel();
   }
 
-}
 
+
+  Pool::Pool(const Options &opts, ostream &out)
+    :
+      out_(out),
+      opts_(opts)
+  {
+    shared_ptr<const Mailbox> mailbox;
+    if (opts_.use_maildir)
+      mailbox = load_mailbox(opts_, out_);
+    for (unsigned i = 0; i < opts_.threads; ++i) {
+      io_services_.emplace_back(new asio::io_service(1));
+      mains_.emplace_back(new Main(*io_services_.back(), opts_, out_,
+            mailbox));
+    }
+  }
+  Pool::~Pool() =default;
+
+  void Pool::run()
+  {
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    vector<exception_ptr> errors(io_services_.size());
+    for (size_t i = 1; i < io_services_.size(); ++i)
+      threads.emplace_back([this, i, &errors]() {
+          try {
+            io_services_[i]->run();
+          } catch (...) {
+            errors[i] = current_exception();
+            for (auto &io : io_services_)
+              io->stop();
+          }
+        });
+    try {
+      io_services_.front()->run();
+    } catch (...) {
+      errors.front() = current_exception();
+      // such that the other threads return, too
+      for (auto &io : io_services_)
+        io->stop();
+    }
+    for (auto &t : threads)
+      t.join();
+    chrono::duration<double> d(chrono::steady_clock::now() - start);
+
+    Stats total;
+    for (auto &m : mains_)
+      total += m->stats();
+    total.print(out_, d.count());
+
+    for (auto &e : errors)
+      if (e)
+        rethrow_exception(e);
+  }
+
+}
@@ -24,6 +24,9 @@
 #include <iostream>
 #include <ostream>
 #include <chrono>
+#include <memory>
+#include <vector>
+#include <stdint.h>
 #include <string.h>
 #include <boost/asio.hpp>
 #include <boost/asio/signal_set.hpp>
@@ -55,6 +58,16 @@ namespace Server {
       string tracefile;
       string replayfile;
       unsigned limit {0};
+      bool fast_open {false};
+
+      bool use_maildir {false};
+      string maildir;
+      unsigned generate {0};
+      unsigned message_size {4096};
+
+      // more than one thread implies SO_REUSEPORT
+      unsigned threads {1};
+      bool reuse_port {false};
 
 
       Options(ostream &out = cout);
@@ -62,6 +75,19 @@ namespace Server {
 
   };
 
+  class Mailbox;
+
+  // counted per thread, i.e. without synchronization
+  class Stats {
+    public:
+      uint64_t connections   {0};
+      uint64_t bytes_read    {0};
+      uint64_t bytes_written {0};
+
+      Stats &operator+=(const Stats &o);
+      void print(ostream &o, double seconds) const;
+  };
+
   class Main {
     private:
       std::ostream &out_;
@@ -72,18 +98,44 @@ namespace Server {
       boost::asio::ssl::context context_;
       boost::asio::signal_set signals_;
       asio::basic_waitable_timer<std::chrono::steady_clock> limit_timer_;
+      std::shared_ptr<const Mailbox> mailbox_;
+      Stats stats_;
+
+      void open_acceptor();
 
       void do_ssl_accept();
       void do_accept();
 
     public:
+      // the mailbox is loaded from opts.maildir if it isn't shared
       Main(boost::asio::io_service& io_service, const Options &opts,
-          std::ostream &out = std::cout);
+          std::ostream &out = std::cout,
+          std::shared_ptr<const Mailbox> mailbox = nullptr);
+      ~Main();
 
       void cancel_limit();
 
       std::ostream &out() const { return out_; }
+      const Mailbox &mailbox() const { return *mailbox_; }
+      Stats &stats() { return stats_; }
+
+  };
+
+  // One io_service, acceptor and SSL context per thread - the acceptors
+  // share the port via SO_REUSEPORT such that the kernel distributes the
+  // connections and a session stays on the thread that accepted it.
+  class Pool {
+    private:
+      std::ostream &out_;
+      const Options &opts_;
+      std::vector<std::unique_ptr<boost::asio::io_service> > io_services_;
+      std::vector<std::unique_ptr<Main> > mains_;
+    public:
+      Pool(const Options &opts, std::ostream &out = std::cout);
+      ~Pool();
 
+      // returns when all threads are done, prints the aggregated stats
+      void run();
   };
 
 }
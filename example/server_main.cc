@@ -28,11 +28,9 @@ int main(int argc, char **argv)
   try {
     Server::Options opts(argc, argv);
 
-    boost::asio::io_service io_service;
+    Server::Pool pool(opts);
 
-    Server::Main s(io_service, opts);
-
-    io_service.run();
+    pool.run();
   } catch (std::exception& e) {
     std::cerr << "Exception: " << e.what() << "\n";
     return 1;
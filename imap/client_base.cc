@@ -24,6 +24,9 @@
 //#include <boost/log/attributes/named_scope.hpp>
 
 #include "exception.h"
+#include <alloc/accounting.h>
+
+#include <algorithm>
 
 namespace IMAP {
 
@@ -49,44 +52,52 @@ namespace IMAP {
     {
       write_fn_(cmd_);
     }
+    void Base::push_fn(const std::string &tag, Done_Fn fn)
+    {
+      tag_to_fn_.emplace_back(tag, std::move(fn));
+    }
 
-    void Base::async_capabilities(std::function<void(void)> fn)
+    void Base::async_capabilities(Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_ALLOC_TAG("command");
       string tag;
       writer_.capability(tag);
-      tag_to_fn_[tag] = fn;
+      push_fn(tag, std::move(fn));
       BOOST_LOG(lg_) << "Getting CAPABILITIES ..." << " [" << tag << ']';
       do_write();
     }
 
     void Base::async_login(const std::string &username, const std::string &password,
-        std::function<void(void)> fn)
+        Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_ALLOC_TAG("command");
       string tag;
       writer_.login(username, password, tag);
-      tag_to_fn_[tag] = fn;
+      push_fn(tag, std::move(fn));
       BOOST_LOG(lg_) << "Logging in as |" << username << "| [" << tag << "]";
-      BOOST_LOG_SEV(lg_, Log::INSANE) << "Password: |" << password << "|";
+      IMAPDL_LOG_SEV(lg_, Log::INSANE) << "Password: |" << password << "|";
       do_write();
     }
     void Base::async_list(const std::string &reference, const std::string &mailbox,
-        std::function<void(void)> fn)
+        Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_ALLOC_TAG("command");
       string tag;
       writer_.list(reference, mailbox, tag);
-      tag_to_fn_[tag] = fn;
-      BOOST_LOG_SEV(lg_, Log::DEBUG) << "Listing: |" << reference << "| |" << mailbox << "|";
+      push_fn(tag, std::move(fn));
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Listing: |" << reference << "| |" << mailbox << "|";
       do_write();
     }
-    void Base::async_select(const std::string &mailbox, std::function<void(void)> fn)
+    void Base::async_select(const std::string &mailbox, Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_ALLOC_TAG("command");
       string tag;
       writer_.select(mailbox, tag);
-      tag_to_fn_[tag] = fn;
+      push_fn(tag, std::move(fn));
       BOOST_LOG(lg_) << "Selecting mailbox: |" << mailbox << "|" << " [" << tag << ']';
       do_write();
     }
@@ -94,12 +105,13 @@ namespace IMAP {
     void Base::async_fetch(
             const std::vector<std::pair<uint32_t, uint32_t> > &set,
             const std::vector<IMAP::Client::Fetch_Attribute> &atts,
-            std::function<void(void)> fn)
+            Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_ALLOC_TAG("command");
       string tag;
       writer_.fetch(set, atts, tag);
-      tag_to_fn_[tag] = fn;
+      push_fn(tag, std::move(fn));
       BOOST_LOG(lg_) << "Fetching messages " <<  " ..." << " [" << tag << ']';
       do_write();
     }
@@ -107,64 +119,74 @@ namespace IMAP {
     void Base::async_store(
             const std::vector<std::pair<uint32_t, uint32_t> > &set,
             const std::vector<IMAP::Flag> &flags,
-            std::function<void(void)> fn)
+            Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_ALLOC_TAG("command");
       string tag;
       writer_.uid_store(set, flags, tag, IMAP::Client::Store_Mode::REPLACE, true);
-      tag_to_fn_[tag] = fn;
+      push_fn(tag, std::move(fn));
       BOOST_LOG(lg_) << "Storing DELETED flags ..." << " [" << tag << ']';
       do_write();
     }
     void Base::async_uid_expunge(const std::vector<std::pair<uint32_t, uint32_t> > &set,
-        std::function<void(void)> fn)
+        Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_ALLOC_TAG("command");
       string tag;
       writer_.uid_expunge(set, tag);
-      tag_to_fn_[tag] = fn;
+      push_fn(tag, std::move(fn));
       BOOST_LOG(lg_) << "Expunging messages ..." << " [" << tag << ']';
       do_write();
     }
-    void Base::async_expunge(std::function<void(void)> fn)
+    void Base::async_expunge(Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_ALLOC_TAG("command");
       string tag;
       writer_.expunge(tag);
-      tag_to_fn_[tag] = fn;
+      push_fn(tag, std::move(fn));
       BOOST_LOG(lg_) << "Expunging messages (without UIDPLUS) ..." << " [" << tag << ']';
       do_write();
     }
 
-    void Base::async_logout(std::function<void(void)> fn)
+    void Base::async_logout(Done_Fn fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_ALLOC_TAG("command");
       string tag;
       writer_.logout(tag);
-      tag_to_fn_[tag] = fn;
+      push_fn(tag, std::move(fn));
       BOOST_LOG(lg_) << "Logging out ..." << " [" << tag << ']';
       //state_ = State::LOGGING_OUT;
       do_write();
     }
     void Base::imap_tagged_status_end(IMAP::Server::Response::Status c)
     {
-      BOOST_LOG_FUNCTION();
-      string tag(tag_buffer_.begin(), tag_buffer_.end());
-      BOOST_LOG(lg_) << "Got status " << c << " for tag " << tag;
-      if (c != IMAP::Server::Response::Status::OK) {
-        stringstream o;
-        o << "Command failed: " << c << " - " << string(buffer_.begin(), buffer_.end());
-        THROW_MSG(o.str());
-      }
-      auto i = tag_to_fn_.find(tag);
-      if (i == tag_to_fn_.end()) {
-        stringstream o;
-        o << "Got unknown tag: " << tag;
-        THROW_MSG(o.str());
+      IMAPDL_LOG_FUNCTION();
+      Done_Fn fn;
+      {
+        IMAPDL_ALLOC_TAG("tagged status");
+        string tag(tag_buffer_.begin(), tag_buffer_.end());
+        BOOST_LOG(lg_) << "Got status " << c << " for tag " << tag;
+        if (c != IMAP::Server::Response::Status::OK) {
+          stringstream o;
+          o << "Command failed: " << c << " - " << string(buffer_.begin(), buffer_.end());
+          THROW_MSG(o.str());
+        }
+        auto i = std::find_if(tag_to_fn_.begin(), tag_to_fn_.end(),
+            [&tag](const std::pair<std::string, Done_Fn> &p) {
+              return p.first == tag; });
+        if (i == tag_to_fn_.end()) {
+          stringstream o;
+          o << "Got unknown tag: " << tag;
+          THROW_MSG(o.str());
+        }
+        tags_.pop(tag);
+        fn = std::move(i->second);
+        tag_to_fn_.erase(i);
       }
-      tags_.pop(tag);
-      auto fn = i->second;
-      tag_to_fn_.erase(i);
       fn();
     }
 
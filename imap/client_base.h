@@ -25,10 +25,10 @@
 #include <imap/client_parser.h>
 
 #include <log/log.h>
+#include <completion.h>
 #include <buffer/buffer.h>
 
 #include <string>
-#include <map>
 #include <vector>
 #include <functional>
 #include <utility>
@@ -41,6 +41,7 @@ namespace IMAP {
     class Base : public IMAP::Client::Callback::Null {
       public:
         using Write_Fn = std::function<void(std::vector<char> &v)>;
+        using Done_Fn  = Completion<void(void)>;
       private:
         boost::log::sources::severity_logger< Log::Severity > &lg_;
         Write_Fn write_fn_;
@@ -48,33 +49,36 @@ namespace IMAP {
         IMAP::Client::Tag    tags_;
         std::vector<char>    cmd_;
         IMAP::Client::Writer writer_;
-        std::map<std::string, std::function<void(void)> > tag_to_fn_;
+        // only a few commands are outstanding at a time, and the capacity
+        // is kept, i.e. no allocations per command
+        std::vector<std::pair<std::string, Done_Fn> > tag_to_fn_;
 
         void to_cmd(vector<char> &x);
         void do_write();
+        void push_fn(const std::string &tag, Done_Fn fn);
 
       protected:
         Memory::Buffer::Vector tag_buffer_;
         Memory::Buffer::Vector buffer_;
         // generic imap client functions
-        void async_capabilities(std::function<void(void)> fn);
+        void async_capabilities(Done_Fn fn);
         void async_login(const std::string &username, const std::string &password,
-            std::function<void(void)> fn);
+            Done_Fn fn);
         void async_list(const std::string &reference, const std::string &mailbox,
-            std::function<void(void)> fn);
-        void async_select(const std::string &mailbox, std::function<void(void)> fn);
+            Done_Fn fn);
+        void async_select(const std::string &mailbox, Done_Fn fn);
         void async_fetch(
             const std::vector<std::pair<uint32_t, uint32_t> > &set,
             const std::vector<IMAP::Client::Fetch_Attribute> &atts,
-            std::function<void(void)> fn);
+            Done_Fn fn);
         void async_store(
             const std::vector<std::pair<uint32_t, uint32_t> > &set,
             const std::vector<IMAP::Flag> &flags,
-            std::function<void(void)> fn);
+            Done_Fn fn);
         void async_uid_expunge(const std::vector<std::pair<uint32_t, uint32_t> > &set,
-            std::function<void(void)> fn);
-        void async_expunge(std::function<void(void)> fn);
-        void async_logout(std::function<void(void)> fn);
+            Done_Fn fn);
+        void async_expunge(Done_Fn fn);
+        void async_logout(Done_Fn fn);
 
         void imap_tagged_status_end(IMAP::Server::Response::Status c) override;
       public:
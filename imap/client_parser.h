@@ -86,6 +86,9 @@ namespace IMAP {
           virtual void imap_body_section_end() = 0;
           virtual void imap_section_empty() = 0;
           virtual void imap_section_header() = 0;
+          // content of a body section literal - when the literal sink
+          // is enabled - possibly split over several calls
+          virtual void imap_literal_data(const char *begin, const char *end) = 0;
 
           virtual void imap_list_begin() = 0;
           virtual void imap_list_end() = 0;
@@ -128,6 +131,7 @@ namespace IMAP {
           void imap_body_section_end() override;
           void imap_section_empty() override;
           void imap_section_header() override;
+          void imap_literal_data(const char *begin, const char *end) override;
 
           virtual void imap_list_begin() override;
           virtual void imap_list_end() override;
@@ -151,6 +155,8 @@ namespace IMAP {
 
         Memory::Buffer::Base    &buffer_;
         bool                     convert_crlf_  {true};
+        bool                     literal_sink_  {false};
+        size_t                   sink_pending_  {0};
         Memory::Buffer::Base    &tag_buffer_;
         Callback::Base          &cb_;
         Server::Response::Status status_        {Server::Response::Status::OK};
@@ -163,6 +169,11 @@ namespace IMAP {
         bool finished() const;
         void verify_finished() const;
         void set_convert_crlf(bool b);
+        void set_literal_sink(bool b);
+        // bytes of the current sink literal that are still to come
+        size_t literal_pending() const;
+        // the caller consumed n of them itself, e.g. via splice()
+        void skip_literal(size_t n);
 
     };
 
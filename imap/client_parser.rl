@@ -24,6 +24,7 @@
 #include <string>
 #include <iomanip>
 #include <sstream>
+#include <algorithm>
 
 using namespace std;
 
@@ -477,6 +478,24 @@ action cb_section_empty
 {
   cb_.imap_section_empty();
 }
+# with the literal sink enabled, the literal content isn't fed through
+# the automaton - what is available is passed to the callback and the
+# rest is passed at the beginning of the next read() calls
+action call_literal_sink
+{
+  if (number_) {
+    if (literal_sink_) {
+      size_t n = min(size_t(pe - p - 1), size_t(number_));
+      cb_.imap_literal_data(p + 1, p + 1 + n);
+      sink_pending_ = number_ - n;
+      fexec p + 1 + n;
+    } else if (convert_crlf_) {
+      fcall literal_tail_convert;
+    } else {
+      fcall literal_tail;
+    }
+  }
+}
 
 action cb_list_begin
 {
@@ -949,6 +968,10 @@ envelope = '(' env_date   SP env_subject     SP env_from       SP
 # XXX parse nested structures body structure
 body = ( '(' | ')' | SP | string | nil | number )+ ;
 
+body_literal = '{' number '}' CRLF @buffer_clear @call_literal_sink ;
+
+body_nstring = quoted | body_literal | nil ;
+
 
 
 # msg-att-static  = "ENVELOPE" SP envelope / "INTERNALDATE" SP date-time /
@@ -966,7 +989,7 @@ msg_att_static = /ENVELOPE/i     SP envelope
                | /BODY/i (/STRUCTURE/i)? SP body
                | /BODY/i section ( '<' number '>' )?
                    SP      @cb_body_section_inner
-                   nstring %cb_body_section_end
+                   body_nstring %cb_body_section_end
                | /UID/i SP uniqueid %cb_uid ;
 
 # msg-att-dynamic = "FLAGS" SP "(" [flag-fetch *(SP flag-fetch)] ")"
@@ -1141,6 +1164,14 @@ namespace IMAP {
 
     void Parser::read(const char *begin, const char *end)
     {
+      if (sink_pending_) {
+        size_t n = min(size_t(end - begin), sink_pending_);
+        cb_.imap_literal_data(begin, begin + n);
+        sink_pending_ -= n;
+        begin += n;
+        if (begin == end)
+          return;
+      }
       const char *p   = begin;
       const char *pe  = end;
       const char *eof = nullptr;
@@ -1183,6 +1214,22 @@ namespace IMAP {
       convert_crlf_ = b;
     }
 
+    // e.g. for writing the message body directly into a file
+    void Parser::set_literal_sink(bool b)
+    {
+      literal_sink_ = b;
+    }
+    size_t Parser::literal_pending() const
+    {
+      return sink_pending_;
+    }
+    void Parser::skip_literal(size_t n)
+    {
+      if (n > sink_pending_)
+        throw logic_error("skipping more than the pending literal bytes");
+      sink_pending_ -= n;
+    }
+
   }
 
 }
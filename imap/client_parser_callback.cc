@@ -112,6 +112,9 @@ namespace IMAP {
       void Null::imap_section_header()
       {
       }
+      void Null::imap_literal_data(const char *, const char *)
+      {
+      }
 
       void Null::imap_list_begin()
       {
@@ -22,6 +22,8 @@
 #define IMAP_SERVER_PARSER_H
 
 #include <vector>
+#include <string>
+#include <utility>
 #include <cstdint>
 
 using namespace std;
@@ -33,6 +35,21 @@ namespace IMAP {
 
   namespace Server {
 
+    // a '*' in a sequence set is stored as the maximal uint32_t value
+    using Sequence_Ranges = std::vector<std::pair<uint32_t, uint32_t> >;
+
+    class Fetch_Attribute {
+      public:
+        IMAP::Client::Fetch      fetch   { IMAP::Client::Fetch::FIRST_ };
+        // FIRST_ means the complete message, e.g. BODY[]
+        IMAP::Section            section { IMAP::Section::FIRST_ };
+        // section part specifiers, e.g. BODY[1.2], are not evaluated
+        bool                     part    { false };
+        std::vector<std::string> headers;
+
+        Fetch_Attribute(IMAP::Client::Fetch fetch);
+    };
+
     namespace Callback {
 
       using namespace IMAP::Server::Response;
@@ -42,6 +59,22 @@ namespace IMAP {
           virtual ~Base();
           virtual bool imapd_login(const Memory::Buffer::Base &userid,
               const Memory::Buffer::Base &password) = 0;
+          virtual void imapd_capability() = 0;
+          virtual void imapd_noop() = 0;
+          virtual void imapd_logout() = 0;
+          virtual bool imapd_select(const Memory::Buffer::Base &mailbox,
+              bool read_only) = 0;
+          virtual void imapd_close() = 0;
+          virtual void imapd_fetch(bool uid, const Sequence_Ranges &set,
+              const std::vector<Fetch_Attribute> &atts) = 0;
+          virtual void imapd_store(bool uid, const Sequence_Ranges &set,
+              IMAP::Client::Store_Mode mode, bool silent,
+              const std::vector<IMAP::Flag> &flags) = 0;
+          // set is empty for a plain EXPUNGE
+          virtual void imapd_expunge(bool uid, const Sequence_Ranges &set) = 0;
+          // called after each complete command line, i.e. also after
+          // commands without a dedicated callback
+          virtual void imapd_command_end() = 0;
       };
 
       class Null : public Base {
@@ -49,6 +82,19 @@ namespace IMAP {
         public:
           bool imapd_login(const Memory::Buffer::Base &userid,
               const Memory::Buffer::Base &password) override;
+          void imapd_capability() override;
+          void imapd_noop() override;
+          void imapd_logout() override;
+          bool imapd_select(const Memory::Buffer::Base &mailbox,
+              bool read_only) override;
+          void imapd_close() override;
+          void imapd_fetch(bool uid, const Sequence_Ranges &set,
+              const std::vector<Fetch_Attribute> &atts) override;
+          void imapd_store(bool uid, const Sequence_Ranges &set,
+              IMAP::Client::Store_Mode mode, bool silent,
+              const std::vector<IMAP::Flag> &flags) override;
+          void imapd_expunge(bool uid, const Sequence_Ranges &set) override;
+          void imapd_command_end() override;
       };
     }
 
@@ -68,6 +114,17 @@ namespace IMAP {
           {IMAP::Connection::State::NOT_AUTHENTICATED};
         bool                     read_only_     {false};
 
+        // arguments of the current command
+        Memory::Buffer::Vector   field_buffer_;
+        bool                     uid_           {false};
+        uint32_t                 seq_number_    {0};
+        Sequence_Ranges             sequence_set_;
+        vector<Fetch_Attribute>  fetch_attributes_;
+        IMAP::Client::Store_Mode store_mode_
+          {IMAP::Client::Store_Mode::REPLACE};
+        bool                     silent_        {false};
+        vector<IMAP::Flag>       flags_;
+
         Memory::Buffer::Base    &buffer_;
         Memory::Buffer::Base    &tag_buffer_;
         Callback::Base          &cb_;
@@ -23,6 +23,8 @@
 #include <stdexcept>
 #include <string>
 #include <iomanip>
+#include <limits>
+#include <utility>
 
 using namespace std;
 
@@ -49,31 +51,31 @@ machine imapd;
 
 action cb_flag_recent
 {
-//  cb_.imap_flag(Server::Response::Flag::RECENT);
+  flags_.push_back(IMAP::Flag::RECENT);
 }
 action cb_flag_answered
 {
-//  cb_.imap_flag(Server::Response::Flag::ANSWERED);
+  flags_.push_back(IMAP::Flag::ANSWERED);
 }
 action cb_flag_flagged
 {
-//  cb_.imap_flag(Server::Response::Flag::FLAGGED);
+  flags_.push_back(IMAP::Flag::FLAGGED);
 }
 action cb_flag_deleted
 {
-//  cb_.imap_flag(Server::Response::Flag::DELETED);
+  flags_.push_back(IMAP::Flag::DELETED);
 }
 action cb_flag_seen
 {
-//  cb_.imap_flag(Server::Response::Flag::SEEN);
+  flags_.push_back(IMAP::Flag::SEEN);
 }
 action cb_flag_draft
 {
-//  cb_.imap_flag(Server::Response::Flag::DRAFT);
+  flags_.push_back(IMAP::Flag::DRAFT);
 }
 action cb_flag_atom
 {
-//  cb_.imap_atom_flag();
+  // keywords aren't evaluated
 }
 action cb_body_section_begin
 {
@@ -83,6 +85,165 @@ action cb_section_empty
 }
 action cb_section_header
 {
+  fetch_attributes_.back().section = IMAP::Section::HEADER;
+}
+action cb_section_header_fields
+{
+  fetch_attributes_.back().section = IMAP::Section::HEADER_FIELDS;
+}
+action cb_section_header_fields_not
+{
+  fetch_attributes_.back().section = IMAP::Section::HEADER_FIELDS_NOT;
+}
+action cb_section_text
+{
+  fetch_attributes_.back().section = IMAP::Section::TEXT;
+}
+action cb_section_part
+{
+  fetch_attributes_.back().part = true;
+}
+action field_start
+{
+  field_buffer_.start(p);
+}
+action field_finish
+{
+  field_buffer_.finish(p);
+  fetch_attributes_.back().headers.emplace_back(
+      field_buffer_.begin(), field_buffer_.end());
+}
+
+action tag_start
+{
+  tag_buffer_.start(p);
+}
+action tag_finish
+{
+  tag_buffer_.finish(p);
+}
+action command_begin
+{
+  uid_        = false;
+  sequence_set_.clear();
+  fetch_attributes_.clear();
+  store_mode_ = IMAP::Client::Store_Mode::REPLACE;
+  silent_     = false;
+  flags_.clear();
+}
+action cb_command_end
+{
+  cb_.imapd_command_end();
+}
+action uid_begin
+{
+  uid_ = true;
+}
+
+action seq_number_finish
+{
+  seq_number_ = number_;
+}
+action seq_number_star
+{
+  seq_number_ = numeric_limits<uint32_t>::max();
+}
+action seq_first
+{
+  sequence_set_.emplace_back(seq_number_, seq_number_);
+}
+action seq_last
+{
+  auto &r = sequence_set_.back();
+  r.second = seq_number_;
+  if (r.second < r.first)
+    swap(r.first, r.second);
+}
+
+action att_envelope
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::ENVELOPE);
+}
+action att_flags
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::FLAGS);
+}
+action att_internaldate
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::INTERNALDATE);
+}
+action att_rfc822
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::RGC822);
+}
+action att_rfc822_header
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::RFC822_HEADER);
+}
+action att_rfc822_size
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::RFC822_SIZE);
+}
+action att_rfc822_text
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::RFC822_TEXT);
+}
+action att_body_structure_non_extensible
+{
+  fetch_attributes_.emplace_back(
+      IMAP::Client::Fetch::BODYSTRUCTURE_NON_EXTENSIBLE);
+}
+action att_body_structure
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::BODYSTRUCTURE);
+}
+action att_uid
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::UID);
+}
+action att_body
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::BODY);
+}
+action att_body_peek
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::BODY_PEEK);
+}
+# macros as defined in RFC3501, Section 6.4.5
+action att_fast
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::FLAGS);
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::INTERNALDATE);
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::RFC822_SIZE);
+}
+action att_all
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::FLAGS);
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::INTERNALDATE);
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::RFC822_SIZE);
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::ENVELOPE);
+}
+action att_full
+{
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::FLAGS);
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::INTERNALDATE);
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::RFC822_SIZE);
+  fetch_attributes_.emplace_back(IMAP::Client::Fetch::ENVELOPE);
+  fetch_attributes_.emplace_back(
+      IMAP::Client::Fetch::BODYSTRUCTURE_NON_EXTENSIBLE);
+}
+
+action store_add
+{
+  store_mode_ = IMAP::Client::Store_Mode::ADD;
+}
+action store_remove
+{
+  store_mode_ = IMAP::Client::Store_Mode::REMOVE;
+}
+action store_silent
+{
+  silent_ = true;
 }
 
 action userid_begin
@@ -145,38 +306,64 @@ action cb_login
   } else {
   }
 }
+action cb_capability
+{
+  cb_.imapd_capability();
+}
+action cb_noop
+{
+  cb_.imapd_noop();
+}
 action cb_logout
 {
   state_ = IMAP::Connection::State::LOGGED_OUT;
+  cb_.imapd_logout();
 }
+# a failed SELECT/EXAMINE deselects a previously selected mailbox
 action cb_examine
 {
-  state_ = IMAP::Connection::State::SELECTED;
-  read_only_ = true;
+  if (cb_.imapd_select(buffer_, true)) {
+    state_ = IMAP::Connection::State::SELECTED;
+    read_only_ = true;
+  } else {
+    state_ = IMAP::Connection::State::AUTHENTICATED;
+  }
 }
 action cb_select
 {
-  state_ = IMAP::Connection::State::SELECTED;
-  read_only_ = false;
+  if (cb_.imapd_select(buffer_, false)) {
+    state_ = IMAP::Connection::State::SELECTED;
+    read_only_ = false;
+  } else {
+    state_ = IMAP::Connection::State::AUTHENTICATED;
+  }
 }
 action cb_close
 {
   state_ = IMAP::Connection::State::AUTHENTICATED;
+  cb_.imapd_close();
+}
+action cb_fetch
+{
+  cb_.imapd_fetch(uid_, sequence_set_, fetch_attributes_);
 }
 action cb_store
 {
   if (read_only_)
     throw std::runtime_error("STORE not allowed an read-only selected mailbox");
+  cb_.imapd_store(uid_, sequence_set_, store_mode_, silent_, flags_);
 }
 action cb_expunge
 {
   if (read_only_)
     throw std::runtime_error("EXPUNGE not allowed an read-only selected mailbox");
+  cb_.imapd_expunge(false, sequence_set_);
 }
 action cb_uid_expunge
 {
   if (read_only_)
     throw std::runtime_error("UID EXPUNGE not allowed an read-only selected mailbox");
+  cb_.imapd_expunge(true, sequence_set_);
 }
 # using this instead of the RAGEL state chart syntax
 # because state transitions not only depend on the syntax
@@ -229,9 +416,9 @@ id = /ID/i SP id_params_list
 #command-any     = "CAPABILITY" / "LOGOUT" / "NOOP" / x-command
 #                    ; Valid in all states
 
-command_any = /CAPABILITY/i
+command_any = /CAPABILITY/i %cb_capability
             | /LOGOUT/i %cb_logout
-            | /NOOP/i
+            | /NOOP/i %cb_noop
             # RFC2971 IMAP4 ID extension
             | id
             # add x-commands as needed
@@ -373,7 +560,8 @@ command_nonauth = login
 #                    ; messages in the selected mailbox.  This
 #                    ; includes "*" if the selected mailbox is empty.
 
-seq_number = nz_number | '*'
+seq_number = nz_number %seq_number_finish
+           | '*'       @seq_number_star
   ;
 
 #seq-range       = seq-number ":" seq-number
@@ -388,6 +576,12 @@ seq_number = nz_number | '*'
 seq_range = seq_number ':' seq_number
   ;
 
+# equivalent to (seq-number / seq-range), but deterministic
+# such that the sequence set can be recorded
+
+seq_item = seq_number %seq_first ( ':' seq_number %seq_last )?
+  ;
+
 #sequence-set    = (seq-number / seq-range) *("," sequence-set)
 #                    ; set of seq-number values, regardless of order.
 #                    ; Servers MAY coalesce overlaps and/or execute the
@@ -400,7 +594,7 @@ seq_range = seq_number ':' seq_number
 #                    ; 10,9,8,7,6,5,4,5,6,7 and MAY be reordered and
 #                    ; overlap coalesced to be 4,5,6,7,8,9,10.
 
-sequence_set = (seq_number | seq_range) (',' (seq_number | seq_range))*
+sequence_set = seq_item (',' seq_item)*
   ;
 
 #copy            = "COPY" SP sequence-set SP mailbox
@@ -415,28 +609,62 @@ copy = /COPY/i SP sequence_set SP mailbox
 #                  "BODY" section ["<" number "." nz-number ">"] /
 #                  "BODY.PEEK" section ["<" number "." nz-number ">"]
 
-fetch_att = /ENVELOPE/i
-          | /FLAGS/i
-          | /INTERNALDATE/i
-          | /RFC822/i (/.HEADER/i | /.SIZE/i | /.TEXT/i)?
-          | /BODY/i   (/STRUCTURE/i)?
-          | /UID/i
-          | /BODY/i      section ('<' number '.' nz_number '>')?
-          | /BODY.PEEK/i section ('<' number '.' nz_number '>')?
+# header names given as quoted string or literal are accepted but
+# not recorded
+
+fetch_header_fld_name = ASTRING_CHAR+ >field_start %field_finish
+                      | string
+  ;
+
+fetch_header_list = '(' fetch_header_fld_name (SP fetch_header_fld_name)* ')'
+  ;
+
+fetch_section_msgtext = /HEADER/i %cb_section_header
+                      | /HEADER.FIELDS/i %cb_section_header_fields
+                        (/.NOT/i %cb_section_header_fields_not)?
+                        SP fetch_header_list
+                      | /TEXT/i %cb_section_text
+  ;
+
+fetch_section_spec = fetch_section_msgtext
+                   | section_part >cb_section_part ( '.' section_text)?
+  ;
+
+# like section, but the leading '[' is matched by the caller
+
+fetch_section_tail = ( fetch_section_spec ']' | ']' @cb_section_empty )
+  ;
+
+fetch_att = /ENVELOPE/i        %att_envelope
+          | /FLAGS/i           %att_flags
+          | /INTERNALDATE/i    %att_internaldate
+          | /RFC822/i          %att_rfc822
+          | /RFC822.HEADER/i   %att_rfc822_header
+          | /RFC822.SIZE/i     %att_rfc822_size
+          | /RFC822.TEXT/i     %att_rfc822_text
+          | /BODY/i            %att_body_structure_non_extensible
+          | /BODYSTRUCTURE/i   %att_body_structure
+          | /UID/i             %att_uid
+          | /BODY/i      '[' @att_body      fetch_section_tail
+                         ('<' number '.' nz_number '>')?
+          | /BODY.PEEK/i '[' @att_body_peek fetch_section_tail
+                         ('<' number '.' nz_number '>')?
   ;
 
 #fetch           = "FETCH" SP sequence-set SP ("ALL" / "FULL" / "FAST" /
 #                  fetch-att / "(" fetch-att *(SP fetch-att) ")")
 
 fetch = /FETCH/i SP sequence_set SP
-                 ( /ALL/i | /FULL/i | /FAST/i |
+                 ( /ALL/i %att_all | /FULL/i %att_full | /FAST/i %att_fast |
                    fetch_att | '(' fetch_att (SP fetch_att)* ')' )
+  %cb_fetch
   ;
 
 #store-att-flags = (["+" / "-"] "FLAGS" [".SILENT"]) SP
 #                  (flag-list / (flag *(SP flag)))
 
-store_att_flags = ('+'|'-')? /FLAGS/i (/.SILENT/i)? SP
+store_att_flags = ('+' @store_add | '-' @store_remove)?
+                  /FLAGS/i (/.SILENT/i %store_silent)? SP
                   (flag_list | (flag (SP flag)*))
   ;
 
@@ -532,7 +760,7 @@ search = /SEARCH/i (SP /CHARSET/i SP astring)? (SP @call_search_key)+
 #                    ; Unique identifiers used instead of message
 #                    ; sequence numbers
 
-uid = /UID/i SP (copy | fetch | search | store)
+uid = /UID/i %uid_begin SP (copy | fetch | search | store)
   ;
 
 # RFC4315 IMAP UIDPLUS extension
@@ -565,22 +793,22 @@ command_select = /CHECK/i
 #                  command-select) CRLF
 #                    ; Modal based on state
 
-prefix = tag SP
+prefix = tag >command_begin >tag_start %tag_finish SP
   ;
 
 
 selected := ( prefix 
               ( command_select
               | command_auth
-              | command_any )         CR LF @jmp_state ) ;
+              | command_any )         CR LF @cb_command_end @jmp_state ) ;
 
 authenticated := ( prefix
                    ( command_auth
-                   | command_any )    CR LF @jmp_state ) ;
+                   | command_any )    CR LF @cb_command_end @jmp_state ) ;
 
 not_authenticated = ( prefix
                       ( command_nonauth
-                      | command_any ) CR LF @jmp_state ) ;
+                      | command_any ) CR LF @cb_command_end @jmp_state ) ;
 
 requests = not_authenticated ; 
 
@@ -606,6 +834,11 @@ namespace IMAP {
 
     %% write data;
 
+    Fetch_Attribute::Fetch_Attribute(IMAP::Client::Fetch fetch)
+      : fetch(fetch)
+    {
+    }
+
     Parser::Parser(Buffer::Base &buffer,
       Buffer::Base &tag_buffer,
       Callback::Base &cb)
@@ -620,6 +853,7 @@ namespace IMAP {
       const char *pe = end;
       Buffer::Resume bur(buffer_, p, pe);
       Buffer::Resume tar(tag_buffer_, p, pe);
+      Buffer::Resume fir(field_buffer_, p, pe);
       %% write exec;
       if (cs == %%{write error;}%%) {
         throw_lex_error("IMAP server automaton in error state", begin, p, pe);
@@ -659,6 +893,38 @@ namespace IMAP {
       {
         return true;
       }
+      void Null::imapd_capability()
+      {
+      }
+      void Null::imapd_noop()
+      {
+      }
+      void Null::imapd_logout()
+      {
+      }
+      bool Null::imapd_select(const Memory::Buffer::Base & /* mailbox */,
+          bool /* read_only */)
+      {
+        return true;
+      }
+      void Null::imapd_close()
+      {
+      }
+      void Null::imapd_fetch(bool /* uid */, const Sequence_Ranges & /* set */,
+          const std::vector<Fetch_Attribute> & /* atts */)
+      {
+      }
+      void Null::imapd_store(bool /* uid */, const Sequence_Ranges & /* set */,
+          IMAP::Client::Store_Mode /* mode */, bool /* silent */,
+          const std::vector<IMAP::Flag> & /* flags */)
+      {
+      }
+      void Null::imapd_expunge(bool /* uid */, const Sequence_Ranges & /* set */)
+      {
+      }
+      void Null::imapd_command_end()
+      {
+      }
 
     }
 
@@ -0,0 +1,125 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "session.h"
+
+#include <exception.h>
+
+#include <iterator>
+
+namespace IMAP {
+
+  namespace Client {
+
+    bool Session::Message::has(IMAP::Flag f) const
+    {
+      return flags & (1u << unsigned(f));
+    }
+
+    Session::Session(const std::string &host, Net::Client::Base &client,
+        boost::log::sources::severity_logger<Log::Severity> &lg)
+      :
+        IMAP::Client::Base(std::bind(&Session::write_command, this,
+              std::placeholders::_1), lg),
+        client_(client),
+        app_(host, client_, lg),
+        parser_(buffer_proxy_, tag_buffer_, *this)
+    {
+      buffer_proxy_.set(&buffer_);
+    }
+
+    void Session::async_start(Done_Fn fn)
+    {
+      start_fn_ = std::move(fn);
+      // Net::Client::Application takes std::function, thus the member
+      app_.async_start([this](){
+          do_read();
+          Done_Fn fn(std::move(start_fn_));
+          fn();
+        });
+    }
+
+    void Session::async_finish(Done_Fn fn)
+    {
+      finish_fn_ = std::move(fn);
+      app_.async_finish([this](){
+          Done_Fn fn(std::move(finish_fn_));
+          fn();
+        });
+    }
+
+    void Session::set_message_fn(Message_Fn fn)
+    {
+      message_fn_ = std::move(fn);
+    }
+
+    void Session::async_logout(Done_Fn fn)
+    {
+      closing_ = true;
+      Base::async_logout(std::move(fn));
+    }
+
+    void Session::write_command(std::vector<char> &cmd)
+    {
+      client_.push_write(cmd);
+    }
+
+    void Session::do_read()
+    {
+      client_.async_read_some([this](const boost::system::error_code &ec,
+            size_t size)
+          {
+            if (ec) {
+              // e.g. EOF or a truncated TLS stream after the LOGOUT
+              if (closing_)
+                return;
+              THROW_ERROR(ec);
+            }
+            parser_.read(client_.input().data(), client_.input().data() + size);
+            do_read();
+          });
+    }
+
+    void Session::imap_data_fetch_begin(uint32_t number)
+    {
+      message_ = Message();
+      message_.number = number;
+    }
+    void Session::imap_data_fetch_end()
+    {
+      if (message_fn_)
+        message_fn_(message_);
+    }
+    void Session::imap_flag(IMAP::Flag flag)
+    {
+      message_.flags |= 1u << unsigned(flag);
+    }
+    void Session::imap_uid(uint32_t number)
+    {
+      message_.uid = number;
+    }
+    void Session::imap_body_section_end()
+    {
+      message_.size += std::distance(buffer_.begin(), buffer_.end());
+    }
+
+  }
+
+}
@@ -0,0 +1,110 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef IMAP_SESSION_H
+#define IMAP_SESSION_H
+
+#include <imap/client_base.h>
+#include <net/client.h>
+#include <net/client_application.h>
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace IMAP {
+
+  namespace Client {
+
+    // A connection driver for IMAP client flows written as stackless
+    // coroutines (cf. boost/asio/coroutine.hpp), e.g.:
+    //
+    //     reenter (this) {
+    //       yield session.async_start(           [this](){ (*this)(); });
+    //       yield session.async_login(u, p,       [this](){ (*this)(); });
+    //       yield session.async_select("INBOX",   [this](){ (*this)(); });
+    //       yield session.async_fetch(set, atts,  [this](){ (*this)(); });
+    //       yield session.async_logout(          [this](){ (*this)(); });
+    //       yield session.async_finish(          [this](){ (*this)(); });
+    //     }
+    //
+    // The resume lambda fits into a Done_Fn, i.e. the steps don't
+    // allocate. FETCH responses arrive as one Message event each, via the
+    // message function. The body literals stay in the buffer, thus this
+    // is meant for headers and small messages.
+    class Session : public Base {
+      public:
+        struct Message {
+          uint32_t number {0};
+          uint32_t uid    {0};
+          unsigned flags  {0};
+          // of the section literals
+          size_t   size   {0};
+
+          bool has(IMAP::Flag f) const;
+        };
+        using Message_Fn = Completion<void(const Message &m)>;
+      private:
+        Net::Client::Base        &client_;
+        Net::Client::Application  app_;
+        Memory::Buffer::Proxy     buffer_proxy_;
+        IMAP::Client::Parser      parser_;
+        Message                   message_;
+        Message_Fn                message_fn_;
+        Done_Fn                   start_fn_;
+        Done_Fn                   finish_fn_;
+        bool                      closing_ {false};
+
+        void do_read();
+        void write_command(std::vector<char> &cmd);
+
+        void imap_data_fetch_begin(uint32_t number) override;
+        void imap_data_fetch_end() override;
+        void imap_flag(IMAP::Flag flag) override;
+        void imap_uid(uint32_t number) override;
+        void imap_body_section_end() override;
+      public:
+        // host is referenced, not copied
+        Session(const std::string &host, Net::Client::Base &client,
+            boost::log::sources::severity_logger<Log::Severity> &lg);
+
+        // resolve, connect and handshake, then start reading
+        void async_start(Done_Fn fn);
+        // shutdown after the LOGOUT
+        void async_finish(Done_Fn fn);
+
+        void set_message_fn(Message_Fn fn);
+
+        using Base::async_capabilities;
+        using Base::async_login;
+        using Base::async_list;
+        using Base::async_select;
+        using Base::async_fetch;
+        using Base::async_store;
+        using Base::async_uid_expunge;
+        using Base::async_expunge;
+        void async_logout(Done_Fn fn);
+    };
+
+  }
+
+}
+
+#endif
@@ -62,6 +62,26 @@ void safely_write(ostream &o, const char *begin, size_t n)
   o.write(last, i-last);
 }
 
+Safe_Bytes::Safe_Bytes(const char *begin, size_t n, size_t limit)
+  :
+    begin_(begin),
+    n_(n),
+    limit_(limit)
+{
+}
+ostream &Safe_Bytes::print(ostream &o) const
+{
+  size_t n = limit_ ? min(n_, limit_) : n_;
+  safely_write(o, begin_, n);
+  if (n < n_)
+    o << "... (" << (n_ - n) << " more bytes)";
+  return o;
+}
+ostream &operator<<(ostream &o, const Safe_Bytes &b)
+{
+  return b.print(o);
+}
+
 void throw_lex_error(const char *msg, const char *begin, const char *p, const char *pe)
 {
   ostringstream o;
@@ -26,6 +26,21 @@
 
 void safely_write(std::ostream &o, const char *begin, size_t n);
 
+// Zero-copy view on a byte range for log statements - it is only
+// formatted when a sink accepts the record, i.e. when the stream
+// operator is called. Writes at most limit bytes (0 means all) via
+// safely_write() and notes how much was left out.
+class Safe_Bytes {
+  private:
+    const char *begin_;
+    size_t      n_;
+    size_t      limit_;
+  public:
+    Safe_Bytes(const char *begin, size_t n, size_t limit = 0);
+    std::ostream &print(std::ostream &o) const;
+};
+std::ostream &operator<<(std::ostream &o, const Safe_Bytes &b);
+
 void throw_lex_error(const char *msg, const char *begin, const char *p, const char *pe);
 
 void pp_buffer(std::ostream &o, const char *msg, const char *c, size_t size);
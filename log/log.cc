@@ -28,15 +28,23 @@
 #include <boost/log/expressions/formatters/named_scope.hpp>
 #include <boost/log/attributes/scoped_attribute.hpp>
 
-#include <boost/log/utility/setup/console.hpp>
-#include <boost/log/utility/setup/file.hpp>
 #include <boost/log/utility/setup/common_attributes.hpp>
+#include <boost/log/sinks/async_frontend.hpp>
+#include <boost/log/sinks/unbounded_fifo_queue.hpp>
+#include <boost/log/sinks/text_ostream_backend.hpp>
+#include <boost/log/sinks/text_file_backend.hpp>
+#include <boost/core/null_deleter.hpp>
+#include <boost/make_shared.hpp>
 
 // needed for attributes::timer()
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <atomic>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <vector>
 //using namespace std;
 
 
@@ -57,6 +65,56 @@ static const char * const severity_map[] = {
 
 namespace Log {
 
+  // Records are queued (unbounded_fifo_queue, i.e. no lock is held
+  // while formatting or writing) and a dedicated thread per sink formats
+  // and writes them - thus a busy fetch loop doesn't block on the
+  // terminal or the file system.
+  using Console_Sink = boost::log::sinks::asynchronous_sink<
+    boost::log::sinks::text_ostream_backend,
+    boost::log::sinks::unbounded_fifo_queue>;
+  using File_Sink = boost::log::sinks::asynchronous_sink<
+    boost::log::sinks::text_file_backend,
+    boost::log::sinks::unbounded_fifo_queue>;
+
+  static std::atomic<bool> scopes_enabled_ {false};
+  static std::mutex sinks_mutex_;
+  static std::vector<std::function<void(void)> > finishers_;
+
+  template <typename Sink>
+    static void add(const boost::shared_ptr<Sink> &sink)
+    {
+      boost::log::core::get()->add_sink(sink);
+      std::lock_guard<std::mutex> lock(sinks_mutex_);
+      finishers_.emplace_back([sink]() {
+          boost::log::core::get()->remove_sink(sink);
+          sink->stop();
+          sink->flush();
+          });
+    }
+  static boost::shared_ptr<File_Sink> file_sink(const std::string &filename)
+  {
+    auto backend = boost::make_shared<boost::log::sinks::text_file_backend>(
+        boost::log::keywords::file_name = filename);
+    return boost::make_shared<File_Sink>(backend);
+  }
+
+  bool scopes_enabled()
+  {
+    return scopes_enabled_.load(std::memory_order_relaxed);
+  }
+
+  void finish()
+  {
+    std::vector<std::function<void(void)> > fs;
+    {
+      std::lock_guard<std::mutex> lock(sinks_mutex_);
+      fs.swap(finishers_);
+    }
+    for (auto &f : fs)
+      f();
+    scopes_enabled_ = false;
+  }
+
   std::ostream &operator<<(std::ostream &o, Severity s)
   {
     o << enum_str(severity_map, s);
@@ -74,18 +132,20 @@ namespace Log {
 
   static void setup_console(Severity severity_threshold)
   {
-    auto clog = boost::log::add_console_log();
+    auto backend = boost::make_shared<boost::log::sinks::text_ostream_backend>();
+    backend->add_stream(boost::shared_ptr<std::ostream>(&std::clog,
+          boost::null_deleter()));
+    backend->auto_flush(true);
+    auto clog = boost::make_shared<Console_Sink>(backend);
     clog->set_formatter(&format_console);
     clog->set_filter(severity <= severity_threshold);
+    add(clog);
   }
   void setup_file(Severity severity_threshold, const std::string &filename)
   {
     if (filename.empty())
       return;
-    auto flog = boost::log::add_file_log(
-      boost::log::keywords::file_name = filename
-      //, boost::log::keywords::open_mode = std::ios_base::app | std::ios_base::out
-      );
+    auto flog = file_sink(filename);
     flog->set_formatter(
         boost::log::expressions::stream
         << std::setw(5) << std::setfill('0')
@@ -101,15 +161,18 @@ namespace Log {
         << boost::log::expressions::smessage
         );
     flog->set_filter(severity <= severity_threshold);
+    add(flog);
+    scopes_enabled_ = true;
   }
   void setup_vanilla_file(Severity severity_threshold, const std::string &filename)
   {
     if (filename.empty())
       return;
-    auto flog = boost::log::add_file_log(boost::log::keywords::file_name = filename);
+    auto flog = file_sink(filename);
     flog->set_formatter(boost::log::expressions::stream
         << "[" << severity << "] " << boost::log::expressions::smessage);
     flog->set_filter(severity <= severity_threshold);
+    add(flog);
   }
 
   boost::log::sources::severity_logger< Severity > 
@@ -24,6 +24,10 @@
 #include <ostream>
 
 #include <boost/log/sources/severity_logger.hpp>
+#include <boost/log/sources/record_ostream.hpp>
+#include <boost/log/attributes/named_scope.hpp>
+#include <boost/log/utility/unique_identifier_name.hpp>
+#include <boost/current_function.hpp>
 
 namespace Log {
 
@@ -46,6 +50,60 @@ namespace Log {
         const std::string &logfile = std::string());
   void setup_file(Severity severity_threshold, const std::string &filename);
   void setup_vanilla_file(Severity severity_threshold, const std::string &filename);
+  // the sinks format and write on their own thread - flushes and
+  // removes them, call it before reading a log file or exiting
+  void finish();
+
+  // true if a sink prints the scope, i.e. after setup_file()
+  bool scopes_enabled();
+
+  // like boost::log::attributes::named_scope::sentry - but only
+  // pushes the scope when a sink prints it
+  class Scope {
+    private:
+      boost::log::attributes::named_scope_entry entry_;
+      bool enabled_;
+    public:
+      Scope(const boost::log::string_literal &name,
+          const boost::log::string_literal &file, unsigned line)
+        :
+          entry_(name, file, line,
+              boost::log::attributes::named_scope_entry::function),
+          enabled_(scopes_enabled())
+      {
+        if (enabled_)
+          boost::log::attributes::named_scope::push_scope(entry_);
+      }
+      ~Scope()
+      {
+        if (enabled_)
+          boost::log::attributes::named_scope::pop_scope();
+      }
+      Scope(const Scope &) =delete;
+      Scope &operator=(const Scope &) =delete;
+  };
 }
 
+// Statements above this severity are compiled out. Release builds
+// (NDEBUG) keep everything up to INFO, i.e. DEBUG, DEBUG_V and INSANE
+// cost nothing there.
+#ifndef IMAPDL_LOG_MAX_SEVERITY
+  #ifdef NDEBUG
+    #define IMAPDL_LOG_MAX_SEVERITY Log::INFO
+  #else
+    #define IMAPDL_LOG_MAX_SEVERITY Log::INSANE
+  #endif
+#endif
+
+// a loop instead of an if - which would swallow the else of an
+// enclosing if statement
+#define IMAPDL_LOG_SEV(LG, SEV) \
+  for (bool imapdl_log_on_ = (SEV) <= (IMAPDL_LOG_MAX_SEVERITY); \
+      imapdl_log_on_; imapdl_log_on_ = false) \
+    BOOST_LOG_SEV(LG, SEV)
+
+#define IMAPDL_LOG_FUNCTION() \
+  ::Log::Scope BOOST_LOG_UNIQUE_IDENTIFIER_NAME(imapdl_log_scope_)( \
+      BOOST_CURRENT_FUNCTION, __FILE__, __LINE__)
+
 #endif
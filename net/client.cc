@@ -21,9 +21,14 @@
 #include "client.h"
 
 #include <exception.h>
+#include <lex_util.h>
+#include <alloc/accounting.h>
 #include <utility>
+#include <algorithm>
+#include <string.h>
 
 #include <boost/log/sources/record_ostream.hpp>
+#include <boost/asio/error.hpp>
 
 using namespace std;
 
@@ -54,27 +59,50 @@ namespace Net {
     }
     void Base::log_read(size_t size)
     {
+      IMAPDL_ALLOC_TAG("net log");
       bytes_read_ += size;
       trace_writer_.push(Trace::Type::RECEIVED, input_, size);
-      if (opts_.severity < Log::DEBUG && opts_.file_severity < Log::DEBUG)
-        return;
-      BOOST_LOG_SEV(lg_, Log::DEBUG_V) << "Read " << size << " bytes from host";
-      string s(input_.data(), size);
-      BOOST_LOG_SEV(lg_, Log::DEBUG_V) << "Read |" << s << "|";
+      if (flight_recorder_)
+        flight_recorder_->push(Trace::Type::RECEIVED,
+            input_.data(), input_.data() + std::min(size, input_.size()));
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG_V) << "Read " << size << " bytes from host";
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG_V) << "Read |"
+        << Safe_Bytes(input_.data(), size, opts_.log_bytes) << "|";
     }
-    void Base::log_write()
+    void Base::log_write(const std::vector<char> &v)
     {
-      trace_writer_.push(Trace::Type::SENT, write_queue_.front());
-      if (opts_.severity < Log::DEBUG && opts_.file_severity < Log::DEBUG)
-        return;
-      BOOST_LOG_SEV(lg_, Log::DEBUG_V) << "Schedule " << write_queue_.front().size()
+      IMAPDL_ALLOC_TAG("net log");
+      trace_writer_.push(Trace::Type::SENT, v);
+      if (flight_recorder_) {
+        // the recorder is on by default, i.e. no passwords in crash dumps
+        std::vector<char> redacted;
+        if (Trace::redact_credentials(v.data(), v.data() + v.size(), redacted))
+          flight_recorder_->push(Trace::Type::SENT,
+              redacted.data(), redacted.data() + redacted.size());
+        else
+          flight_recorder_->push(Trace::Type::SENT, v.data(), v.data() + v.size());
+      }
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG_V) << "Schedule " << v.size()
         << " bytes to write to host";
-      string s(write_queue_.front().data(), write_queue_.front().size());
-      BOOST_LOG_SEV(lg_, Log::DEBUG_V) << "Schedule write |" << s << "|";
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG_V) << "Schedule write |"
+        << Safe_Bytes(v.data(), v.size(), opts_.log_bytes) << "|";
     }
     void Base::log_shutdown()
     {
       trace_writer_.push(Trace::Type::DISCONNECT);
+      if (flight_recorder_)
+        flight_recorder_->push(Trace::Type::DISCONNECT);
+    }
+    void Base::set_flight_recorder(Trace::Ring *r)
+    {
+      flight_recorder_ = r;
+    }
+    void Base::mark(const char *label)
+    {
+      const char *end = label + strlen(label);
+      trace_writer_.push(Trace::Type::MARK, label, end);
+      if (flight_recorder_)
+        flight_recorder_->push(Trace::Type::MARK, label, end);
     }
     void Base::push_write(std::vector<char> &v)
     {
@@ -95,7 +123,7 @@ namespace Net {
       if (write_queue_.empty())
         THROW_LOGIC_MSG("do_write() called with empty queue");
 
-      log_write();
+      log_write(write_queue_.front());
       async_write(write_queue_.front(), [this](
           const boost::system::error_code &ec, size_t size
             )
@@ -104,7 +132,7 @@ namespace Net {
               THROW_ERROR(ec);
             } else {
               bytes_written_ += size;
-              BOOST_LOG_SEV(lg_, Log::DEBUG_V) << "Wrote " << size << " bytes.";
+              IMAPDL_LOG_SEV(lg_, Log::DEBUG_V) << "Wrote " << size << " bytes.";
               write_free_stack_.push(std::move(write_queue_.front()));
               write_free_stack_.top().clear();
               write_queue_.pop();
@@ -112,6 +140,16 @@ namespace Net {
           });
     }
 
+    void Base::set_quick_ack(bool)
+    {
+    }
+    void Base::async_splice(int, size_t, Splice_Fn fn)
+    {
+      io_service_.post([fn]() {
+          fn(boost::asio::error::operation_not_supported, 0);
+          });
+    }
+
     size_t Base::bytes_read() const
     {
       return bytes_read_;
@@ -41,11 +41,17 @@ namespace Net {
       public:
         unsigned severity      {0};
         unsigned file_severity {0};
+        // prefix of sent/received data in debug messages - 0 means all
+        unsigned log_bytes     {256};
 
         std::string tracefile;
     };
 
+    class Pipeline;
+
     class Base {
+      private:
+        friend class Pipeline;
       protected:
         boost::asio::io_service       &io_service_;
         const Options                 &opts_;
@@ -54,7 +60,7 @@ namespace Net {
         std::queue<std::vector<char> > write_queue_;
 
         void log_read(size_t size);
-        void log_write();
+        void log_write(const std::vector<char> &v);
         void log_shutdown();
       protected:
         size_t bytes_read_    {0};
@@ -63,6 +69,7 @@ namespace Net {
         boost::log::sources::severity_logger<Log::Severity> &lg_;
 
         Trace::Writer trace_writer_;
+        Trace::Ring  *flight_recorder_ {nullptr};
 
         using Resolve_Fn = std::function<void(
             const boost::system::error_code &ec,
@@ -86,6 +93,10 @@ namespace Net {
         using Shutdown_Fn = std::function<void(
             const boost::system::error_code &ec
             )>;
+        using Splice_Fn = std::function<void(
+            const boost::system::error_code &ec,
+            size_t length
+            )>;
 
         Base(boost::asio::io_service &io_service, const Options &opts,
           boost::log::sources::severity_logger<Log::Severity> &lg
@@ -112,6 +123,19 @@ namespace Net {
         virtual void close() = 0;
         virtual bool is_open() const = 0;
 
+        // also record read/written bytes into r (i.e. when r is non-null)
+        void set_flight_recorder(Trace::Ring *r);
+        // record the end of a connection phase (e.g. "resolve") in the trace
+        virtual void mark(const char *label);
+
+        // hint that a bulk transfer follows, e.g. during FETCH
+        virtual void set_quick_ack(bool b);
+        // moves at most size received bytes directly into the file
+        // descriptor fd - i.e. they don't show up in input() - completes
+        // with operation_not_supported if the transport can't do that -
+        // on error, the size is the number of bytes moved before it
+        virtual void async_splice(int fd, size_t size, Splice_Fn fn);
+
         boost::asio::io_service &io_service();
         std::vector<char> &input();
         void do_write();
@@ -21,6 +21,7 @@
 #include "client_application.h"
 
 #include <net/client.h>
+#include <net/resolve_cache.h>
 
 #include <exception.h>
 
@@ -35,12 +36,14 @@ namespace Net {
     Application::Application(
             const std::string &host,
             Net::Client::Base &client,
-            boost::log::sources::severity_logger< Log::Severity > &lg
+            boost::log::sources::severity_logger< Log::Severity > &lg,
+            Net::Resolve_Cache *cache
             )
       :
         host_(host),
         client_(client),
-        lg_(lg)
+        lg_(lg),
+        cache_(cache)
     {
     }
     void Application::async_start(std::function<void(void)> fn)
@@ -53,33 +56,97 @@ namespace Net {
     }
     void Application::async_resolve(std::function<void(void)> fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
+      if (cache_) {
+        boost::asio::ip::tcp::resolver::iterator iterator;
+        try {
+          iterator = cache_->lookup();
+        } catch (const std::exception &e) {
+          IMAPDL_LOG_SEV(lg_, Log::WARN) << "Reading resolve cache failed: " << e.what();
+        }
+        if (iterator != boost::asio::ip::tcp::resolver::iterator()) {
+          BOOST_LOG(lg_) << "Using cached addresses of " << host_ << ".";
+          client_.mark("resolve");
+          // refresh the cache for the next run
+          async_refresh();
+          async_connect(iterator, fn, true);
+          return;
+        }
+      }
+      async_live_resolve(fn);
+    }
+
+    void Application::async_live_resolve(std::function<void(void)> fn)
+    {
+      IMAPDL_LOG_FUNCTION();
       BOOST_LOG(lg_) << "Resolving " << host_ << "...";
       client_.async_resolve([this, fn](const boost::system::error_code &ec,
             boost::asio::ip::tcp::resolver::iterator iterator)
           {
-            BOOST_LOG_FUNCTION();
+            IMAPDL_LOG_FUNCTION();
             if (ec) {
               THROW_ERROR(ec);
             } else {
               BOOST_LOG(lg_) << host_ << " resolved.";
+              client_.mark("resolve");
+              store(iterator);
               async_connect(iterator, fn);
             }
           });
     }
 
+    void Application::async_refresh()
+    {
+      client_.async_resolve([this](const boost::system::error_code &ec,
+            boost::asio::ip::tcp::resolver::iterator iterator)
+          {
+            IMAPDL_LOG_FUNCTION();
+            if (ec) {
+              IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Refreshing resolve cache failed: "
+                << ec.message();
+            } else {
+              IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Refreshed resolve cache of " << host_;
+              store(iterator);
+            }
+          });
+    }
+
+    void Application::store(boost::asio::ip::tcp::resolver::iterator iterator)
+    {
+      if (!cache_)
+        return;
+      try {
+        cache_->store(iterator);
+      } catch (const std::exception &e) {
+        IMAPDL_LOG_SEV(lg_, Log::WARN) << "Writing resolve cache failed: " << e.what();
+      }
+    }
+
     void Application::async_connect(boost::asio::ip::tcp::resolver::iterator iterator,
-        std::function<void(void)> fn)
+        std::function<void(void)> fn, bool cached)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       BOOST_LOG(lg_) << "Connecting to " << host_ << "...";
-      client_.async_connect(iterator, [this, fn](const boost::system::error_code &ec)
+      client_.async_connect(iterator, [this, fn, cached](const boost::system::error_code &ec)
           {
-            BOOST_LOG_FUNCTION();
+            IMAPDL_LOG_FUNCTION();
             if (ec) {
+              if (cached && ec != boost::asio::error::operation_aborted) {
+                IMAPDL_LOG_SEV(lg_, Log::WARN) << "All cached addresses of " << host_
+                  << " failed (" << ec.message() << ") - resolving again";
+                try {
+                  cache_->invalidate();
+                } catch (const std::exception &e) {
+                  IMAPDL_LOG_SEV(lg_, Log::WARN) << "Writing resolve cache failed: "
+                    << e.what();
+                }
+                async_live_resolve(fn);
+                return;
+              }
               THROW_ERROR(ec);
             } else {
               BOOST_LOG(lg_) << host_ << " connected.";
+              client_.mark("connect");
               async_handshake(fn);
             }
           });
@@ -87,15 +154,16 @@ namespace Net {
 
     void Application::async_handshake(std::function<void(void)> fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       BOOST_LOG(lg_) << "Shaking hands with " << host_ << "...";
       client_.async_handshake([this, fn](const boost::system::error_code &ec)
           {
-            BOOST_LOG_FUNCTION();
+            IMAPDL_LOG_FUNCTION();
             if (ec) {
               THROW_ERROR(ec);
             } else {
               BOOST_LOG(lg_) << "Handshake completed.";
+              client_.mark("handshake");
               fn();
             }
           });
@@ -103,20 +171,20 @@ namespace Net {
 
     void Application::async_quit(std::function<void(void)> fn)
     {
-      BOOST_LOG_FUNCTION();
-      BOOST_LOG_SEV(lg_, Log::DEBUG) << "async_quit()";
+      IMAPDL_LOG_FUNCTION();
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "async_quit()";
       client_.cancel();
       async_shutdown(fn);
     }
 
     void Application::async_shutdown(std::function<void(void)> fn)
     {
-      BOOST_LOG_FUNCTION();
+      IMAPDL_LOG_FUNCTION();
       client_.async_shutdown([this, fn](
             const boost::system::error_code &ec)
           {
-            BOOST_LOG_FUNCTION();
-            BOOST_LOG_SEV(lg_, Log::DEBUG) << "shutting down connect to: " << host_;
+            IMAPDL_LOG_FUNCTION();
+            IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "shutting down connect to: " << host_;
             if (ec) {
                         // for Boost >= 1.63 (e.g. Fedora >= 26)
               if
@@ -134,15 +202,15 @@ namespace Net {
               } else if (ec.category() == boost::asio::error::get_misc_category()
                          && ec.value() == boost::asio::error::eof
                          ) {
-                BOOST_LOG_SEV(lg_, Log::DEBUG) << "server " << host_ << " disconnected first";
+                IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "server " << host_ << " disconnected first";
               } else {
                 if (ec.category() == boost::asio::error::get_ssl_category()) {
-                  BOOST_LOG_SEV(lg_, Log::ERROR)
+                  IMAPDL_LOG_SEV(lg_, Log::ERROR)
                     << "ssl_category: lib " << ERR_GET_LIB(ec.value())
                     << " func " << ERR_GET_FUNC(ec.value())
                     << " reason " << ERR_GET_REASON(ec.value());
                 }
-                BOOST_LOG_SEV(lg_, Log::DEBUG) << "do_shutdown() fail: " << ec.message();
+                IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "do_shutdown() fail: " << ec.message();
                 THROW_ERROR(ec);
               }
             } else {
@@ -29,6 +29,7 @@
 #include <log/log.h>
 
 namespace Net { namespace Client { class Base; } }
+namespace Net { class Resolve_Cache; }
 
 namespace Net {
 
@@ -39,10 +40,14 @@ namespace Net {
         const std::string                                     &host_;
         Net::Client::Base                                     &client_;
         boost::log::sources::severity_logger< Log::Severity > &lg_;
+        Net::Resolve_Cache                                    *cache_ {nullptr};
 
         void async_resolve(std::function<void(void)> fn);
+        void async_live_resolve(std::function<void(void)> fn);
+        void async_refresh();
+        void store(boost::asio::ip::tcp::resolver::iterator iterator);
         void async_connect(boost::asio::ip::tcp::resolver::iterator iterator,
-            std::function<void(void)> fn);
+            std::function<void(void)> fn, bool cached = false);
         void async_handshake(std::function<void(void)> fn);
 
         void async_quit(std::function<void(void)> fn);
@@ -51,7 +56,8 @@ namespace Net {
         Application(
             const std::string &host,
             Net::Client::Base &client,
-            boost::log::sources::severity_logger<Log::Severity> &lg
+            boost::log::sources::severity_logger<Log::Severity> &lg,
+            Net::Resolve_Cache *cache = nullptr
             );
         void async_start (std::function<void(void)> fn);
         void async_finish(std::function<void(void)> fn);
@@ -0,0 +1,239 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "connector.h"
+
+#include "tcp_client.h"
+#include "tcp_option.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <boost/log/sources/record_ostream.hpp>
+
+using namespace std;
+namespace asio = boost::asio;
+
+namespace Net {
+
+  namespace TCP {
+
+    Connector::Connector(boost::asio::io_service &io_service,
+        const Client::Options &opts,
+        boost::log::sources::severity_logger<Log::Severity> &lg)
+      :
+        io_service_(io_service),
+        opts_(opts),
+        lg_(lg),
+        timer_(io_service)
+    {
+    }
+
+    void Connector::interleave(std::vector<boost::asio::ip::tcp::endpoint> &v)
+    {
+      if (v.empty())
+        return;
+      bool first_v6 = v.front().address().is_v6();
+      vector<asio::ip::tcp::endpoint> a, b;
+      for (auto &e : v) {
+        if (e.address().is_v6() == first_v6)
+          a.push_back(e);
+        else
+          b.push_back(e);
+      }
+      v.clear();
+      for (size_t i = 0; i < max(a.size(), b.size()); ++i) {
+        if (i < a.size())
+          v.push_back(a[i]);
+        if (i < b.size())
+          v.push_back(b[i]);
+      }
+    }
+
+    bool Connector::racing() const
+    {
+      // with a fixed local port, concurrent attempts would fail with
+      // EADDRINUSE - thus, fall back to one attempt at a time; with
+      // TCP Fast Open, connect() completes immediately, i.e. the first
+      // attempt would always win
+      return opts_.connect_delay && !opts_.local_port && !opts_.fast_open;
+    }
+
+    void Connector::async_connect(boost::asio::ip::tcp::resolver::iterator iterator,
+        boost::asio::ip::tcp::socket &socket, Connect_Fn fn)
+    {
+      reset();
+      ++round_;
+      done_    = false;
+      next_    = 0;
+      pending_ = 0;
+      last_ec_ = asio::error::host_not_found;
+      target_  = &socket;
+      fn_      = fn;
+      start_   = chrono::steady_clock::now();
+
+      endpoints_.clear();
+      if (opts_.local_address.empty()) {
+        for (; iterator != asio::ip::tcp::resolver::iterator(); ++iterator)
+          endpoints_.push_back(iterator->endpoint());
+      } else {
+        // only the family of the local address is able to bind
+        bool v6 = asio::ip::address::from_string(opts_.local_address).is_v6();
+        for (; iterator != asio::ip::tcp::resolver::iterator(); ++iterator)
+          if (iterator->endpoint().address().is_v6() == v6)
+            endpoints_.push_back(iterator->endpoint());
+      }
+      interleave(endpoints_);
+      IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Racing " << endpoints_.size()
+        << " endpoints (delay: " << opts_.connect_delay << " ms)";
+      start_next();
+    }
+
+    void Connector::start_next()
+    {
+      while (next_ < endpoints_.size()) {
+        size_t i = next_++;
+        auto &endpoint = endpoints_[i];
+        unique_ptr<asio::ip::tcp::socket> s(new asio::ip::tcp::socket(io_service_));
+        boost::system::error_code ec;
+        s->open(endpoint.protocol(), ec);
+        if (!ec)
+          Option::apply(*s, opts_, lg_);
+        if (!ec && !opts_.local_address.empty()) {
+          asio::ip::tcp::endpoint local_endpoint(
+              asio::ip::address::from_string(opts_.local_address),
+              opts_.local_port
+              );
+          s->bind(local_endpoint, ec);
+        }
+        if (ec) {
+          IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Skipping " << endpoint << ": "
+            << ec.message();
+          last_ec_ = ec;
+          sockets_.emplace_back();
+          continue;
+        }
+        IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Connecting to " << endpoint
+          << " (attempt " << i + 1 << ")";
+        unsigned round = round_;
+        weak_ptr<bool> alive(alive_);
+        s->async_connect(endpoint, [this, alive, round, i](
+              const boost::system::error_code &ec)
+            {
+              if (alive.expired())
+                return;
+              on_connect(round, i, ec);
+            });
+        sockets_.push_back(std::move(s));
+        ++pending_;
+        wait_next();
+        return;
+      }
+      if (!pending_)
+        fail();
+    }
+
+    void Connector::wait_next()
+    {
+      if (!racing() || next_ == endpoints_.size())
+        return;
+      unsigned round = round_;
+      size_t   next  = next_;
+      weak_ptr<bool> alive(alive_);
+      timer_.expires_from_now(chrono::milliseconds(opts_.connect_delay));
+      timer_.async_wait([this, alive, round, next](
+            const boost::system::error_code &ec)
+          {
+            if (ec || alive.expired())
+              return;
+            // a failed attempt may have already started the next one
+            if (round != round_ || done_ || next != next_)
+              return;
+            start_next();
+          });
+    }
+
+    void Connector::on_connect(unsigned round, size_t i,
+        const boost::system::error_code &ec)
+    {
+      if (round != round_ || done_)
+        return;
+      --pending_;
+      if (ec) {
+        IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Connecting to " << endpoints_[i]
+          << " failed: " << ec.message();
+        last_ec_ = ec;
+        boost::system::error_code ignored;
+        sockets_[i]->close(ignored);
+        if (next_ < endpoints_.size()) {
+          timer_.cancel();
+          start_next();
+        } else if (!pending_) {
+          fail();
+        }
+        return;
+      }
+      finish(i);
+    }
+
+    void Connector::finish(size_t i)
+    {
+      auto d = chrono::duration_cast<chrono::milliseconds>(
+          chrono::steady_clock::now() - start_);
+      BOOST_LOG(lg_) << "Connected to " << endpoints_[i] << " in " << d.count()
+        << " ms (attempt " << i + 1 << " of " << endpoints_.size() << ")";
+      *target_ = std::move(*sockets_[i]);
+      done_ = true;
+      reset();
+      auto fn = std::move(fn_);
+      fn(boost::system::error_code());
+    }
+
+    void Connector::fail()
+    {
+      done_ = true;
+      timer_.cancel();
+      auto fn = std::move(fn_);
+      auto ec = last_ec_;
+      // don't call the completion handler from inside async_connect()
+      io_service_.post([fn, ec]() { fn(ec); });
+    }
+
+    void Connector::cancel()
+    {
+      if (done_)
+        return;
+      last_ec_ = asio::error::operation_aborted;
+      reset();
+      fail();
+    }
+
+    void Connector::reset()
+    {
+      timer_.cancel();
+      boost::system::error_code ignored;
+      for (auto &s : sockets_)
+        if (s)
+          s->close(ignored);
+      sockets_.clear();
+    }
+
+  }
+}
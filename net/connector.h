@@ -0,0 +1,110 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef NET_CONNECTOR_H
+#define NET_CONNECTOR_H
+
+#include <log/log.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/basic_waitable_timer.hpp>
+
+namespace Net {
+
+  namespace TCP {
+
+    namespace Client { class Options; }
+
+    // Connection racing a la RFC 8305 (Happy Eyeballs v2).
+    //
+    // The resolved endpoints are tried in interleaved IPv6/IPv4 order.
+    // The next attempt is started after connect_delay milliseconds - or
+    // immediately when the current one fails. The first connection that
+    // is established wins, the remaining attempts are cancelled.
+    //
+    // Thus, a blackholed address only costs connect_delay and not the
+    // kernel connect timeout.
+    //
+    // The Connector may be destroyed while attempts are pending: the
+    // handlers check a liveness token before they touch any member (and
+    // the completion handler isn't called then). The io_service has to
+    // outlive it, and it must only be run by one thread.
+    class Connector {
+      public:
+        using Connect_Fn = std::function<void(
+            const boost::system::error_code &ec
+            )>;
+      private:
+        boost::asio::io_service                                     &io_service_;
+        const Client::Options                                       &opts_;
+        boost::log::sources::severity_logger<Log::Severity>         &lg_;
+        boost::asio::basic_waitable_timer<std::chrono::steady_clock> timer_;
+
+        std::vector<boost::asio::ip::tcp::endpoint>                  endpoints_;
+        std::vector<std::unique_ptr<boost::asio::ip::tcp::socket> > sockets_;
+        boost::asio::ip::tcp::socket                                *target_ {nullptr};
+        Connect_Fn                                                   fn_;
+        std::chrono::time_point<std::chrono::steady_clock>           start_;
+        boost::system::error_code                                    last_ec_;
+
+        unsigned round_   {0};
+        size_t   next_    {0};
+        size_t   pending_ {0};
+        bool     done_    {true};
+        // expires with the Connector, cf. the class comment
+        std::shared_ptr<bool> alive_ {std::make_shared<bool>(true)};
+
+        bool racing() const;
+        void start_next();
+        void wait_next();
+        void on_connect(unsigned round, size_t i,
+            const boost::system::error_code &ec);
+        void finish(size_t i);
+        void fail();
+        void reset();
+      public:
+        Connector(boost::asio::io_service &io_service,
+            const Client::Options &opts,
+            boost::log::sources::severity_logger<Log::Severity> &lg);
+
+        // on success, the established connection is moved into socket
+        void async_connect(boost::asio::ip::tcp::resolver::iterator iterator,
+            boost::asio::ip::tcp::socket &socket, Connect_Fn fn);
+        // completes a pending async_connect() with operation_aborted
+        void cancel();
+
+        // RFC 8305, Section 4: keep the resolver order inside each
+        // address family, but alternate between the families - starting
+        // with the family of the first endpoint
+        static void interleave(std::vector<boost::asio::ip::tcp::endpoint> &v);
+    };
+
+  }
+}
+
+#endif
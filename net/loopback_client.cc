@@ -0,0 +1,229 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "loopback_client.h"
+
+#include <exception.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string.h>
+
+#include <boost/version.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/log/sources/record_ostream.hpp>
+
+using namespace std;
+namespace asio = boost::asio;
+
+namespace Net {
+
+  namespace Loopback {
+
+    namespace Client {
+
+      Base::Base(boost::asio::io_service &io_service, const Options &opts,
+          boost::log::sources::severity_logger<Log::Severity> &lg
+          )
+        :
+          Net::Client::Base(io_service, opts, lg),
+          opts_(opts),
+          reader_(opts.script)
+      {
+        next_record();
+      }
+
+      void Base::next_record()
+      {
+        // the connection phases are simulated by the async_* calls
+        do {
+          record_ = reader_.next();
+        } while (record_.type == Trace::Type::MARK);
+        pos_ = record_.begin;
+      }
+
+      void Base::serve_read()
+      {
+        for (;;) {
+          if (   (   record_.type == Trace::Type::RECEIVED
+                  || record_.type == Trace::Type::SENT)
+              && pos_ == record_.end)
+            next_record();
+          else if (record_.type == Trace::Type::SENT && !written_.empty())
+            consume_written();
+          else
+            break;
+        }
+        Read_Fn fn;
+        switch (record_.type) {
+          case Trace::Type::RECEIVED:
+            {
+              size_t n = std::min(input_.size(), size_t(record_.end - pos_));
+              memcpy(input_.data(), pos_, n);
+              pos_ += n;
+              log_read(n);
+              fn = std::move(pending_read_);
+              pending_read_ = nullptr;
+              io_service_.post([fn, n]() {
+                  fn(boost::system::error_code(), n);
+                  });
+            }
+            break;
+          case Trace::Type::SENT:
+            // the server waits for the next command
+            break;
+          default:
+            fn = std::move(pending_read_);
+            pending_read_ = nullptr;
+            io_service_.post([fn]() {
+                fn(asio::error::eof, 0);
+                });
+            break;
+        }
+      }
+
+      void Base::consume_written()
+      {
+        while (!written_.empty() && record_.type == Trace::Type::SENT) {
+          if (pos_ == record_.end) {
+            next_record();
+            continue;
+          }
+          size_t n = std::min(written_.size(), size_t(record_.end - pos_));
+          if (opts_.check && !equal(written_.begin(), written_.begin() + n, pos_)) {
+            ostringstream o;
+            o << "Loopback: client sent |";
+            o.write(written_.data(), written_.size());
+            o << "| - but expected |";
+            o.write(pos_, record_.end - pos_);
+            o << "|";
+            THROW_MSG(o.str());
+          }
+          written_.erase(written_.begin(), written_.begin() + n);
+          pos_ += n;
+          if (pos_ == record_.end)
+            next_record();
+        }
+        // a command that is sent ahead is matched after the server
+        // output that precedes it in the script was read
+        if (   written_.empty()
+            || record_.type == Trace::Type::RECEIVED
+            || record_.type == Trace::Type::SENT)
+          return;
+        if (opts_.check) {
+          string s(written_.begin(), written_.end());
+          THROW_MSG("Loopback: unexpected client data after the end of the script |"
+              + s + "|");
+        }
+        written_.clear();
+      }
+
+      void Base::async_resolve(Resolve_Fn fn)
+      {
+        vector<asio::ip::tcp::endpoint> v = {
+          asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 143) };
+#if BOOST_VERSION >= 106600
+        asio::ip::tcp::resolver::iterator iterator =
+          asio::ip::tcp::resolver::results_type::create(v.begin(), v.end(),
+              "loopback", "imap");
+#else
+        auto iterator = asio::ip::tcp::resolver::iterator::create(v.begin(), v.end(),
+            "loopback", "imap");
+#endif
+        io_service_.post([fn, iterator]() {
+            fn(boost::system::error_code(), iterator);
+            });
+      }
+      void Base::async_resolve(const boost::asio::ip::tcp::resolver::query &,
+          Resolve_Fn fn)
+      {
+        async_resolve(fn);
+      }
+      void Base::async_connect(boost::asio::ip::tcp::resolver::iterator,
+          Connect_Fn fn)
+      {
+        open_ = true;
+        io_service_.post([fn]() {
+            fn(boost::system::error_code());
+            });
+      }
+      void Base::async_handshake(Handshake_Fn fn)
+      {
+        io_service_.post([fn]() {
+            fn(boost::system::error_code());
+            });
+      }
+      void Base::async_read_some(Read_Fn fn)
+      {
+        if (pending_read_)
+          THROW_LOGIC_MSG("Loopback: read already in progress");
+        pending_read_ = std::move(fn);
+        serve_read();
+      }
+      void Base::async_write(const char *c, size_t size, Write_Fn fn)
+      {
+        written_.insert(written_.end(), c, c + size);
+        consume_written();
+        io_service_.post([fn, size]() {
+            fn(boost::system::error_code(), size);
+            });
+        if (pending_read_)
+          serve_read();
+      }
+      void Base::async_write(const std::vector<char> &v, Write_Fn fn)
+      {
+        async_write(v.data(), v.size(), fn);
+      }
+      void Base::async_shutdown(Shutdown_Fn fn)
+      {
+        log_shutdown();
+        io_service_.post([fn]() {
+            fn(boost::system::error_code());
+            });
+      }
+      void Base::cancel()
+      {
+        if (!pending_read_)
+          return;
+        Read_Fn fn(std::move(pending_read_));
+        pending_read_ = nullptr;
+        io_service_.post([fn]() {
+            fn(asio::error::operation_aborted, 0);
+            });
+      }
+      void Base::close()
+      {
+        open_ = false;
+      }
+      bool Base::is_open() const
+      {
+        return open_;
+      }
+      bool Base::finished() const
+      {
+        return    record_.type == Trace::Type::DISCONNECT
+               || record_.type == Trace::Type::END_OF_FILE;
+      }
+
+    }
+
+  }
+
+}
@@ -0,0 +1,94 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef NET_LOOPBACK_CLIENT_H
+#define NET_LOOPBACK_CLIENT_H
+
+#include <net/client.h>
+#include <trace/trace.h>
+
+#include <string>
+#include <vector>
+
+namespace Net {
+
+  // In-process transport without sockets: the server side is scripted
+  // by a trace file (e.g. a recorded session or a generated one), i.e.
+  // RECEIVED records are served from memory, as fast as the client reads
+  // them, and the client writes are matched against the SENT records.
+  // Everything completes via io_service::post(), thus no threads are
+  // involved and runs are deterministic.
+  namespace Loopback {
+
+    namespace Client {
+
+      class Options : public Net::Client::Options {
+        public:
+          std::string script;
+          // fail on writes that differ from the SENT records - otherwise
+          // they are only matched by length
+          bool        check {true};
+      };
+
+      class Base : public Net::Client::Base {
+        private:
+          const Options      &opts_;
+          Trace::Reader       reader_;
+          Trace::Record_View  record_;
+          const char         *pos_          {nullptr};
+          std::vector<char>   written_;
+          Read_Fn             pending_read_;
+          bool                open_         {false};
+
+          void next_record();
+          void serve_read();
+          void consume_written();
+        public:
+          void async_resolve(Resolve_Fn fn) override;
+
+          void async_resolve(const boost::asio::ip::tcp::resolver::query &query,
+              Resolve_Fn fn) override;
+          void async_connect(boost::asio::ip::tcp::resolver::iterator iterator,
+              Connect_Fn fn) override;
+          void async_handshake(Handshake_Fn fn) override;
+          void async_read_some(Read_Fn fn) override;
+          void async_write(const char *c, size_t size, Write_Fn fn) override;
+          void async_write(const std::vector<char> &v, Write_Fn fn) override;
+          void async_shutdown(Shutdown_Fn fn) override;
+
+          void cancel() override;
+          void close() override;
+          bool is_open() const override;
+
+          // true if the script was played until its end
+          bool finished() const;
+
+        public:
+          Base(boost::asio::io_service &io_service, const Options &opts,
+              boost::log::sources::severity_logger<Log::Severity> &lg
+              );
+      };
+
+    }
+
+  }
+}
+
+#endif
@@ -0,0 +1,259 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "pipeline.h"
+
+#include <exception.h>
+
+#include <exception>
+#include <utility>
+
+using namespace std;
+
+namespace Net {
+
+  namespace Client {
+
+    // the wrapped client does the tracing
+    static const Options no_trace_opts;
+
+    Pipeline::Pipeline(boost::asio::io_service &io_service,
+        boost::asio::io_service &net_io_service,
+        Base &inner, size_t depth,
+        boost::log::sources::severity_logger<Log::Severity> &lg)
+      :
+        Base(io_service, no_trace_opts, lg),
+        net_(net_io_service),
+        inner_(inner),
+        depth_(depth ? depth : 1),
+        net_work_(new boost::asio::io_service::work(net_)),
+        thread_([this]() { run_net(); })
+    {
+    }
+    Pipeline::~Pipeline()
+    {
+      net_work_.reset();
+      net_.stop();
+      thread_.join();
+    }
+
+    void Pipeline::run_net()
+    {
+      for (;;) {
+        try {
+          net_.run();
+          return;
+        } catch (...) {
+          // rethrown on the caller's side
+          auto e = current_exception();
+          io_service_.post([e]() { rethrow_exception(e); });
+        }
+      }
+    }
+
+    // caller side: keep its io_service running while something is
+    // in flight on the net thread
+    void Pipeline::hold()
+    {
+      if (!pending_++)
+        work_.reset(new boost::asio::io_service::work(io_service_));
+    }
+    void Pipeline::release()
+    {
+      if (!--pending_)
+        work_.reset();
+    }
+
+    Base::Resolve_Fn Pipeline::to_caller(Resolve_Fn fn)
+    {
+      hold();
+      return [this, fn](const boost::system::error_code &ec,
+          boost::asio::ip::tcp::resolver::iterator iterator)
+        {
+          io_service_.post([this, fn, ec, iterator]() {
+              release();
+              fn(ec, iterator);
+              });
+        };
+    }
+    Base::Connect_Fn Pipeline::to_caller(Connect_Fn fn)
+    {
+      hold();
+      return [this, fn](const boost::system::error_code &ec)
+        {
+          open_ = inner_.is_open();
+          io_service_.post([this, fn, ec]() {
+              release();
+              fn(ec);
+              });
+        };
+    }
+    Base::Read_Fn Pipeline::to_caller(Read_Fn fn)
+    {
+      hold();
+      return [this, fn](const boost::system::error_code &ec, size_t size)
+        {
+          io_service_.post([this, fn, ec, size]() {
+              release();
+              fn(ec, size);
+              });
+        };
+    }
+
+    void Pipeline::async_resolve(Resolve_Fn fn)
+    {
+      auto f = to_caller(fn);
+      net_.post([this, f]() { inner_.async_resolve(f); });
+    }
+    void Pipeline::async_resolve(const boost::asio::ip::tcp::resolver::query &query,
+        Resolve_Fn fn)
+    {
+      auto f = to_caller(fn);
+      net_.post([this, query, f]() { inner_.async_resolve(query, f); });
+    }
+    void Pipeline::async_connect(boost::asio::ip::tcp::resolver::iterator iterator,
+        Connect_Fn fn)
+    {
+      auto f = to_caller(fn);
+      net_.post([this, iterator, f]() { inner_.async_connect(iterator, f); });
+    }
+    void Pipeline::async_handshake(Handshake_Fn fn)
+    {
+      auto f = to_caller(fn);
+      net_.post([this, f]() { inner_.async_handshake(f); });
+    }
+
+    // net side: read ahead until the queue is full
+    void Pipeline::do_read()
+    {
+      inner_.async_read_some([this](const boost::system::error_code &ec,
+            size_t size)
+          {
+            bool more = false;
+            {
+              lock_guard<mutex> lock(mutex_);
+              Chunk c;
+              if (!free_.empty()) {
+                c.buffer = std::move(free_.back());
+                free_.pop_back();
+              }
+              c.buffer.resize(inner_.input().size());
+              swap(c.buffer, inner_.input());
+              c.ec   = ec;
+              c.size = size;
+              queue_.push_back(std::move(c));
+              if (!ec) {
+                more = queue_.size() < depth_;
+                stalled_ = !more;
+              }
+            }
+            io_service_.post([this]() { deliver(); });
+            if (more)
+              do_read();
+          });
+    }
+    // caller side
+    void Pipeline::deliver()
+    {
+      if (!read_fn_)
+        return;
+      Chunk c;
+      bool resume = false;
+      {
+        lock_guard<mutex> lock(mutex_);
+        if (queue_.empty())
+          return;
+        c = std::move(queue_.front());
+        queue_.pop_front();
+        swap(c.buffer, input_);
+        free_.push_back(std::move(c.buffer));
+        resume = stalled_;
+        stalled_ = false;
+      }
+      // reading stopped at the error - a new read restarts it
+      if (c.ec)
+        started_ = false;
+      if (resume)
+        net_.post([this]() { do_read(); });
+      bytes_read_ += c.size;
+      Read_Fn fn;
+      swap(fn, read_fn_);
+      release();
+      fn(c.ec, c.size);
+    }
+    void Pipeline::async_read_some(Read_Fn fn)
+    {
+      if (read_fn_)
+        THROW_LOGIC_MSG("read already in progress");
+      hold();
+      read_fn_ = fn;
+      if (!started_) {
+        started_ = true;
+        net_.post([this]() { do_read(); });
+      }
+      io_service_.post([this]() { deliver(); });
+    }
+
+    void Pipeline::async_write(const char *c, size_t size, Write_Fn fn)
+    {
+      auto f = to_caller(fn);
+      net_.post([this, c, size, f]() { inner_.async_write(c, size, f); });
+    }
+    void Pipeline::async_write(const std::vector<char> &v, Write_Fn fn)
+    {
+      auto f = to_caller(fn);
+      const std::vector<char> *p = &v;
+      net_.post([this, p, f]() {
+          inner_.log_write(*p);
+          inner_.async_write(*p, f);
+          });
+    }
+    void Pipeline::async_shutdown(Shutdown_Fn fn)
+    {
+      auto f = to_caller(fn);
+      net_.post([this, f]() { inner_.async_shutdown(f); });
+    }
+
+    void Pipeline::cancel()
+    {
+      net_.post([this]() { inner_.cancel(); });
+    }
+    void Pipeline::close()
+    {
+      open_ = false;
+      net_.post([this]() { inner_.close(); });
+    }
+    bool Pipeline::is_open() const
+    {
+      return open_;
+    }
+
+    void Pipeline::set_quick_ack(bool b)
+    {
+      net_.post([this, b]() { inner_.set_quick_ack(b); });
+    }
+    void Pipeline::mark(const char *label)
+    {
+      // labels are string literals
+      net_.post([this, label]() { inner_.mark(label); });
+    }
+
+  }
+}
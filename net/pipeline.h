@@ -0,0 +1,117 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef NET_PIPELINE_H
+#define NET_PIPELINE_H
+
+#include <net/client.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stddef.h>
+
+#include <boost/asio/io_service.hpp>
+
+namespace Net {
+
+  namespace Client {
+
+    // Runs another client (e.g. the SSL one) on a separate thread, i.e.
+    // reading and TLS decryption overlap the parsing and disk IO that
+    // happen on the io_service of the caller.
+    //
+    // The wrapped client has to use the net io_service. Received buffers
+    // are queued in order - at most depth of them, then reading pauses
+    // until the caller catches up. Buffers are recycled.
+    // All completion handlers are called on the caller's io_service.
+    class Pipeline : public Base {
+      private:
+        struct Chunk {
+          std::vector<char>         buffer;
+          boost::system::error_code ec;
+          size_t                    size {0};
+        };
+
+        boost::asio::io_service                         &net_;
+        Base                                            &inner_;
+        const size_t                                     depth_;
+
+        // guarded by mutex_
+        std::mutex                                       mutex_;
+        std::deque<Chunk>                                queue_;
+        std::vector<std::vector<char> >                  free_;
+        bool                                             stalled_ {false};
+
+        std::atomic<bool>                                open_    {false};
+
+        // caller side
+        Read_Fn                                          read_fn_;
+        bool                                             started_ {false};
+        unsigned                                         pending_ {0};
+        std::unique_ptr<boost::asio::io_service::work>   work_;
+
+        std::unique_ptr<boost::asio::io_service::work>   net_work_;
+        std::thread                                      thread_;
+
+        void run_net();
+        void do_read();
+        void deliver();
+
+        void hold();
+        void release();
+        Resolve_Fn  to_caller(Resolve_Fn fn);
+        Connect_Fn  to_caller(Connect_Fn fn);
+        Read_Fn     to_caller(Read_Fn fn);
+
+      public:
+        Pipeline(boost::asio::io_service &io_service,
+            boost::asio::io_service &net_io_service,
+            Base &inner, size_t depth,
+            boost::log::sources::severity_logger<Log::Severity> &lg);
+        ~Pipeline();
+
+        void async_resolve(Resolve_Fn fn) override;
+
+        void async_resolve(const boost::asio::ip::tcp::resolver::query &query,
+            Resolve_Fn fn) override;
+        void async_connect(boost::asio::ip::tcp::resolver::iterator iterator,
+            Connect_Fn fn) override;
+        void async_handshake(Handshake_Fn fn) override;
+        void async_read_some(Read_Fn fn) override;
+        void async_write(const char *c, size_t size, Write_Fn fn) override;
+        void async_write(const std::vector<char> &v, Write_Fn fn) override;
+        void async_shutdown(Shutdown_Fn fn) override;
+
+        void cancel() override;
+        void close() override;
+        bool is_open() const override;
+
+        void set_quick_ack(bool b) override;
+        void mark(const char *label) override;
+    };
+
+  }
+}
+
+#endif
@@ -0,0 +1,159 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "resolve_cache.h"
+
+#include <exception.h>
+
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdint.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <boost/version.hpp>
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+
+using namespace std;
+namespace asio = boost::asio;
+
+namespace Net {
+
+  // the read-modify-write in rewrite() must not interleave with other
+  // accounts of the same process
+  static mutex cache_mutex;
+
+  Resolve_Cache::Resolve_Cache(const std::string &filename,
+      std::chrono::seconds ttl,
+      const std::string &host, const std::string &service)
+    :
+      filename_(filename),
+      ttl_(ttl),
+      host_(host),
+      service_(service)
+  {
+  }
+
+  static int64_t now()
+  {
+    return chrono::duration_cast<chrono::seconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+  }
+
+  boost::asio::ip::tcp::resolver::iterator Resolve_Cache::lookup() const
+  {
+    lock_guard<mutex> lock(cache_mutex);
+    vector<asio::ip::tcp::endpoint> v;
+    ifstream f(filename_, ifstream::in | ifstream::binary);
+    string line;
+    int64_t t = now();
+    while (getline(f, line)) {
+      istringstream i(line);
+      string host, service, address;
+      int64_t expires {0};
+      unsigned short port {0};
+      if (!(i >> host >> service >> expires >> address >> port))
+        continue;
+      if (host != host_ || service != service_ || expires <= t)
+        continue;
+      boost::system::error_code ec;
+      auto a = asio::ip::address::from_string(address, ec);
+      if (ec)
+        continue;
+      v.emplace_back(a, port);
+    }
+    if (v.empty())
+      return asio::ip::tcp::resolver::iterator();
+#if BOOST_VERSION >= 106600
+    return asio::ip::tcp::resolver::results_type::create(v.begin(), v.end(),
+        host_, service_);
+#else
+    return asio::ip::tcp::resolver::iterator::create(v.begin(), v.end(),
+        host_, service_);
+#endif
+  }
+
+  void Resolve_Cache::store(boost::asio::ip::tcp::resolver::iterator iterator) const
+  {
+    vector<asio::ip::tcp::endpoint> v;
+    for (; iterator != asio::ip::tcp::resolver::iterator(); ++iterator)
+      v.push_back(iterator->endpoint());
+    rewrite(v);
+  }
+
+  void Resolve_Cache::invalidate() const
+  {
+    rewrite(vector<asio::ip::tcp::endpoint>());
+  }
+
+  void Resolve_Cache::rewrite(
+      const std::vector<boost::asio::ip::tcp::endpoint> &v) const
+  {
+    lock_guard<mutex> lock(cache_mutex);
+    int64_t t = now();
+    ostringstream o;
+    {
+      // keep the unexpired entries of other host/service pairs
+      ifstream f(filename_, ifstream::in | ifstream::binary);
+      string line;
+      while (getline(f, line)) {
+        istringstream i(line);
+        string host, service;
+        int64_t expires {0};
+        if (!(i >> host >> service >> expires))
+          continue;
+        if ((host == host_ && service == service_) || expires <= t)
+          continue;
+        o << line << '\n';
+      }
+    }
+    int64_t expires = t + ttl_.count();
+    for (auto &e : v)
+      o << host_ << ' ' << service_ << ' ' << expires << ' '
+        << e.address().to_string() << ' ' << e.port() << '\n';
+
+    // unique, thus another imapdl process doesn't write to it, as well
+    vector<char> tmp(filename_.begin(), filename_.end());
+    const char suffix[] = ".XXXXXX";
+    tmp.insert(tmp.end(), suffix, suffix + sizeof suffix);
+    int fd = mkstemp(tmp.data());
+    if (fd == -1) {
+      boost::system::error_code ec(errno, boost::system::system_category());
+      THROW_ERROR(ec);
+    }
+    ::close(fd);
+    try {
+      {
+        ofstream f;
+        f.exceptions(ofstream::failbit | ofstream::badbit);
+        f.open(tmp.data(), ofstream::out | ofstream::binary | ofstream::trunc);
+        f << o.str();
+      }
+      fs::rename(tmp.data(), filename_);
+    } catch (...) {
+      fs::remove(tmp.data());
+      throw;
+    }
+  }
+
+}
@@ -0,0 +1,64 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef NET_RESOLVE_CACHE_H
+#define NET_RESOLVE_CACHE_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <boost/asio/ip/tcp.hpp>
+
+namespace Net {
+
+  // On-disk cache of resolved addresses, such that a slow resolver
+  // doesn't delay the connect on repeated runs.
+  //
+  // One text file may contain entries of several host/service pairs,
+  // one endpoint per line:
+  //
+  //     HOST SERVICE EXPIRES ADDRESS PORT
+  //
+  // where EXPIRES is in seconds since the epoch. The file is replaced
+  // atomically on store() - via a uniquely named temporary file. Within
+  // one process, all accesses are serialized, thus concurrently running
+  // accounts may share the file.
+  class Resolve_Cache {
+    private:
+      std::string          filename_;
+      std::chrono::seconds ttl_;
+      std::string          host_;
+      std::string          service_;
+
+      void rewrite(const std::vector<boost::asio::ip::tcp::endpoint> &v) const;
+    public:
+      Resolve_Cache(const std::string &filename, std::chrono::seconds ttl,
+          const std::string &host, const std::string &service);
+
+      // returns the end iterator if there is no unexpired entry
+      boost::asio::ip::tcp::resolver::iterator lookup() const;
+      void store(boost::asio::ip::tcp::resolver::iterator iterator) const;
+      void invalidate() const;
+  };
+
+}
+
+#endif
@@ -0,0 +1,183 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "splicer.h"
+
+#include <algorithm>
+
+#include <boost/version.hpp>
+#include <boost/asio/error.hpp>
+
+#ifdef __linux__
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <errno.h>
+#endif
+
+using namespace std;
+namespace asio = boost::asio;
+
+namespace Net {
+
+  namespace TCP {
+
+    // upper bound for the work done in one async_splice() call,
+    // in pipe fills
+    static const size_t max_fills = 16;
+
+    Splicer::Splicer(boost::asio::io_service &io_service,
+        boost::asio::ip::tcp::socket &socket)
+      :
+        io_service_(io_service),
+        socket_(socket)
+    {
+    }
+    Splicer::~Splicer()
+    {
+      close_pipe();
+    }
+
+    void Splicer::complete(Splice_Fn fn, const boost::system::error_code &ec,
+        size_t size)
+    {
+      io_service_.post([fn, ec, size]() { fn(ec, size); });
+    }
+
+#ifdef __linux__
+
+    void Splicer::open_pipe(boost::system::error_code &ec)
+    {
+      if (pipe2(pipe_, O_CLOEXEC | O_NONBLOCK) == -1) {
+        ec = boost::system::error_code(errno, boost::system::system_category());
+        return;
+      }
+      // the default capacity is 64 KiB, unprivileged processes may
+      // increase it up to /proc/sys/fs/pipe-max-size (default: 1 MiB)
+      int r = fcntl(pipe_[1], F_SETPIPE_SZ, 1024 * 1024);
+      if (r == -1)
+        r = fcntl(pipe_[1], F_GETPIPE_SZ);
+      pipe_size_ = r > 0 ? size_t(r) : size_t(64 * 1024);
+    }
+    void Splicer::close_pipe()
+    {
+      for (auto &fd : pipe_) {
+        if (fd != -1)
+          ::close(fd);
+        fd = -1;
+      }
+    }
+    size_t Splicer::drain(int fd, size_t size, boost::system::error_code &ec)
+    {
+      size_t done = 0;
+      while (done < size) {
+        ssize_t r = splice(pipe_[0], nullptr, fd, nullptr, size - done,
+            SPLICE_F_MOVE);
+        if (r == -1) {
+          if (errno == EINTR)
+            continue;
+          // the rest stays in the pipe, for the next call
+          ec = boost::system::error_code(errno, boost::system::system_category());
+          break;
+        }
+        done += size_t(r);
+      }
+      pending_ -= done;
+      return done;
+    }
+
+    void Splicer::async_splice(int fd, size_t size, Splice_Fn fn)
+    {
+      boost::system::error_code ec;
+      if (pipe_[0] == -1)
+        open_pipe(ec);
+      if (!ec)
+        socket_.native_non_blocking(true, ec);
+      if (ec) {
+        complete(fn, ec, 0);
+        return;
+      }
+      size = min(size, max_fills * pipe_size_);
+      size_t done = 0;
+      if (pending_)
+        done = drain(fd, min(pending_, size), ec);
+      while (!ec && done < size) {
+        ssize_t r = splice(socket_.native_handle(), nullptr, pipe_[1], nullptr,
+            min(size - done, pipe_size_), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (r == -1) {
+          if (errno == EINTR)
+            continue;
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            break;
+          if (errno == EINVAL || errno == ENOSYS)
+            ec = asio::error::operation_not_supported;
+          else
+            ec = boost::system::error_code(errno,
+                boost::system::system_category());
+          break;
+        }
+        if (!r) {
+          ec = asio::error::eof;
+          break;
+        }
+        pending_ += size_t(r);
+        done += drain(fd, size_t(r), ec);
+      }
+      if (done || ec) {
+        complete(fn, ec, done);
+        return;
+      }
+#if BOOST_VERSION >= 106600
+      socket_.async_wait(asio::ip::tcp::socket::wait_read,
+          [this, fd, size, fn](const boost::system::error_code &ec)
+#else
+      socket_.async_read_some(asio::null_buffers(),
+          [this, fd, size, fn](const boost::system::error_code &ec, size_t)
+#endif
+          {
+            if (ec)
+              fn(ec, 0);
+            else
+              async_splice(fd, size, fn);
+          });
+    }
+
+#else
+
+    void Splicer::open_pipe(boost::system::error_code &ec)
+    {
+      ec = asio::error::operation_not_supported;
+    }
+    void Splicer::close_pipe()
+    {
+    }
+    size_t Splicer::drain(int, size_t, boost::system::error_code &ec)
+    {
+      ec = asio::error::operation_not_supported;
+      return 0;
+    }
+    void Splicer::async_splice(int, size_t, Splice_Fn fn)
+    {
+      complete(fn, asio::error::operation_not_supported, 0);
+    }
+
+#endif
+
+  }
+}
@@ -0,0 +1,78 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef NET_SPLICER_H
+#define NET_SPLICER_H
+
+#include <functional>
+#include <stddef.h>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/io_service.hpp>
+
+namespace Net {
+
+  namespace TCP {
+
+    // Moves bytes from a TCP socket into a file descriptor via splice(2)
+    // through a pipe, i.e. without copying them to user space (Linux).
+    //
+    // Completes with operation_not_supported where this isn't available.
+    //
+    // Bytes that were already taken off the socket but couldn't be written
+    // to the file descriptor (e.g. ENOSPC) stay in the pipe and are written
+    // first by the next call.
+    class Splicer {
+      public:
+        using Splice_Fn = std::function<void(
+            const boost::system::error_code &ec,
+            size_t length
+            )>;
+      private:
+        boost::asio::io_service      &io_service_;
+        boost::asio::ip::tcp::socket &socket_;
+        int                           pipe_[2]   = { -1, -1 };
+        size_t                        pipe_size_ {0};
+        // bytes in the pipe, i.e. read from the socket but not written
+        size_t                        pending_   {0};
+
+        void open_pipe(boost::system::error_code &ec);
+        void close_pipe();
+        // returns the number of bytes written to fd
+        size_t drain(int fd, size_t size, boost::system::error_code &ec);
+        void complete(Splice_Fn fn, const boost::system::error_code &ec,
+            size_t size);
+      public:
+        Splicer(boost::asio::io_service &io_service,
+            boost::asio::ip::tcp::socket &socket);
+        ~Splicer();
+        Splicer(const Splicer &) =delete;
+        Splicer &operator=(const Splicer &) =delete;
+
+        // like async_read_some(): moves at least one and at most size
+        // bytes, waits for the socket to become readable if necessary -
+        // on error, length is the number of bytes that were moved before it
+        void async_splice(int fd, size_t size, Splice_Fn fn);
+    };
+
+  }
+}
+
+#endif
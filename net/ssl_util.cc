@@ -92,6 +92,24 @@ namespace Net {
       }
     }
 
+    Session::Session()
+    {
+    }
+    Session::~Session()
+    {
+      reset(nullptr);
+    }
+    ssl_session_st *Session::get() const
+    {
+      return session_;
+    }
+    void Session::reset(ssl_session_st *s)
+    {
+      if (session_)
+        SSL_SESSION_free(session_);
+      session_ = s;
+    }
+
 
 
   }
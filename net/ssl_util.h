@@ -24,6 +24,7 @@
 #include <ostream>
 
 namespace boost { namespace asio { namespace ssl { class context; } } }
+struct ssl_session_st;
 
 namespace Net {
 
@@ -48,6 +49,22 @@ namespace Net {
     namespace Context {
       void set_defaults(boost::asio::ssl::context &context);
     }
+
+    // The TLS session of the last connection, thus the next connection
+    // to the same server can resume it, i.e. skip the full handshake.
+    class Session {
+      private:
+        ssl_session_st *session_ {nullptr};
+      public:
+        Session();
+        ~Session();
+        Session(const Session &) = delete;
+        Session &operator=(const Session &) = delete;
+
+        ssl_session_st *get() const;
+        // takes ownership
+        void reset(ssl_session_st *s);
+    };
   }
 }
 
@@ -80,7 +80,7 @@ namespace Net {
           if (result_) {
             BOOST_LOG(lg_) << "Fingerprint matches. Authentication finished.";
           } else
-            BOOST_LOG_SEV(lg_, Log::FATAL)
+            IMAPDL_LOG_SEV(lg_, Log::FATAL)
               << "Given fingerprint " << fingerprint_ << " does not"
               " match the one of the certificate: " << fp.str();
         }
@@ -91,7 +91,7 @@ namespace Net {
 
       if (!r) {
         int rc = X509_STORE_CTX_get_error(ctx.native_handle());
-        BOOST_LOG_SEV(lg_, Log::FATAL) << "Certificate verification failed: "
+        IMAPDL_LOG_SEV(lg_, Log::FATAL) << "Certificate verification failed: "
           << X509_verify_cert_error_string(rc) << " (return code: " << rc << ")";
       }
 
@@ -20,6 +20,7 @@
 }}} */
 #include "tcp_client.h"
 
+#include "tcp_option.h"
 #include "ssl_util.h"
 #include "ssl_verification.h"
 #include "exception.h"
@@ -44,7 +45,9 @@ namespace Net {
           Net::Client::Base(io_service, opts, lg),
           opts_(opts),
           socket_(io_service),
-          resolver_(io_service)
+          resolver_(io_service),
+          connector_(io_service, opts, lg),
+          splicer_(io_service, socket_)
       {
       }
 
@@ -61,19 +64,7 @@ namespace Net {
       void Base::async_connect(boost::asio::ip::tcp::resolver::iterator iterator,
           Connect_Fn fn)
       {
-        if (!opts_.local_address.empty()) {
-          if (opts_.ip == 4)
-            socket_.open(asio::ip::tcp::v4());
-          else
-            socket_.open(asio::ip::tcp::v6());
-
-          asio::ip::tcp::endpoint local_endpoint(
-              asio::ip::address::from_string(opts_.local_address),
-              opts_.local_port
-              );
-          socket_.bind(local_endpoint);
-        }
-        socket_.async_connect(iterator->endpoint(), fn);
+        connector_.async_connect(iterator, socket_, fn);
       }
       void Base::async_handshake(Handshake_Fn fn)
       {
@@ -86,8 +77,11 @@ namespace Net {
             const boost::system::error_code &ec,
             size_t size)
           {
-            if (!ec)
+            if (!ec) {
               log_read(size);
+              if (quick_ack_)
+                Net::TCP::Option::quick_ack(socket_);
+            }
             fn(ec, size);
           });
       }
@@ -107,6 +101,8 @@ namespace Net {
       }
       void Base::cancel()
       {
+        resolver_.cancel();
+        connector_.cancel();
         socket_.cancel();
       }
       void Base::close()
@@ -117,6 +113,31 @@ namespace Net {
       {
         return socket_.is_open();
       }
+      void Base::set_quick_ack(bool b)
+      {
+        quick_ack_ = b && opts_.quick_ack;
+      }
+      void Base::async_splice(int fd, size_t size, Splice_Fn fn)
+      {
+        // spliced bytes would be missing from the trace
+        if (!opts_.tracefile.empty()) {
+          Net::Client::Base::async_splice(fd, size, fn);
+          return;
+        }
+        splicer_.async_splice(fd, size, [this, fn](
+            const boost::system::error_code &ec,
+            size_t size)
+          {
+            bytes_read_ += size;
+            // the bytes themselves never were in user space, but the
+            // dump must keep the framing, thus it stays replayable
+            if (flight_recorder_ && size)
+              flight_recorder_->push(Trace::Type::RECEIVED, size, 'X');
+            if (!ec && quick_ack_)
+              Net::TCP::Option::quick_ack(socket_);
+            fn(ec, size);
+          });
+      }
 
     }
 
@@ -141,14 +162,16 @@ namespace Net {
 
         Base::Base(boost::asio::io_service &io_service,
             boost::asio::ssl::context &context, const Options &opts,
-          boost::log::sources::severity_logger<Log::Severity> &lg
+          boost::log::sources::severity_logger<Log::Severity> &lg,
+            bool apply_context
             )
           :
             Net::Client::Base(io_service, opts, lg),
             opts_(opts),
-            context_(opts_.apply(context)),
+            context_(apply_context ? opts_.apply(context) : context),
             stream_(io_service, context_),
-            resolver_(io_service)
+            resolver_(io_service),
+            connector_(io_service, opts, lg)
         {
           using namespace Net::SSL;
           stream_.set_verify_mode(asio::ssl::verify_peer);
@@ -171,24 +194,24 @@ namespace Net {
         void Base::async_connect(boost::asio::ip::tcp::resolver::iterator iterator,
             Connect_Fn fn)
         {
-          if (!opts_.local_address.empty()) {
-            if (opts_.ip == 4)
-              stream_.lowest_layer().open(asio::ip::tcp::v4());
-            else
-              stream_.lowest_layer().open(asio::ip::tcp::v6());
-
-            asio::ip::tcp::endpoint local_endpoint(
-                asio::ip::address::from_string(opts_.local_address),
-                opts_.local_port
-                );
-            stream_.lowest_layer().bind(local_endpoint);
-          }
-          stream_.lowest_layer().async_connect(iterator->endpoint(), fn);
+          connector_.async_connect(iterator, stream_.next_layer(), fn);
         }
         void Base::async_handshake(Handshake_Fn fn)
         {
-          BOOST_LOG_SEV(lg_, Log::DEBUG) << "Handshaking - Cipher list: " << opts_.cipher;
-          stream_.async_handshake(asio::ssl::stream_base::client, fn);
+          IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "Handshaking - Cipher list: " << opts_.cipher;
+          if (!session_ || !session_->get()) {
+            stream_.async_handshake(asio::ssl::stream_base::client, fn);
+            return;
+          }
+          SSL_set_session(stream_.native_handle(), session_->get());
+          stream_.async_handshake(asio::ssl::stream_base::client,
+              [this, fn](const boost::system::error_code &ec)
+              {
+                if (!ec)
+                  IMAPDL_LOG_SEV(lg_, Log::DEBUG) << "TLS session resumed: "
+                    << (SSL_session_reused(stream_.native_handle()) ? "yes" : "no");
+                fn(ec);
+              });
         }
         void Base::async_read_some(Read_Fn fn)
         {
@@ -196,8 +219,11 @@ namespace Net {
             const boost::system::error_code &ec,
             size_t size)
           {
-            if (!ec)
+            if (!ec) {
               log_read(size);
+              if (quick_ack_)
+                Net::TCP::Option::quick_ack(stream_.next_layer());
+            }
             fn(ec, size);
           });
         }
@@ -212,20 +238,32 @@ namespace Net {
         void Base::async_shutdown(Shutdown_Fn fn)
         {
           log_shutdown();
+          if (session_)
+            session_->reset(SSL_get1_session(stream_.native_handle()));
           stream_.async_shutdown(fn);
         }
         void Base::cancel()
         {
+          resolver_.cancel();
+          connector_.cancel();
           stream_.lowest_layer().cancel();
         }
         void Base::close()
         {
           stream_.lowest_layer().close();
         }
+        void Base::set_session(Net::SSL::Session *session)
+        {
+          session_ = session;
+        }
         bool Base::is_open() const
         {
           return stream_.lowest_layer().is_open();
         }
+        void Base::set_quick_ack(bool b)
+        {
+          quick_ack_ = b && opts_.quick_ack;
+        }
 
       }
     }
@@ -22,6 +22,9 @@
 #define NET_TCP_CLIENT_H
 
 #include <net/client.h>
+#include <net/connector.h>
+#include <net/splicer.h>
+#include <net/ssl_util.h>
 
 #include <log/log.h>
 
@@ -47,6 +50,16 @@ namespace Net {
           std::string    service; // or port
 
           unsigned       ip            {4};
+          // delay between two connection attempts to different
+          // endpoints (cf. RFC 8305) - 0 means one at a time
+          unsigned       connect_delay {250};
+
+          // opt-in socket tuning - 0 means system default
+          bool           fast_open     {false};
+          bool           no_delay      {false};
+          bool           quick_ack     {false};
+          unsigned       rcvbuf        {0};
+          unsigned       sndbuf        {0};
 
       };
 
@@ -55,6 +68,9 @@ namespace Net {
           const Options                 &opts_;
           boost::asio::ip::tcp::socket   socket_;
           boost::asio::ip::tcp::resolver resolver_;
+          Net::TCP::Connector            connector_;
+          Net::TCP::Splicer              splicer_;
+          bool                           quick_ack_ {false};
 
         public:
           void async_resolve(Resolve_Fn fn) override;
@@ -73,6 +89,9 @@ namespace Net {
           void close() override;
           bool is_open() const override;
 
+          void set_quick_ack(bool b) override;
+          void async_splice(int fd, size_t size, Splice_Fn fn) override;
+
         public:
           Base(boost::asio::io_service &io_service, const Options &opts,
           boost::log::sources::severity_logger<Log::Severity> &lg
@@ -104,6 +123,9 @@ namespace Net {
             boost::asio::ssl::context &context_;
             boost::asio::ssl::stream<boost::asio::ip::tcp::socket> stream_;
             boost::asio::ip::tcp::resolver resolver_;
+            Net::TCP::Connector            connector_;
+            bool                           quick_ack_ {false};
+            Net::SSL::Session             *session_   {nullptr};
 
         public:
             void async_resolve(Resolve_Fn fn) override;
@@ -121,10 +143,18 @@ namespace Net {
             void cancel() override;
             void close() override;
             bool is_open() const override;
+
+            void set_quick_ack(bool b) override;
+            // resume the session stored there and store the session
+            // there on shutdown - nullptr means a full handshake
+            void set_session(Net::SSL::Session *session);
           public:
+            // apply_context=false: the context is shared between clients
+            // and was already set up with Options::apply()
             Base(boost::asio::io_service &io_service,
                 boost::asio::ssl::context &context, const Options &opts,
-          boost::log::sources::severity_logger<Log::Severity> &lg
+          boost::log::sources::severity_logger<Log::Severity> &lg,
+                bool apply_context = true
                 );
         };
 
@@ -0,0 +1,103 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "tcp_option.h"
+
+#include "tcp_client.h"
+
+#include <boost/log/sources/record_ostream.hpp>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace asio = boost::asio;
+
+namespace Net {
+
+  namespace TCP {
+
+    namespace Option {
+
+      static bool set_int(boost::asio::ip::tcp::socket &socket,
+          int level, int name, int value)
+      {
+        return !::setsockopt(socket.native_handle(), level, name,
+            &value, sizeof value);
+      }
+
+      void apply(boost::asio::ip::tcp::socket &socket,
+          const Client::Options &opts,
+          boost::log::sources::severity_logger<Log::Severity> &lg)
+      {
+        boost::system::error_code ec;
+        if (opts.no_delay) {
+          socket.set_option(asio::ip::tcp::no_delay(true), ec);
+          if (ec)
+            IMAPDL_LOG_SEV(lg, Log::WARN) << "Setting TCP_NODELAY failed: "
+              << ec.message();
+        }
+        // has to be set before connect() to influence the window scaling
+        if (opts.rcvbuf) {
+          socket.set_option(asio::socket_base::receive_buffer_size(opts.rcvbuf), ec);
+          if (ec)
+            IMAPDL_LOG_SEV(lg, Log::WARN) << "Setting SO_RCVBUF failed: "
+              << ec.message();
+        }
+        if (opts.sndbuf) {
+          socket.set_option(asio::socket_base::send_buffer_size(opts.sndbuf), ec);
+          if (ec)
+            IMAPDL_LOG_SEV(lg, Log::WARN) << "Setting SO_SNDBUF failed: "
+              << ec.message();
+        }
+        if (opts.fast_open) {
+          // without a cached cookie, connect() sends a plain SYN; with
+          // one, connect() returns immediately and the SYN is deferred
+          // until the first write - thus, this only works when the client
+          // speaks first, i.e. with TLS (the ClientHello), and not with
+          // plain IMAP, where the server greets first (cf.
+          // Copy::Options::verify())
+#if defined(TCP_FASTOPEN_CONNECT)
+          if (!set_int(socket, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1))
+            IMAPDL_LOG_SEV(lg, Log::WARN) << "Setting TCP_FASTOPEN_CONNECT failed";
+#else
+          IMAPDL_LOG_SEV(lg, Log::WARN) << "TCP Fast Open isn't supported on this platform";
+#endif
+        }
+        if (opts.quick_ack) {
+#if !defined(TCP_QUICKACK)
+          IMAPDL_LOG_SEV(lg, Log::WARN) << "TCP_QUICKACK isn't supported on this platform";
+#endif
+        }
+      }
+
+      void quick_ack(boost::asio::ip::tcp::socket &socket)
+      {
+#if defined(TCP_QUICKACK)
+        set_int(socket, IPPROTO_TCP, TCP_QUICKACK, 1);
+#else
+        (void)socket;
+#endif
+      }
+
+    }
+
+  }
+}
@@ -0,0 +1,51 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef NET_TCP_OPTION_H
+#define NET_TCP_OPTION_H
+
+#include <log/log.h>
+
+#include <boost/asio/ip/tcp.hpp>
+
+namespace Net {
+
+  namespace TCP {
+
+    namespace Client { class Options; }
+
+    namespace Option {
+
+      // to be called after open() and before connect() - options
+      // that aren't supported on the platform are logged and ignored
+      void apply(boost::asio::ip::tcp::socket &socket,
+          const Client::Options &opts,
+          boost::log::sources::severity_logger<Log::Severity> &lg);
+
+      // Linux resets TCP_QUICKACK after some ACKs, thus, it has to be
+      // re-enabled after each read
+      void quick_ack(boost::asio::ip::tcp::socket &socket);
+
+    }
+
+  }
+}
+
+#endif
@@ -0,0 +1,218 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "stages.h"
+
+#include <enum.h>
+
+#include <chrono>
+#include <iomanip>
+#include <stdexcept>
+
+#include <string.h>
+#include <unistd.h>
+#if defined(__linux__)
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+namespace Perf {
+
+  static const char *const stage_map[] = {
+    "net read",
+    "parse",
+    "header print",
+    "file write",
+    "maildir move"
+  };
+  std::ostream &operator<<(std::ostream &o, Stage s)
+  {
+    o << enum_str(stage_map, s);
+    return o;
+  }
+
+  Sample &Sample::operator+=(const Sample &o)
+  {
+    ns           += o.ns;
+    cycles       += o.cycles;
+    instructions += o.instructions;
+    cache_misses += o.cache_misses;
+    return *this;
+  }
+  Sample Sample::operator-(const Sample &o) const
+  {
+    Sample r;
+    r.ns           = ns           - o.ns;
+    r.cycles       = cycles       - o.cycles;
+    r.instructions = instructions - o.instructions;
+    r.cache_misses = cache_misses - o.cache_misses;
+    return r;
+  }
+
+#if defined(__linux__)
+  static int open_counter(uint64_t config, int group_fd, bool kernel)
+  {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size           = sizeof attr;
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = config;
+    attr.disabled       = group_fd == -1;
+    attr.exclude_kernel = !kernel;
+    attr.exclude_hv     = 1;
+    attr.read_format    = PERF_FORMAT_GROUP;
+    // this thread, any CPU
+    return int(syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0));
+  }
+  // cycles (the group leader), instructions, cache misses
+  static bool open_group(int *fds, bool kernel)
+  {
+    static const uint64_t configs[3] = { PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES };
+    for (unsigned i = 0; i < 3; ++i) {
+      fds[i] = open_counter(configs[i], i ? fds[0] : -1, kernel);
+      if (fds[i] == -1) {
+        for (unsigned j = 0; j < i; ++j) {
+          ::close(fds[j]);
+          fds[j] = -1;
+        }
+        return false;
+      }
+    }
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+  }
+#endif
+
+  Counters::Counters()
+  {
+#if defined(__linux__)
+    if (!open_group(fds_, true)) {
+      // perf_event_paranoid > 1 only allows user space counting
+      kernel_ = false;
+      open_group(fds_, false);
+    }
+#endif
+  }
+  Counters::~Counters()
+  {
+    for (int fd : fds_)
+      if (fd != -1)
+        ::close(fd);
+  }
+  bool Counters::hardware() const
+  {
+    return fds_[0] != -1;
+  }
+  bool Counters::kernel() const
+  {
+    return hardware() && kernel_;
+  }
+  Sample Counters::read() const
+  {
+    Sample r;
+    r.ns = chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+    if (fds_[0] == -1)
+      return r;
+    // nr, then the values in group order
+    uint64_t v[4] = {0};
+    if (::read(fds_[0], v, sizeof v) != ssize_t(sizeof v))
+      return r;
+    r.cycles       = v[1];
+    r.instructions = v[2];
+    r.cache_misses = v[3];
+    return r;
+  }
+
+  Stages::Stages()
+    :
+      totals_()
+  {
+    stack_.reserve(8);
+  }
+  Sample &Stages::total(Stage s)
+  {
+    return totals_[size_t(s) - 1];
+  }
+  void Stages::enter(Stage s)
+  {
+    Sample now(counters_.read());
+    if (!stack_.empty())
+      total(stack_.back()) += now - last_;
+    stack_.push_back(s);
+    last_ = now;
+  }
+  void Stages::leave()
+  {
+    if (stack_.empty())
+      throw logic_error("leaving a perf stage that wasn't entered");
+    Sample now(counters_.read());
+    total(stack_.back()) += now - last_;
+    stack_.pop_back();
+    last_ = now;
+  }
+
+  static double share(uint64_t a, uint64_t b)
+  {
+    return b ? 100.0 * double(a) / double(b) : 0.0;
+  }
+
+  void Stages::print(std::ostream &o, size_t messages) const
+  {
+    Sample sum;
+    for (auto &t : totals_)
+      sum += t;
+    double n = messages ? double(messages) : 1.0;
+    if (!counters_.hardware())
+      o << "(hardware counters unavailable - wall time only)\n";
+    else if (!counters_.kernel())
+      o << "(user space counters only - cf. perf_event_paranoid)\n";
+    o << left << setw(14) << "stage" << right
+      << setw(10) << "wall ms" << setw(7) << "%"
+      << setw(12) << "us/msg";
+    if (counters_.hardware())
+      o << setw(14) << "cycles/msg" << setw(7) << "%"
+        << setw(14) << "instr/msg" << setw(6) << "IPC"
+        << setw(12) << "misses/msg";
+    o << '\n' << fixed;
+    for (size_t i = 0; i < totals_.size(); ++i) {
+      auto &t = totals_[i];
+      o << left << setw(14) << stage_map[i] << right << setprecision(1)
+        << setw(10) << (t.ns / 1e6)
+        << setw(7) << share(t.ns, sum.ns)
+        << setw(12) << (t.ns / 1e3 / n);
+      if (counters_.hardware())
+        o << setprecision(0)
+          << setw(14) << (t.cycles / n)
+          << setprecision(1) << setw(7) << share(t.cycles, sum.cycles)
+          << setprecision(0) << setw(14) << (t.instructions / n)
+          << setprecision(2) << setw(6)
+          << (t.cycles ? double(t.instructions) / double(t.cycles) : 0.0)
+          << setprecision(0) << setw(12) << (t.cache_misses / n);
+      o << '\n';
+    }
+    o.unsetf(ios::floatfield);
+  }
+
+}
@@ -0,0 +1,117 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef PERF_STAGES_H
+#define PERF_STAGES_H
+
+#include <array>
+#include <ostream>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Perf {
+
+  // the main stages of a download
+  enum class Stage {
+    FIRST_,
+    NET_READ,     // from issuing a read until its completion, incl. TLS
+    PARSE,        // Parser::read without the stages below
+    HEADER_PRINT, // Header_Printer::print
+    FILE_WRITE,   // writing, splicing and closing message files
+    MAILDIR_MOVE, // Maildir::move_to_new/cur
+    LAST_
+  };
+  std::ostream &operator<<(std::ostream &o, Stage s);
+
+  struct Sample {
+    uint64_t ns           {0};
+    uint64_t cycles       {0};
+    uint64_t instructions {0};
+    uint64_t cache_misses {0};
+
+    Sample &operator+=(const Sample &o);
+    Sample operator-(const Sample &o) const;
+  };
+
+  // Hardware counters (cycles, instructions, cache misses) of the
+  // calling thread via perf_event_open(2) - when that isn't available
+  // (e.g. perf_event_paranoid, no PMU in a VM) only the wall time is
+  // sampled.
+  class Counters {
+    private:
+      int  fds_[3] {-1, -1, -1};
+      bool kernel_ {true};
+    public:
+      Counters();
+      ~Counters();
+      Counters(const Counters &) =delete;
+      Counters &operator=(const Counters &) =delete;
+
+      bool hardware() const;
+      // i.e. the counters include the time spent in system calls
+      bool kernel() const;
+      Sample read() const;
+  };
+
+  // Attributes the counters to the innermost entered stage, i.e. a
+  // nested stage pauses the enclosing one. Not thread-safe, one instance
+  // per io_service thread.
+  class Stages {
+    private:
+      Counters counters_;
+      std::array<Sample, size_t(Stage::LAST_) - 1> totals_;
+      std::vector<Stage> stack_;
+      Sample last_;
+
+      Sample &total(Stage s);
+    public:
+      Stages();
+      void enter(Stage s);
+      void leave();
+
+      // share of each stage, absolute and per message
+      void print(std::ostream &o, size_t messages) const;
+  };
+
+  // a null stages pointer means disabled, i.e. just a branch
+  class Scope {
+    private:
+      Stages *stages_;
+    public:
+      Scope(Stages *stages, Stage s)
+        :
+          stages_(stages)
+      {
+        if (stages_)
+          stages_->enter(s);
+      }
+      ~Scope()
+      {
+        if (stages_)
+          stages_->leave();
+      }
+      Scope(const Scope &) =delete;
+      Scope &operator=(const Scope &) =delete;
+  };
+
+}
+
+#endif
@@ -0,0 +1,345 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include "analyzer.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <ctype.h>
+#include <stdlib.h>
+
+using namespace std;
+
+namespace Trace {
+
+  uint64_t Analyzer::Command::latency() const
+  {
+    return done ? completed - sent : 0;
+  }
+  uint64_t Analyzer::Command::to_first_byte() const
+  {
+    return responded ? first_byte - sent : 0;
+  }
+  double Analyzer::Command::literal_rate() const
+  {
+    if (!literal || !done || completed <= first_byte)
+      return 0;
+    return double(literal) * 1000000.0 / double(completed - first_byte);
+  }
+
+  // e.g. "* 1 FETCH (BODY[] {123}" -> 123
+  static size_t literal_size(const string &line)
+  {
+    if (line.empty() || line.back() != '}')
+      return 0;
+    auto i = line.rfind('{');
+    if (i == string::npos)
+      return 0;
+    size_t n = 0;
+    for (auto j = i + 1; j + 1 < line.size(); ++j) {
+      char c = line[j];
+      if (c == '+' && j + 2 == line.size())
+        break;
+      if (!isdigit(static_cast<unsigned char>(c)))
+        return 0;
+      n = n * 10 + (c - '0');
+    }
+    return n;
+  }
+
+  template <typename F>
+  size_t Analyzer::Lines::feed(const char *begin, const char *end, F fn)
+  {
+    size_t skipped = 0;
+    while (begin != end) {
+      if (literal_left_) {
+        size_t n = std::min(literal_left_, size_t(end - begin));
+        literal_left_ -= n;
+        begin += n;
+        skipped += n;
+        continue;
+      }
+      const char *nl = find(begin, end, '\n');
+      if (nl == end) {
+        line_.append(begin, end);
+        break;
+      }
+      line_.append(begin, nl);
+      begin = nl + 1;
+      if (!line_.empty() && line_.back() == '\r')
+        line_.pop_back();
+      fn(line_);
+      literal_left_ = literal_size(line_);
+      line_.clear();
+    }
+    return skipped;
+  }
+
+  Analyzer::Analyzer(uint64_t gap_threshold)
+    :
+      gap_threshold_(gap_threshold)
+  {
+  }
+
+  void Analyzer::push(const Record_View &r)
+  {
+    now_ += r.timestamp;
+    switch (r.type) {
+      case Type::SENT:
+      case Type::RECEIVED:
+        if (seen_data_ && now_ - last_ >= gap_threshold_) {
+          Gap g;
+          g.begin     = last_;
+          g.length    = now_ - last_;
+          g.in_flight = !in_flight_.empty();
+          gaps_.push_back(g);
+        }
+        seen_data_ = true;
+        last_ = now_;
+        if (r.type == Type::SENT)
+          sent(r);
+        else
+          received(r);
+        break;
+      case Type::MARK:
+        marks_.emplace_back(string(r.begin, r.end), now_);
+        break;
+      case Type::DISCONNECT:
+      case Type::END_OF_FILE:
+        break;
+    }
+  }
+
+  void Analyzer::sent(const Record_View &r)
+  {
+    sent_lines_.feed(r.begin, r.end,
+        [this](const string &line) { sent_line(line); });
+  }
+
+  void Analyzer::sent_line(const string &line)
+  {
+    auto i = line.find(' ');
+    if (i == 0 || i == string::npos)
+      return;
+    for (size_t k = 0; k < i; ++k)
+      if (!isalnum(static_cast<unsigned char>(line[k])))
+        return;
+    Command c;
+    c.tag = line.substr(0, i);
+    c.sent = now_;
+    for (;;) {
+      auto j = line.find(' ', i + 1);
+      string word(line.substr(i + 1, j == string::npos ? string::npos : j - i - 1));
+      if (word.empty())
+        return;
+      for (auto &x : word) {
+        if (!isalpha(static_cast<unsigned char>(x)))
+          return;
+        x = toupper(static_cast<unsigned char>(x));
+      }
+      if (!c.name.empty())
+        c.name += ' ';
+      c.name += word;
+      if (word != "UID" || j == string::npos)
+        break;
+      i = j;
+    }
+    in_flight_.push_back(commands_.size());
+    commands_.push_back(std::move(c));
+  }
+
+  void Analyzer::received(const Record_View &r)
+  {
+    if (!read_) {
+      read_ = true;
+      first_read_ = now_;
+    }
+    for (auto i : in_flight_)
+      if (!commands_[i].responded) {
+        commands_[i].responded  = true;
+        commands_[i].first_byte = now_;
+      }
+    // untagged responses belong to the oldest command in flight
+    Command *c = in_flight_.empty() ? nullptr : &commands_[in_flight_.front()];
+    size_t literal = received_lines_.feed(r.begin, r.end,
+        [this](const string &line) { received_line(line); });
+    if (c) {
+      c->received += r.size();
+      c->literal  += literal;
+    }
+  }
+
+  void Analyzer::received_line(const string &line)
+  {
+    for (auto i = in_flight_.begin(); i != in_flight_.end(); ++i) {
+      const string &tag = commands_[*i].tag;
+      if (line.size() > tag.size() && line[tag.size()] == ' '
+          && !line.compare(0, tag.size(), tag)) {
+        commands_[*i].completed = now_;
+        commands_[*i].done      = true;
+        in_flight_.erase(i);
+        return;
+      }
+    }
+  }
+
+  const std::vector<Analyzer::Command> &Analyzer::commands() const
+  {
+    return commands_;
+  }
+  const std::vector<Analyzer::Gap> &Analyzer::gaps() const
+  {
+    return gaps_;
+  }
+
+  const char *phase_of(const std::string &command)
+  {
+    static const map<string, const char*> m = {
+      { "CAPABILITY"  , "login"   },
+      { "ID"          , "login"   },
+      { "STARTTLS"    , "login"   },
+      { "AUTHENTICATE", "login"   },
+      { "LOGIN"       , "login"   },
+      { "SELECT"      , "select"  },
+      { "EXAMINE"     , "select"  },
+      { "FETCH"       , "fetch"   },
+      { "UID FETCH"   , "fetch"   },
+      { "STORE"       , "store"   },
+      { "UID STORE"   , "store"   },
+      { "EXPUNGE"     , "expunge" },
+      { "UID EXPUNGE" , "expunge" },
+      { "CLOSE"       , "expunge" },
+      { "LIST"        , "list"    },
+      { "LSUB"        , "list"    },
+      { "LOGOUT"      , "logout"  }
+    };
+    auto i = m.find(command);
+    return i == m.end() ? "other" : i->second;
+  }
+
+  std::vector<Analyzer::Phase> Analyzer::phases() const
+  {
+    vector<Phase> r;
+    uint64_t prev = 0;
+    for (auto &m : marks_) {
+      Phase p;
+      p.name  = m.first;
+      p.begin = prev;
+      p.end   = m.second;
+      r.push_back(p);
+      prev = m.second;
+    }
+    if (read_ && (commands_.empty() || first_read_ <= commands_.front().sent)) {
+      Phase p;
+      p.name  = "greeting";
+      p.begin = prev;
+      p.end   = first_read_;
+      r.push_back(p);
+    }
+    size_t off = r.size();
+    for (auto &c : commands_) {
+      const char *name = phase_of(c.name);
+      auto i = find_if(r.begin() + off, r.end(),
+          [name](const Phase &p) { return p.name == name; });
+      uint64_t end = std::max(c.completed, c.sent);
+      if (i == r.end()) {
+        Phase p;
+        p.name  = name;
+        p.begin = c.sent;
+        p.end   = end;
+        r.push_back(p);
+      } else {
+        i->begin = std::min(i->begin, c.sent);
+        i->end   = std::max(i->end, end);
+      }
+    }
+    return r;
+  }
+
+  namespace {
+    struct ms {
+      uint64_t us;
+      ms(uint64_t us) : us(us) {}
+    };
+    ostream &operator<<(ostream &o, const ms &x)
+    {
+      return o << fixed << setprecision(3) << setw(11) << (double(x.us) / 1000.0);
+    }
+  }
+
+  void Analyzer::print(std::ostream &o) const
+  {
+    const unsigned width = 40;
+    auto ps = phases();
+    uint64_t total = 0;
+    for (auto &p : ps)
+      total = std::max(total, p.end);
+    o << "Phases (ms):\n"
+      << "  phase           start    duration\n";
+    for (auto &p : ps) {
+      o << "  " << left << setw(9) << p.name << right
+        << ms(p.begin) << ' ' << ms(p.end - p.begin) << "  ";
+      if (total) {
+        unsigned a = unsigned(p.begin * width / total);
+        unsigned b = std::max(unsigned(p.end * width / total), a + 1);
+        o << string(a, ' ') << string(b - a, '#');
+      }
+      o << '\n';
+    }
+
+    o << "\nCommands (ms):\n"
+      << "  tag      command       latency  first byte      bytes   literal MiB/s\n";
+    for (auto &c : commands_) {
+      o << "  " << left << setw(8) << c.tag << ' ' << setw(11) << c.name << right
+        << ' ' << ms(c.latency()) << ' ' << ms(c.to_first_byte())
+        << ' ' << setw(10) << c.received;
+      if (c.literal_rate() > 0)
+        o << ' ' << fixed << setprecision(2) << setw(15)
+          << (c.literal_rate() / (1024.0 * 1024.0));
+      if (!c.done)
+        o << " (not completed)";
+      o << '\n';
+    }
+
+    map<string, pair<size_t, uint64_t> > by_name;
+    map<string, uint64_t> max_latency;
+    for (auto &c : commands_) {
+      auto &x = by_name[c.name];
+      ++x.first;
+      x.second += c.latency();
+      max_latency[c.name] = std::max(max_latency[c.name], c.latency());
+    }
+    o << "\nSummary (ms):\n"
+      << "  command         count        mean         max\n";
+    for (auto &x : by_name)
+      o << "  " << left << setw(11) << x.first << right << ' '
+        << setw(9) << x.second.first << ' '
+        << ms(x.second.second / x.second.first) << ' '
+        << ms(max_latency[x.first]) << '\n';
+
+    o << "\nGaps >= " << (gap_threshold_ / 1000) << " ms:\n";
+    for (auto &g : gaps_)
+      o << "  at " << ms(g.begin) << ": " << ms(g.length)
+        << (g.in_flight ? "  waiting for the server (or not reading)"
+                        : "  client idle") << '\n';
+  }
+
+}
@@ -0,0 +1,116 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#ifndef TRACE_ANALYZER_H
+#define TRACE_ANALYZER_H
+
+#include <trace/trace.h>
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace Trace {
+
+  // Correlates tagged IMAP commands in a trace with their completions,
+  // all times are in us since the start of the trace.
+  class Analyzer {
+    public:
+      struct Command {
+        std::string tag;
+        std::string name;            // e.g. "UID FETCH"
+        uint64_t    sent       {0};
+        uint64_t    first_byte {0};
+        uint64_t    completed  {0};
+        bool        responded  {false};
+        bool        done       {false};
+        size_t      received   {0};  // response bytes
+        size_t      literal    {0};  // literal bytes in the response
+
+        uint64_t latency() const;
+        uint64_t to_first_byte() const;
+        // literal bytes per second - 0 if there is nothing to compute
+        double   literal_rate() const;
+      };
+      struct Phase {
+        std::string name;
+        uint64_t    begin {0};
+        uint64_t    end   {0};
+      };
+      // no record for at least the threshold - while a command was
+      // in flight (i.e. waiting for the server or not reading) or not
+      // (i.e. client was busy or waiting)
+      struct Gap {
+        uint64_t begin     {0};
+        uint64_t length    {0};
+        bool     in_flight {false};
+      };
+
+    private:
+      // splits a byte stream into lines, skips literals
+      class Lines {
+        private:
+          std::string line_;
+          size_t      literal_left_ {0};
+        public:
+          // fn(line) is called for each complete line (without CRLF),
+          // returns the number of literal bytes that were skipped
+          template <typename F> size_t feed(const char *begin, const char *end, F fn);
+      };
+
+      uint64_t              gap_threshold_;
+      uint64_t              now_        {0};
+      uint64_t              last_       {0};
+      bool                  seen_data_  {false};
+      bool                  read_       {false};
+      uint64_t              first_read_ {0};
+      std::vector<std::pair<std::string, uint64_t> > marks_;
+      std::vector<Command>  commands_;
+      std::vector<size_t>   in_flight_;
+      std::vector<Gap>      gaps_;
+      Lines                 sent_lines_;
+      Lines                 received_lines_;
+
+      void sent(const Record_View &r);
+      void received(const Record_View &r);
+      void sent_line(const std::string &line);
+      void received_line(const std::string &line);
+    public:
+      Analyzer(uint64_t gap_threshold = 50000);
+
+      void push(const Record_View &r);
+
+      const std::vector<Command> &commands() const;
+      const std::vector<Gap>     &gaps() const;
+      // connection phases (from the marks) and then one phase per
+      // command class (login, select, fetch, store, expunge, ...)
+      std::vector<Phase>          phases() const;
+
+      void print(std::ostream &o) const;
+  };
+
+  // command class, e.g. "fetch" for "UID FETCH"
+  const char *phase_of(const std::string &command);
+
+}
+
+#endif
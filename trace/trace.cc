@@ -25,7 +25,18 @@
 #include <chrono>
 #include <utility>
 #include <stdexcept>
-#include <boost/archive/text_oarchive.hpp>
+#include <system_error>
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/serialization/string.hpp>
+
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 
 using namespace std;
 
@@ -66,6 +77,9 @@ namespace Trace {
       case Type::END_OF_FILE:
         o << "{|}";
         break;
+      case Type::MARK:
+        o << "##";
+        break;
     }
     o << ' ' << timestamp << " |" << message << "|\n";
     return o;
@@ -75,40 +89,176 @@ namespace Trace {
     return r.print(o);
   }
 
+  std::ostream &Record_View::print(std::ostream &o) const
+  {
+    switch (type) {
+      case Type::SENT:
+        o << "->";
+        break;
+      case Type::RECEIVED:
+        o << "<-";
+        break;
+      case Type::DISCONNECT:
+        o << "->||";
+        break;
+      case Type::END_OF_FILE:
+        o << "{|}";
+        break;
+      case Type::MARK:
+        o << "##";
+        break;
+    }
+    o << ' ' << timestamp << " |";
+    o.write(begin, size());
+    o << "|\n";
+    return o;
+  }
+  std::ostream &operator<<(std::ostream &o, const Record_View &r)
+  {
+    return r.print(o);
+  }
+
+  static const char magic[8] = { 'i', 'm', 'a', 'p', 'd', 'l', 'T', '1' };
+  static const size_t header_size = 4 + 1 + 8;
+
+  static void throw_errno(const char *what)
+  {
+    throw system_error(errno, system_category(), what);
+  }
+  static void encode_header(char *p, Type type, uint64_t timestamp, uint32_t size)
+  {
+    for (unsigned i = 0; i < 4; ++i)
+      *p++ = char(size >> (8 * i));
+    *p++ = char(type);
+    for (unsigned i = 0; i < 8; ++i)
+      *p++ = char(timestamp >> (8 * i));
+  }
+  static void decode_header(const char *x, Type &type, uint64_t &timestamp,
+      uint32_t &size)
+  {
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(x);
+    size = 0;
+    for (unsigned i = 0; i < 4; ++i)
+      size |= uint32_t(p[i]) << (8 * i);
+    type = Type(p[4]);
+    timestamp = 0;
+    for (unsigned i = 0; i < 8; ++i)
+      timestamp |= uint64_t(p[5 + i]) << (8 * i);
+  }
+
   class Writer_Priv {
     private:
-      ofstream file_;
+      int fd_ {-1};
+      vector<char> buffer_;
+      size_t pos_ {0};
       std::chrono::time_point<std::chrono::steady_clock> start_;
-    public:
-      unique_ptr<boost::archive::text_oarchive>          oarchive_;
 
+      void write_all(const struct iovec *v, int n);
     public:
-      Writer_Priv(const string &filename);
-      size_t elapsed();
+      Writer_Priv(const string &filename, size_t buffer_size);
+      ~Writer_Priv();
+      uint64_t elapsed();
+      void append(Type type, uint64_t timestamp, const char *b, const char *e);
+      void flush();
+      void close();
   };
-  Writer_Priv::Writer_Priv(const string &filename)
+  Writer_Priv::Writer_Priv(const string &filename, size_t buffer_size)
+    :
+      buffer_(std::max(buffer_size, header_size + sizeof magic))
   {
-    file_.exceptions(ofstream::failbit | ofstream::badbit );
-    file_.open(filename, ofstream::out | ofstream::binary);
-    unique_ptr<boost::archive::text_oarchive> a(new boost::archive::text_oarchive(file_));
-    oarchive_ = std::move(a);
+    // may contain credentials and private messages
+    fd_ = ::open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0600);
+    if (fd_ == -1)
+      throw_errno("open trace file");
+    memcpy(buffer_.data(), magic, sizeof magic);
+    pos_ = sizeof magic;
     start_ = chrono::steady_clock::now();
   }
-  size_t Writer_Priv::elapsed()
+  Writer_Priv::~Writer_Priv()
   {
-    auto s = chrono::duration_cast<chrono::milliseconds>(
-        chrono::steady_clock::now() - start_).count();
-    start_ = chrono::steady_clock::now();
+    if (fd_ != -1)
+      ::close(fd_);
+  }
+  uint64_t Writer_Priv::elapsed()
+  {
+    auto now = chrono::steady_clock::now();
+    auto s = chrono::duration_cast<chrono::microseconds>(now - start_).count();
+    start_ = now;
     return s;
   }
+  void Writer_Priv::write_all(const struct iovec *v, int n)
+  {
+    struct iovec w[2];
+    std::copy(v, v + n, w);
+    struct iovec *x = w;
+    while (n) {
+      ssize_t r = ::writev(fd_, x, n);
+      if (r == -1) {
+        if (errno == EINTR)
+          continue;
+        throw_errno("write trace file");
+      }
+      size_t l = r;
+      while (n && l >= x->iov_len) {
+        l -= x->iov_len;
+        ++x;
+        --n;
+      }
+      if (n) {
+        x->iov_base = static_cast<char*>(x->iov_base) + l;
+        x->iov_len -= l;
+      }
+    }
+  }
+  void Writer_Priv::append(Type type, uint64_t timestamp,
+      const char *b, const char *e)
+  {
+    size_t n = e - b;
+    if (n > numeric_limits<uint32_t>::max())
+      throw length_error("trace record too large");
+    if (buffer_.size() - pos_ < header_size + n)
+      flush();
+    if (buffer_.size() < header_size + n) {
+      // larger than the buffer, thus bypass it
+      char h[header_size];
+      encode_header(h, type, timestamp, n);
+      struct iovec v[2] = {
+        { h, header_size },
+        { const_cast<char*>(b), n }
+      };
+      write_all(v, 2);
+      return;
+    }
+    encode_header(buffer_.data() + pos_, type, timestamp, n);
+    pos_ += header_size;
+    if (n)
+      memcpy(buffer_.data() + pos_, b, n);
+    pos_ += n;
+  }
+  void Writer_Priv::flush()
+  {
+    if (!pos_)
+      return;
+    struct iovec v = { buffer_.data(), pos_ };
+    pos_ = 0;
+    write_all(&v, 1);
+  }
+  void Writer_Priv::close()
+  {
+    flush();
+    int fd = fd_;
+    fd_ = -1;
+    if (::close(fd) == -1)
+      throw_errno("close trace file");
+  }
 
   Writer::Writer()
   {
   }
-  Writer::Writer(const std::string &filename)
+  Writer::Writer(const std::string &filename, size_t buffer_size)
   {
     if (!filename.empty())
-      start(filename);
+      start(filename, buffer_size);
   }
   Writer::~Writer()
   {
@@ -118,32 +268,281 @@ namespace Trace {
       // don't throw exceptions from destructor ...
     }
   }
-  void Writer::start(const std::string &filename)
+  void Writer::start(const std::string &filename, size_t buffer_size)
   {
     if (d)
       throw logic_error("Trace Writer already started");
-    d = unique_ptr<Writer_Priv>(new Writer_Priv(filename));
+    d = unique_ptr<Writer_Priv>(new Writer_Priv(filename, buffer_size));
   }
   void Writer::push(Type type)
   {
     if (!d)
       return;
-    Trace::Record r(type, d->elapsed());
-    *d->oarchive_ << r;
+    d->append(type, d->elapsed(), nullptr, nullptr);
   }
   void Writer::push(Type type, const std::vector<char> &v, size_t size)
   {
     if (!d)
       return;
-    Trace::Record r(type, d->elapsed(), v.data(), std::min(v.size(), size));
-    *d->oarchive_ << r;
+    d->append(type, d->elapsed(), v.data(), v.data() + std::min(v.size(), size));
+  }
+  void Writer::push(Type type, const char *begin, const char *end)
+  {
+    if (!d)
+      return;
+    d->append(type, d->elapsed(), begin, end);
+  }
+  void Writer::push(const Record_View &r)
+  {
+    if (!d)
+      return;
+    d->append(r.type, r.timestamp, r.begin, r.end);
+  }
+  void Writer::flush()
+  {
+    if (!d)
+      return;
+    d->flush();
   }
   void Writer::finish()
   {
     if (!d)
       return;
-    Trace::Record r(Trace::Type::END_OF_FILE);
-    *d->oarchive_ << r;
+    unique_ptr<Writer_Priv> x(std::move(d));
+    x->append(Type::END_OF_FILE, 0, nullptr, nullptr);
+    x->close();
+  }
+
+  static void legacy_to_binary(const string &filename, string &out)
+  {
+    ifstream f;
+    f.exceptions(ifstream::failbit | ifstream::badbit);
+    f.open(filename, ifstream::in | ifstream::binary);
+    boost::archive::text_iarchive iarchive(f);
+    out.assign(magic, sizeof magic);
+    for (;;) {
+      Record r;
+      iarchive >> r;
+      char h[header_size];
+      // old timestamps are in ms
+      encode_header(h, r.type, uint64_t(r.timestamp) * 1000, r.message.size());
+      out.append(h, header_size);
+      out += r.message;
+      if (r.type == Type::END_OF_FILE)
+        break;
+    }
+  }
+
+  Reader::Reader(const std::string &filename)
+  {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+      throw_errno("open trace file");
+    struct stat st;
+    if (::fstat(fd, &st) == -1) {
+      ::close(fd);
+      throw_errno("stat trace file");
+    }
+    map_size_ = st.st_size;
+    if (map_size_) {
+      map_ = ::mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        ::close(fd);
+        throw_errno("mmap trace file");
+      }
+      ::madvise(map_, map_size_, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+    begin_ = static_cast<const char*>(map_);
+    end_ = begin_ + map_size_;
+    if (map_size_ < sizeof magic || memcmp(begin_, magic, sizeof magic)) {
+      if (map_)
+        ::munmap(map_, map_size_);
+      map_ = nullptr;
+      legacy_to_binary(filename, legacy_);
+      begin_ = legacy_.data();
+      end_ = begin_ + legacy_.size();
+    }
+    p_ = begin_ + sizeof magic;
+  }
+  Reader::~Reader()
+  {
+    if (map_)
+      ::munmap(map_, map_size_);
+  }
+  Record_View Reader::next()
+  {
+    Record_View r;
+    if (size_t(end_ - p_) < header_size)
+      return r;
+    Type type;
+    uint64_t timestamp;
+    uint32_t size;
+    decode_header(p_, type, timestamp, size);
+    if (size_t(end_ - p_) - header_size < size)
+      return r;
+    r.type = type;
+    r.timestamp = timestamp;
+    r.begin = p_ + header_size;
+    r.end = r.begin + size;
+    p_ = r.end;
+    return r;
+  }
+
+  Ring::Ring(size_t capacity)
+    :
+      buffer_(std::max(capacity, 2 * header_size)),
+      start_(chrono::steady_clock::now())
+  {
+  }
+  void Ring::copy_in(size_t pos, const char *begin, const char *end)
+  {
+    size_t n = end - begin;
+    if (!n)
+      return;
+    size_t k = std::min(n, buffer_.size() - pos);
+    memcpy(buffer_.data() + pos, begin, k);
+    memcpy(buffer_.data(), begin + k, n - k);
+  }
+  void Ring::copy_out(size_t pos, char *begin, char *end) const
+  {
+    size_t n = end - begin;
+    if (!n)
+      return;
+    size_t k = std::min(n, buffer_.size() - pos);
+    memcpy(begin, buffer_.data() + pos, k);
+    memcpy(begin + k, buffer_.data(), n - k);
+  }
+  void Ring::drop_oldest()
+  {
+    char h[header_size];
+    copy_out(head_, h, h + header_size);
+    Type type;
+    uint64_t timestamp;
+    uint32_t n;
+    decode_header(h, type, timestamp, n);
+    head_ = (head_ + header_size + n) % buffer_.size();
+    size_ -= header_size + n;
+  }
+  void Ring::push(Type type)
+  {
+    push(type, nullptr, nullptr);
+  }
+  size_t Ring::push_header(Type type, size_t n)
+  {
+    while (buffer_.size() - size_ < header_size + n)
+      drop_oldest();
+    auto now = chrono::steady_clock::now();
+    uint64_t timestamp = chrono::duration_cast<chrono::microseconds>(
+        now - start_).count();
+    start_ = now;
+    char h[header_size];
+    encode_header(h, type, timestamp, n);
+    size_t pos = (head_ + size_) % buffer_.size();
+    copy_in(pos, h, h + header_size);
+    size_ += header_size + n;
+    return (pos + header_size) % buffer_.size();
+  }
+  void Ring::push(Type type, const char *begin, const char *end)
+  {
+    // keep the tail of records that don't fit at all
+    size_t n = std::min(size_t(end - begin), buffer_.size() - header_size);
+    begin = end - n;
+    copy_in(push_header(type, n), begin, end);
+  }
+  void Ring::push(Type type, size_t size, char fill)
+  {
+    size_t n = std::min(size, buffer_.size() - header_size);
+    size_t pos = push_header(type, n);
+    size_t k = std::min(n, buffer_.size() - pos);
+    memset(buffer_.data() + pos, fill, k);
+    memset(buffer_.data(), fill, n - k);
+  }
+  bool Ring::empty() const
+  {
+    return !size_;
+  }
+  void Ring::dump(const std::string &filename) const
+  {
+    Writer writer(filename);
+    vector<char> v;
+    size_t pos = head_;
+    size_t left = size_;
+    while (left) {
+      char h[header_size];
+      copy_out(pos, h, h + header_size);
+      Record_View r;
+      uint32_t n;
+      decode_header(h, r.type, r.timestamp, n);
+      v.resize(n);
+      copy_out((pos + header_size) % buffer_.size(), v.data(), v.data() + n);
+      r.begin = v.data();
+      r.end = v.data() + n;
+      writer.push(r);
+      pos = (pos + header_size + n) % buffer_.size();
+      left -= header_size + n;
+    }
+    writer.finish();
+  }
+
+  static bool is_command(const char *begin, const char *end, const char *c)
+  {
+    size_t n = strlen(c);
+    return size_t(end - begin) == n && !strncasecmp(begin, c, n);
+  }
+
+  bool redact_credentials(const char *begin, const char *end,
+      std::vector<char> &out)
+  {
+    // TAG SP COMMAND SP ARGUMENTS CRLF
+    const char *tag_end = std::find(begin, end, ' ');
+    if (tag_end == end)
+      return false;
+    const char *c = tag_end + 1;
+    const char *c_end = c;
+    while (c_end != end && *c_end != ' ' && *c_end != '\r')
+      ++c_end;
+    if (!is_command(c, c_end, "LOGIN") && !is_command(c, c_end, "AUTHENTICATE"))
+      return false;
+    out.assign(begin, end);
+    char *p = out.data() + (c_end - begin);
+    char *e = out.data() + out.size();
+    while (p != e) {
+      // {N}CRLF or {N+}CRLF - the N following bytes are the literal
+      if (*p == '{') {
+        char *q = p + 1;
+        size_t n = 0;
+        while (q != e && *q >= '0' && *q <= '9')
+          n = n * 10 + size_t(*q++ - '0');
+        if (q != e && *q == '+')
+          ++q;
+        if (q != e && *q == '}' && e - q >= 3 && q[1] == '\r' && q[2] == '\n') {
+          p = q + 3;
+          size_t k = std::min(n, size_t(e - p));
+          memset(p, 'X', k);
+          p += k;
+          continue;
+        }
+      }
+      if (*p != ' ' && *p != '\r' && *p != '\n')
+        *p = 'X';
+      ++p;
+    }
+    return true;
+  }
+
+  void convert(const std::string &in_filename, const std::string &out_filename)
+  {
+    Reader reader(in_filename);
+    Writer writer(out_filename);
+    for (;;) {
+      Record_View r(reader.next());
+      if (r.type == Type::END_OF_FILE)
+        break;
+      writer.push(r);
+    }
+    writer.finish();
   }
 
 }
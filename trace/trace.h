@@ -26,7 +26,9 @@
 #include <ostream>
 #include <memory>
 #include <limits>
+#include <chrono>
 #include <stddef.h>
+#include <stdint.h>
 
 // needed when serializing std::vector ...
 //#include <boost/serialization/vector.hpp>
@@ -35,12 +37,23 @@
 #include <boost/serialization/split_member.hpp>
 #include <boost/serialization/tracking.hpp>
 
+// Binary trace file format (all integers little endian):
+//
+//     magic record*
+//     record = length:u32 type:u8 timestamp:u64 byte{length}
+//
+// The timestamp is the number of microseconds since the previous record.
+// Files that don't start with the magic are read as (old) Boost text
+// archives of Trace::Record.
+
 namespace Trace {
   enum class Type {
     SENT,
     RECEIVED,
     DISCONNECT,
-    END_OF_FILE
+    END_OF_FILE,
+    // end of a connection phase, e.g. 'resolve' - the label is the message
+    MARK
   };
 
   struct Record {
@@ -83,6 +96,18 @@ namespace Trace {
   };
   std::ostream &operator<<(std::ostream &o, const Record &r);
 
+  // points into the memory of a Reader
+  struct Record_View {
+    Type        type      {Type::END_OF_FILE};
+    uint64_t    timestamp {0}; // in us
+    const char *begin     {nullptr};
+    const char *end       {nullptr};
+
+    size_t size() const { return end - begin; }
+    std::ostream &print(std::ostream &o) const;
+  };
+  std::ostream &operator<<(std::ostream &o, const Record_View &r);
+
   class Writer_Priv;
   class Writer {
     private:
@@ -90,13 +115,71 @@ namespace Trace {
     public:
       Writer();
       ~Writer();
-      Writer(const std::string &filename);
-      void start(const std::string &filename);
+      Writer(const std::string &filename, size_t buffer_size = 1024 * 1024);
+      void start(const std::string &filename, size_t buffer_size = 1024 * 1024);
       void push(Type type);
       void push(Type type, const std::vector<char> &v,
           size_t size = std::numeric_limits<size_t>::max());
+      void push(Type type, const char *begin, const char *end);
+      // keeps the timestamp of the record, e.g. when converting
+      void push(const Record_View &r);
+      void flush();
       void finish();
   };
+
+  // memory maps a binary trace file - or converts an old text archive
+  class Reader {
+    private:
+      const char *begin_ {nullptr};
+      const char *end_   {nullptr};
+      const char *p_     {nullptr};
+      void       *map_   {nullptr};
+      size_t      map_size_ {0};
+      std::string legacy_;
+    public:
+      Reader(const std::string &filename);
+      ~Reader();
+      Reader(const Reader &) =delete;
+      Reader &operator=(const Reader &) =delete;
+
+      // returns END_OF_FILE at the end and for a truncated last record
+      Record_View next();
+  };
+
+  // Bounded in-memory trace of the most recent records, i.e. a flight
+  // recorder - the oldest records are dropped when it is full. Pushing
+  // copies into the preallocated buffer, dump() writes a binary trace file.
+  class Ring {
+    private:
+      std::vector<char> buffer_;
+      size_t            head_ {0};
+      size_t            size_ {0};
+      std::chrono::time_point<std::chrono::steady_clock> start_;
+
+      void copy_in(size_t pos, const char *begin, const char *end);
+      void copy_out(size_t pos, char *begin, char *end) const;
+      void drop_oldest();
+      // makes room and writes the header, returns the payload position
+      size_t push_header(Type type, size_t n);
+    public:
+      Ring(size_t capacity);
+      void push(Type type);
+      void push(Type type, const char *begin, const char *end);
+      // a record of size fill bytes - a placeholder for data that
+      // bypassed user space, e.g. spliced message literals
+      void push(Type type, size_t size, char fill);
+      bool empty() const;
+      void dump(const std::string &filename) const;
+  };
+
+  void convert(const std::string &in_filename, const std::string &out_filename);
+
+  // If [begin, end) is a LOGIN or AUTHENTICATE command, copies it into
+  // out with the arguments replaced by 'X' bytes and returns true. The
+  // length, the line breaks and literal headers are kept, thus the
+  // framing of a trace stays intact.
+  bool redact_credentials(const char *begin, const char *end,
+      std::vector<char> &out);
 }
 BOOST_CLASS_VERSION(Trace::Record, 1)
 BOOST_CLASS_TRACKING(Trace::Record, boost::serialization::track_never)
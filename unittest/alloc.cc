@@ -0,0 +1,159 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <alloc/accounting.h>
+#include <bench/session.h>
+#include <copy/client.h>
+#include <copy/options.h>
+#include <log/log.h>
+#include <net/loopback_client.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+// Tolerated growth of the allocations per downloaded message when the
+// session gets longer - in the steady state of the FETCH loop the cost of
+// a message must not depend on how many messages came before it. The
+// reference is measured by the test itself (first 100 messages vs. the
+// next 100), thus it holds for any allocator and standard library.
+static const double fetch_allocation_slack = 1.1;
+
+// downloads a synthetic session of count messages over the loopback
+// transport and returns the allocations of the whole run
+static Alloc::Counts download(size_t count)
+{
+  string dir("tmp/alloc");
+  string maildir(dir + "/maildir");
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+
+  Bench::Session_Options sopts;
+  sopts.count    = count;
+  sopts.username = "juser123";
+  sopts.password = "muchvery";
+  string trace(dir + "/session.trace");
+  Bench::generate(trace, sopts);
+
+  string rc(dir + "/rc.json");
+  {
+    ofstream f(rc);
+    f << "{\n  \"alloc\":\n  {\n"
+      << "    \"username\" : \"" << sopts.username << "\",\n"
+      << "    \"password\" : \"" << sopts.password << "\",\n"
+      << "    \"host\"     : \"localhost\",\n"
+      << "    \"port\"     : \"143\",\n"
+      << "    \"maildir\"  : \"" << maildir << "\",\n"
+      << "    \"delete\"   : false\n"
+      << "  }\n}\n";
+  }
+  string journal(dir + "/journal");
+  char *argv[] = {
+    (char*)"imapdl", (char*)"--account", (char*)"alloc",
+    (char*)"--config", (char*)rc.c_str(),
+    (char*)"--ssl", (char*)"no",
+    (char*)"-v0",
+    (char*)"--journal", (char*)journal.c_str(),
+    (char*)"--flight_recorder", (char*)"0",
+    0
+  };
+  int argc = sizeof(argv)/sizeof(char*)-1;
+  IMAP::Copy::Options opts(argc, argv);
+  boost::log::sources::severity_logger<Log::Severity> lg(Log::create(
+        static_cast<Log::Severity>(opts.severity),
+        static_cast<Log::Severity>(opts.file_severity),
+        opts.logfile));
+  Net::Loopback::Client::Options net_opts;
+  net_opts.severity      = opts.severity;
+  net_opts.file_severity = opts.file_severity;
+  net_opts.script        = trace;
+
+  auto before = Alloc::total();
+  {
+    boost::asio::io_service io_service;
+    Net::Loopback::Client::Base net_client(io_service, net_opts, lg);
+    IMAP::Copy::Client client(opts, net_client, lg);
+    io_service.run();
+    BOOST_CHECK(net_client.finished());
+  }
+  auto after = Alloc::total();
+  Log::finish();
+
+  size_t n = 0;
+  for (fs::directory_iterator i(maildir + "/new"), e; i != e; ++i)
+    ++n;
+  BOOST_CHECK_EQUAL(n, count);
+  return after - before;
+}
+
+BOOST_AUTO_TEST_SUITE( alloc )
+
+  BOOST_AUTO_TEST_CASE( tag )
+  {
+    if (!Alloc::enabled()) {
+      BOOST_TEST_MESSAGE("built without IMAPDL_ALLOC_ACCOUNTING");
+      return;
+    }
+    auto before = Alloc::of("ut tag");
+    vector<char> v;
+    {
+      IMAPDL_ALLOC_TAG("ut tag");
+      v.resize(4096);
+    }
+    auto after = Alloc::of("ut tag") - before;
+    BOOST_CHECK_EQUAL(after.allocations, 1u);
+    BOOST_CHECK_EQUAL(after.bytes, v.size());
+
+    ostringstream o;
+    Alloc::print(o, 1);
+    BOOST_CHECK(o.str().find("ut tag") != string::npos);
+  }
+
+  BOOST_AUTO_TEST_CASE( fetch_budget )
+  {
+    if (!Alloc::enabled()) {
+      BOOST_TEST_MESSAGE("built without IMAPDL_ALLOC_ACCOUNTING");
+      return;
+    }
+    // the differences cancel the setup costs (login, select, logout)
+    auto small  = download(10);
+    auto medium = download(110);
+    auto large  = download(210);
+    double first  = double(medium.allocations - small.allocations) / 100;
+    double second = double(large.allocations - medium.allocations) / 100;
+    BOOST_TEST_MESSAGE("allocations per message: " << first
+        << " (messages 11-110), " << second << " (messages 111-210)");
+    BOOST_CHECK_LE(second, first * fetch_allocation_slack);
+    if (second > first * fetch_allocation_slack) {
+      ostringstream o;
+      // all runs, i.e. 330 messages
+      Alloc::print(o, 330);
+      BOOST_TEST_MESSAGE("per call site:\n" << o.str());
+    }
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,127 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+
+#include <completion.h>
+#include <alloc/accounting.h>
+
+#include <functional>
+#include <memory>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+  struct Big {
+    char pad[128];
+    int *x;
+    void operator()() const { ++*x; }
+  };
+
+}
+
+BOOST_AUTO_TEST_SUITE( completion )
+
+  BOOST_AUTO_TEST_CASE( small )
+  {
+    int x = 0;
+    Completion<void(void)> f([&x](){ ++x; });
+    BOOST_CHECK(f);
+    BOOST_CHECK(f.is_inline());
+    f();
+    BOOST_CHECK_EQUAL(x, 1);
+  }
+
+  BOOST_AUTO_TEST_CASE( args )
+  {
+    Completion<size_t(const string &, size_t)> f([](const string &s, size_t n) {
+        return s.size() + n; });
+    BOOST_CHECK_EQUAL(f("abc", 2), 5u);
+  }
+
+  BOOST_AUTO_TEST_CASE( move_only )
+  {
+    int x = 0;
+    unique_ptr<int> p(new int(5));
+    Completion<void(void)> f(std::bind([&x](unique_ptr<int> &p){ x += *p; },
+          std::move(p)));
+    Completion<void(void)> g(std::move(f));
+    BOOST_CHECK(!f);
+    g();
+    BOOST_CHECK_EQUAL(x, 5);
+  }
+
+  BOOST_AUTO_TEST_CASE( large )
+  {
+    int x = 0;
+    Big b;
+    b.x = &x;
+    Completion<void(void)> f(b);
+    BOOST_CHECK(!f.is_inline());
+    Completion<void(void)> g;
+    g = std::move(f);
+    g();
+    BOOST_CHECK_EQUAL(x, 1);
+  }
+
+  BOOST_AUTO_TEST_CASE( nested )
+  {
+    int x = 0;
+    Completion<void(void)> inner([&x](){ x += 2; });
+    Completion<void(void)> outer(std::bind([&x](Completion<void(void)> &f){
+          f(); ++x; }, std::move(inner)));
+    outer();
+    BOOST_CHECK_EQUAL(x, 3);
+  }
+
+  BOOST_AUTO_TEST_CASE( empty )
+  {
+    Completion<void(void)> f;
+    BOOST_CHECK(!f);
+    BOOST_CHECK_THROW(f(), bad_function_call);
+  }
+
+  BOOST_AUTO_TEST_CASE( recycled )
+  {
+    if (!Alloc::enabled()) {
+      BOOST_TEST_MESSAGE("built without IMAPDL_ALLOC_ACCOUNTING");
+      return;
+    }
+    int x = 0;
+    Big b;
+    b.x = &x;
+    {
+      Completion<void(void)> warm(b);
+    }
+    auto before = Alloc::total();
+    for (unsigned i = 0; i < 10; ++i) {
+      Completion<void(void)> f(b);
+      Completion<void(void)> g([&x](){ ++x; });
+      f();
+      g();
+    }
+    auto d = Alloc::total() - before;
+    BOOST_CHECK_EQUAL(d.allocations, 0u);
+    BOOST_CHECK_EQUAL(x, 20);
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
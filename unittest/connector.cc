@@ -0,0 +1,306 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+
+#include <net/connector.h>
+#include <net/tcp_client.h>
+
+#include <boost/asio.hpp>
+#include <boost/version.hpp>
+
+#include <chrono>
+#include <memory>
+#include <vector>
+using namespace std;
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace asio = boost::asio;
+
+static asio::ip::tcp::endpoint ep(const char *address)
+{
+  return asio::ip::tcp::endpoint(asio::ip::address::from_string(address), 993);
+}
+
+static asio::ip::tcp::resolver::iterator to_iterator(
+    const vector<asio::ip::tcp::endpoint> &v)
+{
+#if BOOST_VERSION >= 106600
+  return asio::ip::tcp::resolver::results_type::create(v.begin(), v.end(),
+      "localhost", "imaps");
+#else
+  return asio::ip::tcp::resolver::iterator::create(v.begin(), v.end(),
+      "localhost", "imaps");
+#endif
+}
+
+// a loopback port where nothing listens, i.e. connects are refused
+static asio::ip::tcp::endpoint refused_endpoint(asio::io_service &io_service)
+{
+  asio::ip::tcp::acceptor a(io_service,
+      asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+  auto e = a.local_endpoint();
+  a.close();
+  return e;
+}
+
+// A listener whose accept queue is full, thus Linux drops further SYNs,
+// i.e. connects to it hang - like to a blackholed address. Returns false
+// if it can't be set up like that.
+struct Stalled_Listener {
+  asio::ip::tcp::acceptor  acceptor;
+  vector<int>              fillers;
+
+  Stalled_Listener(asio::io_service &io_service)
+    :
+      acceptor(io_service)
+  {
+    asio::ip::tcp::endpoint e(asio::ip::address_v4::loopback(), 0);
+    acceptor.open(e.protocol());
+    acceptor.bind(e);
+    acceptor.listen(0);
+  }
+  ~Stalled_Listener()
+  {
+    for (int fd : fillers)
+      close(fd);
+  }
+  bool fill()
+  {
+    auto e = acceptor.local_endpoint();
+    for (unsigned i = 0; i < 16; ++i) {
+      int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+      if (fd == -1)
+        return false;
+      fillers.push_back(fd);
+      int r = connect(fd, e.data(), e.size());
+      if (!r)
+        continue;
+      if (errno != EINPROGRESS)
+        return false;
+      struct pollfd p = { fd, POLLOUT, 0 };
+      if (!poll(&p, 1, 200))
+        return true;
+    }
+    return false;
+  }
+};
+
+struct Connect_Result {
+  bool                      called {false};
+  boost::system::error_code ec;
+  chrono::milliseconds      elapsed {0};
+};
+
+static void async_connect(Net::TCP::Connector &connector,
+    const vector<asio::ip::tcp::endpoint> &v, asio::ip::tcp::socket &socket,
+    Connect_Result &result)
+{
+  auto start = chrono::steady_clock::now();
+  connector.async_connect(to_iterator(v), socket,
+      [&result, start](const boost::system::error_code &ec) {
+        result.called  = true;
+        result.ec      = ec;
+        result.elapsed = chrono::duration_cast<chrono::milliseconds>(
+            chrono::steady_clock::now() - start);
+      });
+}
+
+BOOST_AUTO_TEST_SUITE( connector )
+
+  BOOST_AUTO_TEST_CASE( interleave )
+  {
+    vector<asio::ip::tcp::endpoint> v = {
+      ep("2001:db8::1"), ep("2001:db8::2"), ep("2001:db8::3"),
+      ep("192.0.2.1"), ep("192.0.2.2")
+    };
+    Net::TCP::Connector::interleave(v);
+    vector<asio::ip::tcp::endpoint> ref = {
+      ep("2001:db8::1"), ep("192.0.2.1"), ep("2001:db8::2"),
+      ep("192.0.2.2"), ep("2001:db8::3")
+    };
+    BOOST_CHECK(v == ref);
+  }
+
+  BOOST_AUTO_TEST_CASE( interleave_v4_first )
+  {
+    vector<asio::ip::tcp::endpoint> v = {
+      ep("192.0.2.1"), ep("2001:db8::1"), ep("2001:db8::2")
+    };
+    Net::TCP::Connector::interleave(v);
+    vector<asio::ip::tcp::endpoint> ref = {
+      ep("192.0.2.1"), ep("2001:db8::1"), ep("2001:db8::2")
+    };
+    BOOST_CHECK(v == ref);
+  }
+
+  BOOST_AUTO_TEST_CASE( interleave_single_family )
+  {
+    vector<asio::ip::tcp::endpoint> v = {
+      ep("192.0.2.3"), ep("192.0.2.1"), ep("192.0.2.2")
+    };
+    auto ref = v;
+    Net::TCP::Connector::interleave(v);
+    BOOST_CHECK(v == ref);
+    v.clear();
+    Net::TCP::Connector::interleave(v);
+    BOOST_CHECK(v.empty());
+  }
+
+  // the next attempt starts immediately when one is refused - and not
+  // only after connect_delay
+  BOOST_AUTO_TEST_CASE( fallback_after_refused )
+  {
+    asio::io_service io_service;
+    asio::ip::tcp::acceptor listener(io_service,
+        asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    vector<asio::ip::tcp::endpoint> v = {
+      refused_endpoint(io_service), listener.local_endpoint()
+    };
+    Net::TCP::Client::Options opts;
+    opts.connect_delay = 10000;
+    boost::log::sources::severity_logger<Log::Severity> lg;
+    Net::TCP::Connector connector(io_service, opts, lg);
+    asio::ip::tcp::socket socket(io_service);
+    Connect_Result r;
+    async_connect(connector, v, socket, r);
+    io_service.run();
+    BOOST_REQUIRE(r.called);
+    BOOST_CHECK(!r.ec);
+    BOOST_CHECK(socket.remote_endpoint() == listener.local_endpoint());
+    BOOST_CHECK(r.elapsed < chrono::milliseconds(5000));
+  }
+
+  BOOST_AUTO_TEST_CASE( all_refused )
+  {
+    asio::io_service io_service;
+    vector<asio::ip::tcp::endpoint> v = {
+      refused_endpoint(io_service), refused_endpoint(io_service)
+    };
+    Net::TCP::Client::Options opts;
+    boost::log::sources::severity_logger<Log::Severity> lg;
+    Net::TCP::Connector connector(io_service, opts, lg);
+    asio::ip::tcp::socket socket(io_service);
+    Connect_Result r;
+    async_connect(connector, v, socket, r);
+    io_service.run();
+    BOOST_REQUIRE(r.called);
+    BOOST_CHECK(r.ec == asio::error::connection_refused);
+    BOOST_CHECK(!socket.is_open());
+  }
+
+  // the second attempt starts after connect_delay while the first one
+  // still hangs, it wins, and the first one is cancelled - otherwise
+  // run() wouldn't return before the kernel connect timeout
+  BOOST_AUTO_TEST_CASE( staggered )
+  {
+    asio::io_service io_service;
+    Stalled_Listener stalled(io_service);
+    if (!stalled.fill()) {
+      BOOST_TEST_MESSAGE("can't stall connects - skipping");
+      return;
+    }
+    asio::ip::tcp::acceptor listener(io_service,
+        asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    vector<asio::ip::tcp::endpoint> v = {
+      stalled.acceptor.local_endpoint(), listener.local_endpoint()
+    };
+    Net::TCP::Client::Options opts;
+    opts.connect_delay = 100;
+    boost::log::sources::severity_logger<Log::Severity> lg;
+    Net::TCP::Connector connector(io_service, opts, lg);
+    asio::ip::tcp::socket socket(io_service);
+    Connect_Result r;
+    auto start = chrono::steady_clock::now();
+    async_connect(connector, v, socket, r);
+    io_service.run();
+    auto d = chrono::steady_clock::now() - start;
+    BOOST_REQUIRE(r.called);
+    BOOST_CHECK(!r.ec);
+    BOOST_CHECK(socket.remote_endpoint() == listener.local_endpoint());
+    BOOST_CHECK(r.elapsed >= chrono::milliseconds(100));
+    BOOST_CHECK(d < chrono::seconds(5));
+  }
+
+  BOOST_AUTO_TEST_CASE( cancel )
+  {
+    asio::io_service io_service;
+    Stalled_Listener stalled(io_service);
+    if (!stalled.fill()) {
+      BOOST_TEST_MESSAGE("can't stall connects - skipping");
+      return;
+    }
+    vector<asio::ip::tcp::endpoint> v = { stalled.acceptor.local_endpoint() };
+    Net::TCP::Client::Options opts;
+    opts.connect_delay = 50;
+    boost::log::sources::severity_logger<Log::Severity> lg;
+    Net::TCP::Connector connector(io_service, opts, lg);
+    asio::ip::tcp::socket socket(io_service);
+    Connect_Result r;
+    async_connect(connector, v, socket, r);
+    asio::basic_waitable_timer<chrono::steady_clock> timer(io_service);
+    timer.expires_from_now(chrono::milliseconds(100));
+    timer.async_wait([&connector](const boost::system::error_code &ec) {
+        if (!ec)
+          connector.cancel();
+        });
+    auto start = chrono::steady_clock::now();
+    io_service.run();
+    BOOST_REQUIRE(r.called);
+    BOOST_CHECK(r.ec == asio::error::operation_aborted);
+    BOOST_CHECK(!socket.is_open());
+    BOOST_CHECK(chrono::steady_clock::now() - start < chrono::seconds(5));
+  }
+
+  // the pending handlers must not touch the destroyed Connector
+  BOOST_AUTO_TEST_CASE( destroy_pending )
+  {
+    asio::io_service io_service;
+    Stalled_Listener stalled(io_service);
+    if (!stalled.fill()) {
+      BOOST_TEST_MESSAGE("can't stall connects - skipping");
+      return;
+    }
+    vector<asio::ip::tcp::endpoint> v = {
+      stalled.acceptor.local_endpoint(), stalled.acceptor.local_endpoint()
+    };
+    Net::TCP::Client::Options opts;
+    opts.connect_delay = 50;
+    boost::log::sources::severity_logger<Log::Severity> lg;
+    unique_ptr<Net::TCP::Connector> connector(
+        new Net::TCP::Connector(io_service, opts, lg));
+    asio::ip::tcp::socket socket(io_service);
+    Connect_Result r;
+    async_connect(*connector, v, socket, r);
+    asio::basic_waitable_timer<chrono::steady_clock> timer(io_service);
+    timer.expires_from_now(chrono::milliseconds(100));
+    timer.async_wait([&connector](const boost::system::error_code &) {
+        connector.reset();
+        });
+    io_service.run();
+    BOOST_CHECK(!connector);
+    BOOST_CHECK(!r.called);
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
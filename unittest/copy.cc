@@ -25,7 +25,9 @@ namespace fs = boost::filesystem;
 
 #include <copy/client.h>
 #include <copy/options.h>
+#include <copy/accounts.h>
 #include <example/server.h>
+#include <net/loopback_client.h>
 #include <net/ssl_util.h>
 using namespace Net::SSL;
 
@@ -40,6 +42,7 @@ using namespace ixxx;
 #include <thread>
 #include <chrono>
 #include <memory>
+#include <vector>
 #include <stdexcept>
 
 #include "config.h"
@@ -230,6 +233,62 @@ static void test_basic(bool use_ssl)
 }
 
 
+// same session as test_basic(), but without sockets and threads
+static void test_basic_loopback()
+{
+    string maildir{"tmp/cp/loopbackmd"};
+    fs::remove_all(maildir);
+
+    string prefix(ut_prefix());
+    prefix += '/';
+    string configfile{prefix+"cp.conf"};
+    char cconfigfile[128] = {0};
+    strncpy(cconfigfile, configfile.c_str(), sizeof(cconfigfile)-1);
+    char *argv[] = {
+      (char*)"imapcp",
+      (char*)"--account", (char*)"fake",
+      (char*)"--log", (char*)"ut_cp_loopback.log", (char*)"--log_v",
+      (char*)"--maildir", (char*)"tmp/cp/loopbackmd",
+      (char*)"-v6",
+      (char*)"--config", cconfigfile,
+      (char*)"--ssl", (char*)"no",
+      0
+    };
+    int argc = sizeof(argv)/sizeof(char*)-1;
+
+    IMAP::Copy::Options opts(argc, argv);
+    boost::log::sources::severity_logger<Log::Severity> lg(Log::create(
+          static_cast<Log::Severity>(opts.severity),
+          static_cast<Log::Severity>(opts.file_severity),
+          opts.logfile));
+    Net::Loopback::Client::Options net_opts;
+    net_opts.severity      = opts.severity;
+    net_opts.file_severity = opts.file_severity;
+    net_opts.script        = prefix + "cp_basic.trace";
+    boost::asio::io_service io_service;
+    Net::Loopback::Client::Base net_client(io_service, net_opts, lg);
+    {
+      IMAP::Copy::Client client(opts, net_client, lg);
+      io_service.run();
+    }
+    BOOST_CHECK(net_client.finished());
+
+    set<string> sums;
+    fs::directory_iterator begin(maildir + "/new");
+    fs::directory_iterator end;
+    for (auto i = begin; i != end; ++i) {
+      string t{(*i).path().generic_string()};
+      string sum{sha256_sum(t)};
+      sums.insert(sum);
+    }
+    array<const char*, 3> ref = {{
+      "6a8c8af376177fad7261d487fac2f5ebfa977820420470841335f6cbe9cb0bfa",
+      "a456fb5e0073393d887806c852d775b9eb8276c6a0d7ee3b3345bfe1a5e1658a",
+      "cb48864719e554c91fbf77849d06b8c8b23107eabe932d05cd332ce21f868d5b"
+    }};
+    BOOST_CHECK_EQUAL_COLLECTIONS(sums.begin(), sums.end(), ref.begin(), ref.end());
+}
+
 static void test_logindisabled()
 {
   bool use_ssl = false;
@@ -407,7 +466,7 @@ static void test_fetch_header()
     Log::setup_vanilla_file(Log::MSG, filename);
     client.run();
   }
-  boost::log::core::get()->remove_all_sinks();
+  Log::finish();
 
   replay_server.join();
   BOOST_CHECK_EQUAL(rc, 0);
@@ -462,7 +521,7 @@ static void test_list()
   } catch (const exception &e) {
     cerr << "Client frontend failed with: " << e.what() << '\n';
   }
-  boost::log::core::get()->remove_all_sinks();
+  Log::finish();
 
   replay_server.join();
   BOOST_CHECK_EQUAL(rc, 0);
@@ -482,6 +541,106 @@ R"([MSG] Mailbox: -  INBOX
   BOOST_CHECK_EQUAL(buffer.data(), ref);
 }
 
+static string write_accounts_rc(const string &dir, bool same_journal)
+{
+  fs::create_directories(dir);
+  string rc(dir + "/rc.json");
+  ofstream f(rc);
+  f << "{\n  \"_comment\": \"ignored\",\n";
+  const char *names[] = { "one", "two" };
+  for (unsigned i = 0; i < 2; ++i) {
+    f << "  \"" << names[i] << "\":\n  {\n"
+      << "    \"username\" : \"juser123\",\n"
+      << "    \"password\" : \"muchvery\",\n"
+      << "    \"host\"     : \"host" << i << ".example.org\",\n";
+    if (same_journal)
+      f << "    \"journal\"  : \"" << dir << "/journal\",\n";
+    f << "    \"maildir\"  : \"" << dir << '/' << names[i] << "\"\n"
+      << "  }" << (i ? "\n" : ",\n");
+  }
+  f << "}\n";
+  return rc;
+}
+
+static void test_accounts()
+{
+  string dir("tmp/cp/accounts");
+  string rc(write_accounts_rc(dir, false));
+  char *argv[] = {
+    (char*)"imapdl", (char*)"--all_accounts",
+    (char*)"--config", (char*)rc.c_str(),
+    (char*)"-v0",
+    (char*)"--max_sessions", (char*)"3",
+    0
+  };
+  int argc = sizeof(argv)/sizeof(char*)-1;
+
+  IMAP::Copy::Options opts(argc, argv);
+  BOOST_CHECK(opts.multi());
+  BOOST_CHECK_EQUAL(opts.max_sessions, 3u);
+  auto names = opts.account_list();
+  vector<string> ref = { "one", "two" };
+  BOOST_CHECK_EQUAL_COLLECTIONS(names.begin(), names.end(),
+      ref.begin(), ref.end());
+
+  IMAP::Copy::Options one(argc, argv, "one");
+  IMAP::Copy::Options two(argc, argv, "two");
+  BOOST_CHECK_EQUAL(one.account, "one");
+  BOOST_CHECK_EQUAL(one.host, "host0.example.org");
+  BOOST_CHECK_EQUAL(two.host, "host1.example.org");
+  BOOST_CHECK_EQUAL(two.maildir, dir + "/two");
+  BOOST_CHECK(one.journal_file != two.journal_file);
+
+  boost::log::sources::severity_logger<Log::Severity> lg(Log::create(
+        static_cast<Log::Severity>(opts.severity),
+        static_cast<Log::Severity>(opts.file_severity),
+        opts.logfile));
+  IMAP::Copy::Accounts accounts(argc, argv, opts, lg);
+  BOOST_CHECK_EQUAL(accounts.results().size(), 2u);
+
+  {
+    char *argv[] = {
+      (char*)"imapdl", (char*)"--accounts", (char*)"two",
+      (char*)"--config", (char*)rc.c_str(),
+      (char*)"-v0",
+      (char*)"--pipeline", (char*)"2",
+      0
+    };
+    int argc = sizeof(argv)/sizeof(char*)-1;
+    IMAP::Copy::Options opts(argc, argv);
+    auto names = opts.account_list();
+    BOOST_CHECK_EQUAL(names.size(), 1u);
+    BOOST_CHECK_THROW(IMAP::Copy::Accounts(argc, argv, opts, lg),
+        std::exception);
+  }
+
+  string same_rc(write_accounts_rc(dir + "/same", true));
+  argv[3] = (char*)same_rc.c_str();
+  IMAP::Copy::Options same(argc, argv);
+  BOOST_CHECK_THROW(IMAP::Copy::Accounts(argc, argv, same, lg),
+      std::exception);
+
+  {
+    char *argv[] = {
+      (char*)"imapdl", (char*)"--poll",
+      (char*)"--account", (char*)"two",
+      (char*)"--config", (char*)rc.c_str(),
+      (char*)"-v0",
+      (char*)"--interval", (char*)"60",
+      0
+    };
+    int argc = sizeof(argv)/sizeof(char*)-1;
+    IMAP::Copy::Options opts(argc, argv);
+    BOOST_CHECK(opts.multi());
+    auto names = opts.account_list();
+    BOOST_REQUIRE_EQUAL(names.size(), 1u);
+    BOOST_CHECK_EQUAL(names.front(), "two");
+    IMAP::Copy::Options two(argc, argv, "two");
+    BOOST_CHECK_EQUAL(two.interval, 60u);
+    BOOST_CHECK_EQUAL(two.max_interval, 3600u);
+  }
+}
+
 struct Log_Fixture {
   boost::log::sources::severity_logger<Log::Severity> lg;
   Log_Fixture()
@@ -495,7 +654,7 @@ struct Log_Fixture {
   }
   ~Log_Fixture() {
     BOOST_LOG(lg) <<  "teardown fixture" ;
-    boost::log::core::get()->remove_all_sinks();
+    Log::finish();
   }
 
 };
@@ -509,39 +668,70 @@ BOOST_AUTO_TEST_SUITE( copy )
   BOOST_AUTO_TEST_CASE( basic )
   {
     //test_basic(lg, true);
-    boost::log::core::get()->remove_all_sinks();
+    Log::finish();
     test_basic(true);
   }
 
   BOOST_AUTO_TEST_CASE( basic_no_ssl )
   {
     //test_basic(lg, false);
-    boost::log::core::get()->remove_all_sinks();
+    Log::finish();
     test_basic(false);
   }
 
+  BOOST_AUTO_TEST_CASE( basic_loopback )
+  {
+    Log::finish();
+    test_basic_loopback();
+  }
+
   BOOST_AUTO_TEST_CASE( logindisabled )
   {
-    boost::log::core::get()->remove_all_sinks();
+    Log::finish();
     test_logindisabled();
   }
 
   BOOST_AUTO_TEST_CASE(partial)
   {
-    boost::log::core::get()->remove_all_sinks();
+    Log::finish();
     test_partial_1(true);
-    boost::log::core::get()->remove_all_sinks();
+    Log::finish();
     test_partial_2(true);
   }
   BOOST_AUTO_TEST_CASE(fetch_header)
   {
-    boost::log::core::get()->remove_all_sinks();
+    Log::finish();
     test_fetch_header();
   }
   BOOST_AUTO_TEST_CASE(list)
   {
-    boost::log::core::get()->remove_all_sinks();
+    Log::finish();
     test_list();
   }
+  BOOST_AUTO_TEST_CASE(accounts)
+  {
+    Log::finish();
+    test_accounts();
+  }
+  // the server greets first, thus the deferred SYN would never be sent
+  BOOST_AUTO_TEST_CASE(fast_open_requires_ssl)
+  {
+    string configfile{ut_prefix() + "/cp.conf"};
+    char cconfigfile[128] = {0};
+    strncpy(cconfigfile, configfile.c_str(), sizeof(cconfigfile)-1);
+    char *argv[] = {
+      (char*)"imapcp",
+      (char*)"--account", (char*)"fake",
+      (char*)"--config", cconfigfile,
+      (char*)"--ssl", (char*)"no",
+      (char*)"--fast_open",
+      0
+    };
+    int argc = sizeof(argv)/sizeof(char*)-1;
+    BOOST_CHECK_THROW(IMAP::Copy::Options(argc, argv), std::runtime_error);
+    argv[6] = (char*)"yes";
+    IMAP::Copy::Options opts(argc, argv);
+    BOOST_CHECK(opts.fast_open);
+  }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -32,6 +32,8 @@ namespace fs = boost::filesystem;
 #include <unordered_set>
 #include <set>
 #include <iostream>
+#include <sstream>
+#include <algorithm>
 
 #include <imap/client_parser.h>
 #include <imap/imap.h>
@@ -1128,6 +1130,64 @@ BOOST_AUTO_TEST_SUITE( imap_client_parser )
       }
     }
 
+    BOOST_AUTO_TEST_CASE( literal_sink )
+    {
+      using namespace IMAP::Server::Response;
+      const string body =
+        "Subject: hello\r\n"
+        "\r\n"
+        "{3}\r\nabc) a4 OK\r\n";
+      ostringstream o;
+      o << "* 1 FETCH (UID 42 BODY[] {" << body.size() << "}\r\n" << body
+        << " FLAGS (\\Seen))\r\n"
+        << "a4 OK Fetch completed.\r\n";
+      const string response(o.str());
+
+      struct CB : public IMAP::Client::Callback::Null {
+        Memory::Buffer::Vector buffer;
+        Memory::Buffer::Vector tag_buffer;
+        string data;
+        vector<unsigned> a;
+        CB() : a(4) {}
+        void imap_uid(uint32_t number) override
+        {
+          ++a[0];
+          BOOST_CHECK_EQUAL(number, 42);
+        }
+        void imap_body_section_end() override
+        {
+          ++a[1];
+        }
+        void imap_flag(Flag flag) override
+        {
+          ++a[2];
+          BOOST_CHECK_EQUAL(flag, IMAP::Flag::SEEN);
+        }
+        void imap_tagged_status_end(Status c) override
+        {
+          ++a[3];
+          BOOST_CHECK_EQUAL(c, Status::OK);
+        }
+        void imap_literal_data(const char *begin, const char *end) override
+        {
+          data.append(begin, end);
+        }
+      };
+      for (size_t k : { size_t(1), size_t(3), size_t(17), response.size() }) {
+        CB cb;
+        IMAP::Client::Parser p(cb.buffer, cb.tag_buffer, cb);
+        p.set_literal_sink(true);
+        const char *begin = response.data();
+        const char *end   = begin + response.size();
+        for (const char *x = begin; x < end; x += k)
+          p.read(x, x + min(k, size_t(end - x)));
+        BOOST_CHECK_EQUAL(cb.data, body);
+        for (unsigned i = 0; i < 4; ++i)
+          BOOST_CHECK_EQUAL(cb.a[i], 1);
+        BOOST_CHECK(p.finished());
+      }
+    }
+
   BOOST_AUTO_TEST_SUITE_END();
 
 
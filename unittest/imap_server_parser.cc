@@ -23,6 +23,10 @@
 #include <imap/server_parser.h>
 #include <imap/imap.h>
 
+#include <sstream>
+#include <string>
+#include <vector>
+
 using namespace std;
 
 using namespace Memory;
@@ -257,6 +261,115 @@ BOOST_AUTO_TEST_SUITE( imap_server_parser )
       BOOST_CHECK_EQUAL(p.finished(), true);
     }
 
+    BOOST_AUTO_TEST_CASE( command_callbacks )
+    {
+      const char inp[] =
+        "a1 capability\r\n"
+        "a2 login juser secrectvery\r\n"
+        "a3 select \"INBOX\"\r\n"
+        "a4 UID fetch 1:*,7,9:3 (UID FLAGS"
+          " BODY.PEEK[HEADER.FIELDS (date from subject)] BODY.PEEK[])\r\n"
+        "a5 fetch 2 fast\r\n"
+        "a6 uid store 4 +FLAGS.SILENT (\\Deleted \\Seen)\r\n"
+        "a7 uid expunge 4\r\n"
+        "a8 logout\r\n"
+        ;
+      const char *begin = inp;
+      const char *end   = inp + sizeof(inp)-1;
+      using namespace IMAP::Server;
+      Buffer::Vector buffer;
+      Buffer::Vector tag_buffer;
+      struct CB : public Callback::Null {
+        Buffer::Vector &buffer;
+        Buffer::Vector &tag_buffer;
+        vector<string> log;
+        CB(Buffer::Vector &buffer, Buffer::Vector &tag_buffer)
+          : buffer(buffer), tag_buffer(tag_buffer) {}
+        string tag() const
+        {
+          return string(tag_buffer.begin(), tag_buffer.end());
+        }
+        void imapd_capability() override
+        {
+          log.push_back(tag() + " capability");
+        }
+        bool imapd_select(const Memory::Buffer::Base & /* mailbox */,
+            bool read_only) override
+        {
+          BOOST_CHECK_EQUAL(read_only, false);
+          log.push_back(tag() + " select "
+              + string(buffer.begin(), buffer.end()));
+          return true;
+        }
+        void imapd_fetch(bool uid, const Sequence_Ranges &set,
+            const std::vector<Fetch_Attribute> &atts) override
+        {
+          ostringstream o;
+          o << tag() << " fetch " << uid;
+          for (auto &r : set)
+            o << ' ' << r.first << ':' << r.second;
+          for (auto &a : atts) {
+            o << ' ' << a.fetch << '/' << unsigned(a.section);
+            for (auto &h : a.headers)
+              o << '/' << h;
+          }
+          log.push_back(o.str());
+        }
+        void imapd_store(bool uid, const Sequence_Ranges &set,
+            IMAP::Client::Store_Mode mode, bool silent,
+            const std::vector<IMAP::Flag> &flags) override
+        {
+          BOOST_CHECK_EQUAL(uid, true);
+          BOOST_REQUIRE_EQUAL(set.size(), 1u);
+          BOOST_CHECK_EQUAL(set.front().first, 4u);
+          BOOST_CHECK(mode == IMAP::Client::Store_Mode::ADD);
+          BOOST_CHECK_EQUAL(silent, true);
+          BOOST_REQUIRE_EQUAL(flags.size(), 2u);
+          BOOST_CHECK(flags[0] == IMAP::Flag::DELETED);
+          BOOST_CHECK(flags[1] == IMAP::Flag::SEEN);
+          log.push_back(tag() + " store");
+        }
+        void imapd_expunge(bool uid, const Sequence_Ranges &set) override
+        {
+          BOOST_CHECK_EQUAL(uid, true);
+          BOOST_CHECK_EQUAL(set.size(), 1u);
+          log.push_back(tag() + " expunge");
+        }
+        void imapd_logout() override
+        {
+          log.push_back(tag() + " logout");
+        }
+        void imapd_command_end() override
+        {
+          log.push_back(tag() + " end");
+        }
+      };
+      CB cb(buffer, tag_buffer);
+      Parser p(buffer, tag_buffer, cb);
+      p.read(begin, end);
+      BOOST_CHECK_EQUAL(p.finished(), true);
+      const char * const ref[] = {
+        "a1 capability",
+        "a1 end",
+        "a2 end",
+        "a3 select INBOX",
+        "a3 end",
+        "a4 fetch 1 1:4294967295 7:7 3:9 UID/0 FLAGS/0"
+          " BODY.PEEK/2/date/from/subject BODY.PEEK/0",
+        "a4 end",
+        "a5 fetch 0 2:2 FLAGS/0 INTERNALDATE/0 RFC822.SIZE/0",
+        "a5 end",
+        "a6 store",
+        "a6 end",
+        "a7 expunge",
+        "a7 end",
+        "a8 logout",
+        "a8 end"
+      };
+      BOOST_CHECK_EQUAL_COLLECTIONS(cb.log.begin(), cb.log.end(),
+          ref, ref + sizeof(ref)/sizeof(ref[0]));
+    }
+
   BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_SUITE_END()
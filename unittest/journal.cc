@@ -0,0 +1,136 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+
+#include <copy/journal.h>
+#include <sequence_set.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <utility>
+using namespace std;
+
+typedef vector<pair<uint32_t, uint32_t> > Runs;
+
+BOOST_AUTO_TEST_SUITE( journal )
+
+  BOOST_AUTO_TEST_CASE( roundtrip )
+  {
+    const char filename[] = "tmp/journal.roundtrip";
+    fs::create_directory("tmp");
+    Sequence_Set set;
+    for (uint32_t i : { 1u, 2u, 3u, 7u, 300u, 301u, 100000u })
+      set.push(i);
+    IMAP::Copy::Journal a("INBOX", 4223, set);
+    a.write(filename);
+    IMAP::Copy::Journal b;
+    b.read(filename);
+    BOOST_CHECK_EQUAL(b.mailbox_, "INBOX");
+    BOOST_CHECK_EQUAL(b.uidvalidity_, 4223u);
+    Runs r = { {1, 3}, {7, 7}, {300, 301}, {100000, 100000} };
+    BOOST_CHECK(b.uids_ == r);
+    BOOST_CHECK(!fs::exists(string(filename) + ".tmp"));
+  }
+
+  BOOST_AUTO_TEST_CASE( append )
+  {
+    const char filename[] = "tmp/journal.append";
+    fs::create_directory("tmp");
+    fs::remove(filename);
+    {
+      IMAP::Copy::Journal_Writer w;
+      w.open(filename);
+      w.push("INBOX", 23, 10);
+      w.push("INBOX", 23, 11);
+      w.push("INBOX", 23, 13);
+      w.sync();
+    }
+    {
+      IMAP::Copy::Journal_Writer w;
+      w.open(filename);
+      w.push("INBOX", 23, 12);
+      w.sync();
+    }
+    IMAP::Copy::Journal j;
+    j.read(filename);
+    BOOST_CHECK_EQUAL(j.mailbox_, "INBOX");
+    BOOST_CHECK_EQUAL(j.uidvalidity_, 23u);
+    Runs r = { {10, 11}, {13, 13}, {12, 12} };
+    BOOST_CHECK(j.uids_ == r);
+  }
+
+  BOOST_AUTO_TEST_CASE( clear_and_switch )
+  {
+    const char filename[] = "tmp/journal.clear";
+    fs::create_directory("tmp");
+    fs::remove(filename);
+    IMAP::Copy::Journal_Writer w;
+    w.open(filename);
+    w.push("INBOX", 1, 5);
+    w.clear();
+    w.push("INBOX", 1, 6);
+    w.push("INBOX", 2, 1);
+    w.close();
+    IMAP::Copy::Journal j;
+    j.read(filename);
+    BOOST_CHECK_EQUAL(j.uidvalidity_, 2u);
+    Runs r = { {1, 1} };
+    BOOST_CHECK(j.uids_ == r);
+  }
+
+  BOOST_AUTO_TEST_CASE( torn_tail )
+  {
+    const char filename[] = "tmp/journal.torn";
+    fs::create_directory("tmp");
+    fs::remove(filename);
+    {
+      IMAP::Copy::Journal_Writer w;
+      w.open(filename);
+      w.push("INBOX", 42, 1);
+      w.push("INBOX", 42, 2);
+      w.push("INBOX", 42, 3);
+    }
+    // simulate a crash in the middle of the last record
+    fs::resize_file(filename, fs::file_size(filename) - 2);
+    IMAP::Copy::Journal j;
+    j.read(filename);
+    Runs r = { {1, 2} };
+    BOOST_CHECK(j.uids_ == r);
+  }
+
+  BOOST_AUTO_TEST_CASE( short_garbage )
+  {
+    const char filename[] = "tmp/journal.short";
+    fs::create_directory("tmp");
+    {
+      ofstream f(filename, ofstream::binary);
+      f << "imXp";
+    }
+    // shorter than the magic, but not a prefix of it - thus no
+    // journal, taken as legacy archive that doesn't parse either
+    IMAP::Copy::Journal j;
+    BOOST_CHECK_THROW(j.read(filename), std::exception);
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
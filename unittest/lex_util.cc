@@ -80,6 +80,22 @@ BOOST_AUTO_TEST_SUITE( lex_util )
       BOOST_CHECK_EQUAL(o.str(), "hello\\x0aworld  33");
     }
 
+    BOOST_AUTO_TEST_CASE(bytes)
+    {
+      ostringstream o;
+      const char inp[] = "hello\nworld";
+      o << Safe_Bytes(inp, sizeof(inp)-1);
+      BOOST_CHECK_EQUAL(o.str(), "hello\\x0aworld");
+    }
+
+    BOOST_AUTO_TEST_CASE(bytes_prefix)
+    {
+      ostringstream o;
+      const char inp[] = "hello\nworld";
+      o << '|' << Safe_Bytes(inp, sizeof(inp)-1, 6) << '|';
+      BOOST_CHECK_EQUAL(o.str(), "|hello\\x0a... (5 more bytes)|");
+    }
+
   BOOST_AUTO_TEST_SUITE_END()
 
   BOOST_AUTO_TEST_SUITE(tle)
@@ -0,0 +1,138 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <net/loopback_client.h>
+#include <trace/trace.h>
+
+#include <boost/asio.hpp>
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace asio = boost::asio;
+namespace fs = boost::filesystem;
+
+static void write_script(const string &filename)
+{
+  fs::create_directories("tmp");
+  Trace::Writer w(filename);
+  vector<pair<Trace::Type, string> > records = {
+    { Trace::Type::MARK,       "connect" },
+    { Trace::Type::RECEIVED,   "* OK hello\r\n" },
+    { Trace::Type::SENT,       "a1 NOOP\r\n" },
+    { Trace::Type::RECEIVED,   "a1 OK done\r\n" },
+    { Trace::Type::DISCONNECT, "" }
+  };
+  for (auto &r : records) {
+    Trace::Record_View v;
+    v.type  = r.first;
+    v.begin = r.second.data();
+    v.end   = r.second.data() + r.second.size();
+    w.push(v);
+  }
+  w.finish();
+}
+
+namespace {
+
+  struct Session {
+    asio::io_service io_service;
+    boost::log::sources::severity_logger<Log::Severity> lg;
+    Net::Loopback::Client::Options opts;
+    unique_ptr<Net::Loopback::Client::Base> client;
+    string received;
+    bool eof {false};
+    function<void(const boost::system::error_code &, size_t)> read_fn;
+
+    Session(const string &script)
+    {
+      opts.script = script;
+      client = unique_ptr<Net::Loopback::Client::Base>(
+          new Net::Loopback::Client::Base(io_service, opts, lg));
+      read_fn = [this](const boost::system::error_code &ec, size_t size) {
+        if (ec) {
+          eof = ec == asio::error::eof;
+          return;
+        }
+        received.append(client->input().data(), size);
+        client->async_read_some(read_fn);
+      };
+    }
+    void start(function<void()> fn)
+    {
+      client->async_resolve([this, fn](const boost::system::error_code &ec,
+            asio::ip::tcp::resolver::iterator iterator) {
+          BOOST_REQUIRE(!ec);
+          client->async_connect(iterator, [this, fn](const boost::system::error_code &ec) {
+            BOOST_REQUIRE(!ec);
+            BOOST_CHECK(client->is_open());
+            client->async_read_some(read_fn);
+            fn();
+            });
+          });
+    }
+  };
+
+}
+
+BOOST_AUTO_TEST_SUITE( loopback )
+
+  BOOST_AUTO_TEST_CASE( script )
+  {
+    string filename("tmp/loopback.trace");
+    write_script(filename);
+    Session s(filename);
+    vector<char> cmd = { 'a', '1', ' ', 'N', 'O', 'O', 'P', '\r', '\n' };
+    s.start([&s, &cmd]() {
+        // split over two writes, before the greeting was read
+        s.client->async_write(cmd.data(), 3,
+          [](const boost::system::error_code &ec, size_t) { BOOST_CHECK(!ec); });
+        s.client->async_write(cmd.data() + 3, cmd.size() - 3,
+          [](const boost::system::error_code &ec, size_t) { BOOST_CHECK(!ec); });
+        });
+    s.io_service.run();
+    BOOST_CHECK_EQUAL(s.received, "* OK hello\r\na1 OK done\r\n");
+    BOOST_CHECK(s.eof);
+    BOOST_CHECK(s.client->finished());
+    BOOST_CHECK_EQUAL(s.client->bytes_read(), s.received.size());
+  }
+
+  BOOST_AUTO_TEST_CASE( mismatch )
+  {
+    string filename("tmp/loopback.trace");
+    write_script(filename);
+    Session s(filename);
+    s.start([&s]() {
+        const char cmd[] = "a1 LOGOUT\r\n";
+        s.client->async_write(cmd, sizeof cmd - 1,
+          [](const boost::system::error_code &, size_t) {});
+        });
+    BOOST_CHECK_THROW(s.io_service.run(), std::runtime_error);
+    BOOST_CHECK(!s.client->finished());
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
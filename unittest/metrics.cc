@@ -0,0 +1,85 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+
+#include <copy/metrics.h>
+
+#include <chrono>
+#include <sstream>
+#include <string>
+using namespace std;
+
+using IMAP::Copy::Metrics;
+
+BOOST_AUTO_TEST_SUITE( metrics )
+
+  BOOST_AUTO_TEST_CASE( histogram )
+  {
+    Metrics::Histogram h({ 10, 100 });
+    for (double v : { 1.0, 10.0, 11.0, 1000.0 })
+      h.observe(v);
+    ostringstream o;
+    h.print_prometheus(o, "x", "Some values.");
+    const char ref[] =
+R"(# HELP x Some values.
+# TYPE x histogram
+x_bucket{le="10"} 2
+x_bucket{le="100"} 3
+x_bucket{le="+Inf"} 4
+x_sum 1022
+x_count 4
+)";
+    BOOST_CHECK_EQUAL(o.str(), ref);
+  }
+
+  BOOST_AUTO_TEST_CASE( prometheus )
+  {
+    Metrics m;
+    m.set_bytes(4096, 100);
+    m.delivered(2000, chrono::milliseconds(3), chrono::milliseconds(2));
+    m.add_phase(Metrics::Phase::FETCH, chrono::milliseconds(1500));
+    m.set_journal_replay(7);
+    ostringstream o;
+    m.print_prometheus(o);
+    string s(o.str());
+    BOOST_CHECK(s.find("\nimapdl_bytes_read_total 4096\n") != string::npos);
+    BOOST_CHECK(s.find("\nimapdl_messages_total 1\n") != string::npos);
+    BOOST_CHECK(s.find("\nimapdl_journal_replay_uids 7\n") != string::npos);
+    BOOST_CHECK(s.find("\nimapdl_phase_seconds_total{phase=\"fetch\"} 1.5\n")
+        != string::npos);
+    BOOST_CHECK(s.find("\nimapdl_message_size_bytes_bucket{le=\"1024\"} 0\n"
+          "imapdl_message_size_bytes_bucket{le=\"4096\"} 1\n") != string::npos);
+    BOOST_CHECK(s.find("\nimapdl_fsync_seconds_sum 0.002\n") != string::npos);
+  }
+
+  BOOST_AUTO_TEST_CASE( json )
+  {
+    Metrics m;
+    m.delivered(100, chrono::milliseconds(1), chrono::milliseconds(1));
+    ostringstream o;
+    m.print_json(o);
+    string s(o.str());
+    BOOST_CHECK(s.find("\"messages\": 1,") != string::npos);
+    BOOST_CHECK(s.find("\"message_size_bytes\": { \"count\": 1, \"sum\": 100,"
+          " \"buckets\": [ [1024, 1],") != string::npos);
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,69 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+
+#include <perf/stages.h>
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <chrono>
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE( perf )
+
+  BOOST_AUTO_TEST_CASE( nested )
+  {
+    Perf::Stages stages;
+    {
+      Perf::Scope a(&stages, Perf::Stage::PARSE);
+      Perf::Scope b(&stages, Perf::Stage::MAILDIR_MOVE);
+      this_thread::sleep_for(chrono::milliseconds(20));
+    }
+    ostringstream o;
+    stages.print(o, 1);
+    string s(o.str());
+    // the sleep is attributed to the inner stage only
+    auto parse = s.find("parse");
+    auto move = s.find("maildir move");
+    BOOST_REQUIRE(parse != string::npos);
+    BOOST_REQUIRE(move != string::npos);
+    istringstream p(s.substr(parse + 5)), m(s.substr(move + 12));
+    double parse_ms = 0, move_ms = 0;
+    p >> parse_ms;
+    m >> move_ms;
+    BOOST_CHECK(move_ms >= 19);
+    BOOST_CHECK(parse_ms < 19);
+  }
+
+  BOOST_AUTO_TEST_CASE( disabled )
+  {
+    Perf::Scope a(nullptr, Perf::Stage::PARSE);
+  }
+
+  BOOST_AUTO_TEST_CASE( unbalanced )
+  {
+    Perf::Stages stages;
+    BOOST_CHECK_THROW(stages.leave(), logic_error);
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
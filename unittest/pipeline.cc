@@ -0,0 +1,105 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+
+#include <net/pipeline.h>
+#include <net/tcp_client.h>
+
+#include <boost/asio.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace asio = boost::asio;
+
+BOOST_AUTO_TEST_SUITE( pipeline )
+
+  BOOST_AUTO_TEST_CASE( loopback )
+  {
+    string data(1024 * 1024 + 3, 0);
+    for (size_t i = 0; i < data.size(); ++i)
+      data[i] = char(i * 13 + i / 4096);
+
+    // server side - running on the caller's io_service
+    asio::io_service io_service;
+    asio::ip::tcp::acceptor acceptor(io_service,
+        asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    asio::ip::tcp::socket server(io_service);
+    vector<char> request(5);
+    acceptor.async_accept(server, [&](const boost::system::error_code &ec) {
+        BOOST_REQUIRE(!ec);
+        asio::async_read(server, asio::buffer(request),
+          [&](const boost::system::error_code &ec, size_t) {
+            BOOST_REQUIRE(!ec);
+            asio::async_write(server, asio::buffer(data),
+              [&](const boost::system::error_code &ec, size_t) {
+                BOOST_REQUIRE(!ec);
+                server.close();
+              });
+          });
+        });
+
+    boost::log::sources::severity_logger<Log::Severity> lg;
+    boost::log::sources::severity_logger<Log::Severity> net_lg;
+    Net::TCP::Client::Options opts;
+    opts.host    = "127.0.0.1";
+    opts.service = to_string(acceptor.local_endpoint().port());
+    asio::io_service net_io_service;
+    Net::TCP::Client::Base tcp_client(net_io_service, opts, net_lg);
+    Net::Client::Pipeline client(io_service, net_io_service, tcp_client, 2, lg);
+
+    string received;
+    bool eof = false;
+    vector<char> cmd = { 'a', '1', ' ', 'x', '\n' };
+    function<void(const boost::system::error_code &, size_t)> read_fn =
+      [&](const boost::system::error_code &ec, size_t size) {
+        if (ec) {
+          eof = ec == asio::error::eof;
+          return;
+        }
+        received.append(client.input().data(), size);
+        client.async_read_some(read_fn);
+      };
+    client.async_resolve([&](const boost::system::error_code &ec,
+          asio::ip::tcp::resolver::iterator iterator) {
+        BOOST_REQUIRE(!ec);
+        client.async_connect(iterator, [&](const boost::system::error_code &ec) {
+          BOOST_REQUIRE(!ec);
+          BOOST_CHECK(client.is_open());
+          client.async_handshake([&](const boost::system::error_code &ec) {
+            BOOST_REQUIRE(!ec);
+            client.push_write(cmd);
+            client.async_read_some(read_fn);
+            });
+          });
+        });
+    io_service.run();
+
+    BOOST_CHECK(eof);
+    BOOST_CHECK_EQUAL(string(request.begin(), request.end()), "a1 x\n");
+    BOOST_CHECK_EQUAL(client.bytes_written(), 5u);
+    BOOST_CHECK_EQUAL(client.bytes_read(), data.size());
+    BOOST_CHECK(received == data);
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
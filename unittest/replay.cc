@@ -25,6 +25,8 @@ namespace fs = boost::filesystem;
 
 #include <example/client.h>
 #include <example/server.h>
+#include <trace/trace.h>
+#include <trace/analyzer.h>
 #include <net/ssl_util.h>
 using namespace Net::SSL;
 
@@ -33,8 +35,14 @@ using namespace Net::SSL;
 using namespace ixxx;
 
 #include <iostream>
+#include <string>
+#include <vector>
+#include <string.h>
 using namespace std;
 
+// the old text archive fixture converted into the binary format
+static const char trace_filename[] = "tmp/simple.trace";
+
 static string ut_prefix()
 {
   string prefix("../unittest");
@@ -56,7 +64,7 @@ static void basic_server_in_child()
     opts.key = prefix + "server.key";
     opts.cert =  prefix + "server.crt";
     opts.dhparam = prefix + "dh1024.pem";
-    opts.replayfile = prefix + "simple.log";
+    opts.replayfile = trace_filename;
     // XXX remove from that class
     opts.use_replay = true;
     opts.port = 6666;
@@ -79,6 +87,8 @@ BOOST_AUTO_TEST_SUITE( replay )
 
   BOOST_AUTO_TEST_CASE( basic )
   {
+    fs::create_directory("tmp");
+    Trace::convert(ut_prefix() + "/simple.log", trace_filename);
     int id = posix::fork();
     if (id) {
       timespec ts = {.tv_sec = 1};
@@ -88,7 +98,7 @@ BOOST_AUTO_TEST_SUITE( replay )
       prefix += '/';
       Client::Options opts;
       opts.limit = 120;
-      opts.replayfile = prefix + "simple.log";
+      opts.replayfile = trace_filename;
       opts.ca_file = prefix + "server.crt";
       opts.fingerprint = "ED77CA3CE8B917C3F081FEC35C316E17E7879D35";
       opts.host = "localhost";
@@ -122,4 +132,173 @@ BOOST_AUTO_TEST_SUITE( replay )
     
   }
 
+  BOOST_AUTO_TEST_CASE( binary_roundtrip )
+  {
+    fs::create_directory("tmp");
+    const char filename[] = "tmp/roundtrip.trace";
+    vector<char> big(1000, 'x');
+    {
+      // small buffer, thus the big record bypasses it
+      Trace::Writer w(filename, 64);
+      w.push(Trace::Type::SENT, vector<char>{'a', 'b', 'c'});
+      w.push(Trace::Type::RECEIVED, big, 999);
+      w.push(Trace::Type::DISCONNECT);
+    }
+    Trace::Reader r(filename);
+    Trace::Record_View a(r.next());
+    BOOST_CHECK(a.type == Trace::Type::SENT);
+    BOOST_CHECK_EQUAL(string(a.begin, a.end), "abc");
+    Trace::Record_View b(r.next());
+    BOOST_CHECK(b.type == Trace::Type::RECEIVED);
+    BOOST_CHECK_EQUAL(b.size(), 999u);
+    BOOST_CHECK(r.next().type == Trace::Type::DISCONNECT);
+    BOOST_CHECK(r.next().type == Trace::Type::END_OF_FILE);
+    BOOST_CHECK(r.next().type == Trace::Type::END_OF_FILE);
+  }
+
+  BOOST_AUTO_TEST_CASE( ring )
+  {
+    fs::create_directory("tmp");
+    const char filename[] = "tmp/ring.trace";
+    // room for 2 records with 20 bytes each
+    Trace::Ring ring(2 * (13 + 20) + 10);
+    BOOST_CHECK(ring.empty());
+    string a(20, 'a'), b(20, 'b'), c(20, 'c');
+    ring.push(Trace::Type::SENT, a.data(), a.data() + a.size());
+    ring.push(Trace::Type::RECEIVED, b.data(), b.data() + b.size());
+    ring.push(Trace::Type::SENT, c.data(), c.data() + c.size());
+    ring.dump(filename);
+    Trace::Reader r(filename);
+    Trace::Record_View x(r.next());
+    BOOST_CHECK(x.type == Trace::Type::RECEIVED);
+    BOOST_CHECK_EQUAL(string(x.begin, x.end), b);
+    Trace::Record_View y(r.next());
+    BOOST_CHECK(y.type == Trace::Type::SENT);
+    BOOST_CHECK_EQUAL(string(y.begin, y.end), c);
+    BOOST_CHECK(r.next().type == Trace::Type::END_OF_FILE);
+  }
+
+  BOOST_AUTO_TEST_CASE( ring_fill )
+  {
+    fs::create_directory("tmp");
+    const char filename[] = "tmp/ring_fill.trace";
+    Trace::Ring ring(2 * (13 + 20) + 10);
+    string a(20, 'a'), b(20, 'b');
+    ring.push(Trace::Type::SENT, a.data(), a.data() + a.size());
+    ring.push(Trace::Type::RECEIVED, b.data(), b.data() + b.size());
+    // drops the first record and wraps around
+    ring.push(Trace::Type::RECEIVED, 20, 'X');
+    ring.dump(filename);
+    Trace::Reader r(filename);
+    Trace::Record_View x(r.next());
+    BOOST_CHECK(x.type == Trace::Type::RECEIVED);
+    BOOST_CHECK_EQUAL(string(x.begin, x.end), b);
+    Trace::Record_View y(r.next());
+    BOOST_CHECK(y.type == Trace::Type::RECEIVED);
+    BOOST_CHECK_EQUAL(string(y.begin, y.end), string(20, 'X'));
+    BOOST_CHECK(r.next().type == Trace::Type::END_OF_FILE);
+  }
+
+  BOOST_AUTO_TEST_CASE( redact )
+  {
+    vector<char> out;
+    string a("A001 LOGIN juser secret\r\n");
+    BOOST_REQUIRE(Trace::redact_credentials(a.data(), a.data() + a.size(), out));
+    BOOST_CHECK_EQUAL(string(out.begin(), out.end()), "A001 LOGIN XXXXX XXXXXX\r\n");
+
+    string b("A002 login \"ju ser\" {6}\r\nse{r}t\r\n");
+    BOOST_REQUIRE(Trace::redact_credentials(b.data(), b.data() + b.size(), out));
+    BOOST_CHECK_EQUAL(string(out.begin(), out.end()),
+        "A002 login XXX XXXX {6}\r\nXXXXXX\r\n");
+
+    string c("A003 AUTHENTICATE PLAIN AGp1c2VyAHNlY3JldA==\r\n");
+    BOOST_REQUIRE(Trace::redact_credentials(c.data(), c.data() + c.size(), out));
+    BOOST_CHECK_EQUAL(string(out.begin(), out.end()),
+        "A003 AUTHENTICATE XXXXX XXXXXXXXXXXXXXXXXXXX\r\n");
+
+    string d("A004 SELECT INBOX\r\n");
+    BOOST_CHECK(!Trace::redact_credentials(d.data(), d.data() + d.size(), out));
+    string e("A005 LOGOUT\r\n");
+    BOOST_CHECK(!Trace::redact_credentials(e.data(), e.data() + e.size(), out));
+  }
+
+  BOOST_AUTO_TEST_CASE( private_file )
+  {
+    fs::create_directory("tmp");
+    const char filename[] = "tmp/private.trace";
+    fs::remove(filename);
+    {
+      Trace::Writer w(filename, 64);
+      w.push(Trace::Type::SENT, vector<char>{'a'});
+    }
+    auto p = fs::status(filename).permissions();
+    BOOST_CHECK_EQUAL(p & (fs::group_all | fs::others_all), 0);
+  }
+
+  static Trace::Record_View view(Trace::Type type, uint64_t timestamp,
+      const char *s)
+  {
+    Trace::Record_View r;
+    r.type      = type;
+    r.timestamp = timestamp;
+    r.begin     = s;
+    r.end       = s + strlen(s);
+    return r;
+  }
+
+  BOOST_AUTO_TEST_CASE( analyze )
+  {
+    Trace::Analyzer a(50000);
+    a.push(view(Trace::Type::MARK    ,  1000, "resolve"));
+    a.push(view(Trace::Type::MARK    ,  2000, "connect"));
+    a.push(view(Trace::Type::MARK    ,  3000, "handshake"));
+    a.push(view(Trace::Type::RECEIVED,  4000, "* OK ready\r\n"));
+    a.push(view(Trace::Type::SENT    ,  1000, "A1 UID FETCH 1:* (BODY.PEEK[])\r\n"));
+    a.push(view(Trace::Type::RECEIVED, 10000, "* 1 FETCH (UID 5 BODY[] {10}\r\n01234"));
+    // tag inside the literal
+    a.push(view(Trace::Type::RECEIVED, 60000, "A1 OK\r\n)\r\n"));
+    a.push(view(Trace::Type::RECEIVED,  1000, "A1 OK done\r\n"));
+    a.push(view(Trace::Type::SENT    ,  2000, "A2 LOGOUT\r\n"));
+
+    BOOST_REQUIRE_EQUAL(a.commands().size(), 2u);
+    auto &c = a.commands().front();
+    BOOST_CHECK_EQUAL(c.name, "UID FETCH");
+    BOOST_CHECK_EQUAL(c.sent, 11000u);
+    BOOST_CHECK_EQUAL(c.to_first_byte(), 10000u);
+    BOOST_CHECK_EQUAL(c.latency(), 71000u);
+    BOOST_CHECK_EQUAL(c.literal, 10u);
+    BOOST_CHECK(!a.commands().back().done);
+
+    auto ps = a.phases();
+    BOOST_REQUIRE_EQUAL(ps.size(), 6u);
+    BOOST_CHECK_EQUAL(ps[0].name, "resolve");
+    BOOST_CHECK_EQUAL(ps[2].end - ps[2].begin, 3000u);
+    BOOST_CHECK_EQUAL(ps[3].name, "greeting");
+    BOOST_CHECK_EQUAL(ps[4].name, "fetch");
+    BOOST_CHECK_EQUAL(ps[5].name, "logout");
+
+    BOOST_REQUIRE_EQUAL(a.gaps().size(), 1u);
+    BOOST_CHECK_EQUAL(a.gaps().front().length, 60000u);
+    BOOST_CHECK(a.gaps().front().in_flight);
+  }
+
+  BOOST_AUTO_TEST_CASE( convert )
+  {
+    fs::create_directory("tmp");
+    const char filename[] = "tmp/simple_conv.trace";
+    Trace::convert(ut_prefix() + "/simple.log", filename);
+    Trace::Reader old_format(ut_prefix() + "/simple.log");
+    Trace::Reader new_format(filename);
+    for (;;) {
+      Trace::Record_View a(old_format.next());
+      Trace::Record_View b(new_format.next());
+      BOOST_CHECK(a.type == b.type);
+      BOOST_CHECK_EQUAL(a.timestamp, b.timestamp);
+      BOOST_CHECK_EQUAL(string(a.begin, a.end), string(b.begin, b.end));
+      if (a.type == Trace::Type::END_OF_FILE
+          || b.type == Trace::Type::END_OF_FILE)
+        break;
+    }
+  }
+
 BOOST_AUTO_TEST_SUITE_END()
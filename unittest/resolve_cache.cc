@@ -0,0 +1,127 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+
+#include <net/resolve_cache.h>
+
+#include <boost/version.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace asio = boost::asio;
+
+static asio::ip::tcp::resolver::iterator to_iterator(
+    const vector<asio::ip::tcp::endpoint> &v, const char *host)
+{
+#if BOOST_VERSION >= 106600
+  return asio::ip::tcp::resolver::results_type::create(v.begin(), v.end(),
+      host, "imaps");
+#else
+  return asio::ip::tcp::resolver::iterator::create(v.begin(), v.end(),
+      host, "imaps");
+#endif
+}
+
+static vector<asio::ip::tcp::endpoint> to_vector(
+    asio::ip::tcp::resolver::iterator i)
+{
+  vector<asio::ip::tcp::endpoint> r;
+  for (; i != asio::ip::tcp::resolver::iterator(); ++i)
+    r.push_back(i->endpoint());
+  return r;
+}
+
+BOOST_AUTO_TEST_SUITE( resolve_cache )
+
+  BOOST_AUTO_TEST_CASE( store_lookup )
+  {
+    const char filename[] = "tmp/resolve.cache";
+    fs::create_directory("tmp");
+    fs::remove(filename);
+    Net::Resolve_Cache a(filename, chrono::seconds(3600), "imap.example.org", "imaps");
+    Net::Resolve_Cache b(filename, chrono::seconds(3600), "mail.example.org", "993");
+    BOOST_CHECK(a.lookup() == asio::ip::tcp::resolver::iterator());
+
+    vector<asio::ip::tcp::endpoint> v = {
+      { asio::ip::address::from_string("2001:db8::1"), 993 },
+      { asio::ip::address::from_string("192.0.2.1")  , 993 }
+    };
+    vector<asio::ip::tcp::endpoint> w = {
+      { asio::ip::address::from_string("192.0.2.23") , 993 }
+    };
+    a.store(to_iterator(v, "imap.example.org"));
+    b.store(to_iterator(w, "mail.example.org"));
+    BOOST_CHECK(to_vector(a.lookup()) == v);
+    BOOST_CHECK(to_vector(b.lookup()) == w);
+
+    a.invalidate();
+    BOOST_CHECK(a.lookup() == asio::ip::tcp::resolver::iterator());
+    BOOST_CHECK(to_vector(b.lookup()) == w);
+  }
+
+  BOOST_AUTO_TEST_CASE( expired )
+  {
+    const char filename[] = "tmp/resolve_expired.cache";
+    fs::create_directory("tmp");
+    fs::remove(filename);
+    Net::Resolve_Cache a(filename, chrono::seconds(0), "imap.example.org", "imaps");
+    vector<asio::ip::tcp::endpoint> v = {
+      { asio::ip::address::from_string("192.0.2.1"), 993 }
+    };
+    a.store(to_iterator(v, "imap.example.org"));
+    BOOST_CHECK(a.lookup() == asio::ip::tcp::resolver::iterator());
+  }
+
+  // like several accounts running at the same time
+  BOOST_AUTO_TEST_CASE( concurrent )
+  {
+    const char filename[] = "tmp/resolve_concurrent.cache";
+    fs::create_directory("tmp");
+    fs::remove(filename);
+    const unsigned n = 8;
+    vector<thread> threads;
+    for (unsigned i = 0; i < n; ++i)
+      threads.emplace_back([i, &filename]() {
+          string host("host" + to_string(i) + ".example.org");
+          Net::Resolve_Cache c(filename, chrono::seconds(3600), host, "imaps");
+          vector<asio::ip::tcp::endpoint> v = {
+            { asio::ip::address_v4(0xc0000200 + i), 993 }
+          };
+          for (unsigned j = 0; j < 20; ++j)
+            c.store(to_iterator(v, host.c_str()));
+          });
+    for (auto &t : threads)
+      t.join();
+    for (unsigned i = 0; i < n; ++i) {
+      string host("host" + to_string(i) + ".example.org");
+      Net::Resolve_Cache c(filename, chrono::seconds(3600), host, "imaps");
+      auto v = to_vector(c.lookup());
+      BOOST_REQUIRE_EQUAL(v.size(), 1u);
+      BOOST_CHECK(v.front().address() == asio::ip::address_v4(0xc0000200 + i));
+    }
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,80 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+
+#include <copy/schedule.h>
+
+#include <chrono>
+using namespace std;
+
+using IMAP::Copy::Schedule;
+
+static long secs(Schedule::Duration d)
+{
+  return long(chrono::duration_cast<chrono::seconds>(d).count());
+}
+
+BOOST_AUTO_TEST_SUITE( schedule )
+
+  BOOST_AUTO_TEST_CASE( no_jitter )
+  {
+    Schedule s(60, 600, 0);
+    BOOST_CHECK_EQUAL(secs(s.first(0.9)), 0);
+    // new messages
+    BOOST_CHECK_EQUAL(secs(s.next(true, 3, 0.5)), 60);
+    // quiet
+    BOOST_CHECK_EQUAL(secs(s.next(true, 0, 0.5)), 75);
+    BOOST_CHECK_EQUAL(secs(s.next(true, 0, 0.5)), 90);
+    BOOST_CHECK_EQUAL(secs(s.next(true, 1, 0.5)), 60);
+    // failing
+    BOOST_CHECK_EQUAL(secs(s.next(false, 0, 0.5)), 120);
+    BOOST_CHECK_EQUAL(secs(s.next(false, 0, 0.5)), 240);
+    BOOST_CHECK_EQUAL(secs(s.next(false, 0, 0.5)), 480);
+    BOOST_CHECK_EQUAL(secs(s.next(false, 0, 0.5)), 600);
+    BOOST_CHECK_EQUAL(s.failures(), 4u);
+    for (unsigned i = 0; i < 100; ++i)
+      s.next(false, 0, 0.5);
+    BOOST_CHECK_EQUAL(secs(s.next(false, 0, 0.5)), 600);
+    BOOST_CHECK_EQUAL(secs(s.next(true, 0, 0.5)), 75);
+    BOOST_CHECK_EQUAL(s.failures(), 0u);
+  }
+
+  BOOST_AUTO_TEST_CASE( jitter )
+  {
+    Schedule s(100, 1000, 10);
+    BOOST_CHECK_EQUAL(secs(s.first(0)), 0);
+    BOOST_CHECK_EQUAL(secs(s.first(0.5)), 5);
+    BOOST_CHECK_EQUAL(secs(s.next(true, 1, 0)), 90);
+    BOOST_CHECK_EQUAL(secs(s.next(true, 1, 0.5)), 100);
+    BOOST_CHECK_EQUAL(secs(s.next(true, 1, 0.99)), 109);
+  }
+
+  BOOST_AUTO_TEST_CASE( bounds )
+  {
+    // max_interval is at least the interval
+    Schedule s(100, 10, 0);
+    BOOST_CHECK_EQUAL(secs(s.next(true, 1, 0)), 100);
+    BOOST_CHECK_EQUAL(secs(s.next(false, 0, 0)), 100);
+    Schedule t(0, 0, 0);
+    BOOST_CHECK_EQUAL(secs(t.next(true, 1, 0)), 1);
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
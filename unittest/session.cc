@@ -0,0 +1,123 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <imap/session.h>
+#include <bench/session.h>
+#include <net/loopback_client.h>
+
+#include <boost/asio/coroutine.hpp>
+
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+#include <boost/asio/yield.hpp>
+
+namespace {
+
+  const char username[] = "juser123";
+  const char password[] = "muchvery";
+  const string host     = "localhost";
+
+  // a download flow as stackless coroutine
+  struct Flow : boost::asio::coroutine {
+    IMAP::Client::Session                          &session;
+    vector<pair<uint32_t, uint32_t> >               set;
+    vector<IMAP::Client::Fetch_Attribute>           atts;
+    vector<IMAP::Client::Session::Message>          messages;
+    bool                                            done {false};
+
+    Flow(IMAP::Client::Session &s)
+      :
+        session(s),
+        set{{1, numeric_limits<uint32_t>::max()}}
+    {
+      using namespace IMAP::Client;
+      atts.emplace_back(Fetch::UID);
+      atts.emplace_back(Fetch::FLAGS);
+      vector<string> fields = { "date", "from", "subject" };
+      atts.emplace_back(Fetch::BODY_PEEK,
+          IMAP::Section_Attribute(IMAP::Section::HEADER_FIELDS, std::move(fields)));
+      atts.emplace_back(Fetch::BODY_PEEK);
+      session.set_message_fn([this](const IMAP::Client::Session::Message &m) {
+          messages.push_back(m);
+          });
+    }
+    void operator()()
+    {
+      reenter (this) {
+        yield session.async_start(            [this](){ (*this)(); });
+        yield session.async_login(username, password,
+                                              [this](){ (*this)(); });
+        yield session.async_select("INBOX",   [this](){ (*this)(); });
+        yield session.async_fetch(set, atts,  [this](){ (*this)(); });
+        yield session.async_logout(           [this](){ (*this)(); });
+        yield session.async_finish(           [this](){ (*this)(); });
+        done = true;
+      }
+    }
+  };
+
+}
+
+#include <boost/asio/unyield.hpp>
+
+BOOST_AUTO_TEST_SUITE( session )
+
+  BOOST_AUTO_TEST_CASE( fetch_events )
+  {
+    fs::create_directories("tmp");
+    Bench::Session_Options sopts;
+    sopts.count    = 7;
+    sopts.username = username;
+    sopts.password = password;
+    string trace("tmp/session.trace");
+    Bench::generate(trace, sopts);
+
+    boost::asio::io_service io_service;
+    boost::log::sources::severity_logger<Log::Severity> lg;
+    Net::Loopback::Client::Options opts;
+    opts.script = trace;
+    Net::Loopback::Client::Base client(io_service, opts, lg);
+    IMAP::Client::Session session(host, client, lg);
+    Flow flow(session);
+    flow();
+    io_service.run();
+
+    BOOST_CHECK(flow.done);
+    BOOST_CHECK(client.finished());
+    BOOST_REQUIRE_EQUAL(flow.messages.size(), sopts.count);
+    for (size_t i = 0; i < flow.messages.size(); ++i) {
+      auto &m = flow.messages[i];
+      BOOST_CHECK_EQUAL(m.number, i + 1);
+      BOOST_CHECK_EQUAL(m.uid, i + 1);
+      BOOST_CHECK(m.has(IMAP::Flag::RECENT));
+      BOOST_CHECK(!m.has(IMAP::Flag::SEEN));
+      BOOST_CHECK(m.size > 0);
+    }
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
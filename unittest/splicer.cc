@@ -0,0 +1,189 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+namespace fs = boost::filesystem;
+
+#include <net/splicer.h>
+
+#include <boost/asio.hpp>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace asio = boost::asio;
+
+BOOST_AUTO_TEST_SUITE( splicer )
+
+  BOOST_AUTO_TEST_CASE( loopback )
+  {
+    static const char filename[] = "tmp/splicer";
+    fs::create_directory("tmp");
+    fs::remove(filename);
+
+    string data(3 * 1024 * 1024 + 17, 0);
+    for (size_t i = 0; i < data.size(); ++i)
+      data[i] = char(i * 7 + i / 1024);
+    const size_t n = data.size() - 5;
+
+    asio::io_service io_service;
+    asio::ip::tcp::acceptor acceptor(io_service,
+        asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    asio::ip::tcp::socket server(io_service);
+    asio::ip::tcp::socket client(io_service);
+    acceptor.async_accept(server, [&](const boost::system::error_code &ec) {
+        BOOST_REQUIRE(!ec);
+        asio::async_write(server, asio::buffer(data),
+          [](const boost::system::error_code &ec, size_t) {
+            BOOST_REQUIRE(!ec);
+          });
+        });
+    client.connect(acceptor.local_endpoint());
+
+    int fd = open(filename, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+    BOOST_REQUIRE(fd != -1);
+    Net::TCP::Splicer splicer(io_service, client);
+    size_t left = n;
+    bool supported = true;
+    function<void(const boost::system::error_code &, size_t)> fn =
+      [&](const boost::system::error_code &ec, size_t size) {
+        if (ec == asio::error::operation_not_supported) {
+          supported = false;
+          return;
+        }
+        BOOST_REQUIRE(!ec);
+        BOOST_REQUIRE(size);
+        BOOST_REQUIRE(size <= left);
+        left -= size;
+        if (left)
+          splicer.async_splice(fd, left, fn);
+      };
+    splicer.async_splice(fd, left, fn);
+    io_service.run();
+    close(fd);
+    if (!supported)
+      return;
+    BOOST_CHECK_EQUAL(left, 0u);
+
+    // the bytes after the spliced ones are still readable as usual
+    vector<char> rest(5);
+    asio::read(client, asio::buffer(rest));
+    BOOST_CHECK(equal(rest.begin(), rest.end(), data.begin() + n));
+
+    ifstream f(filename, ifstream::in | ifstream::binary);
+    string content((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+    BOOST_CHECK_EQUAL(content.size(), n);
+    BOOST_CHECK(content == data.substr(0, n));
+  }
+
+  // a failed write (here: into a full pipe) must not lose the bytes
+  // already taken off the socket
+  BOOST_AUTO_TEST_CASE( failing_fd )
+  {
+    static const char filename[] = "tmp/splicer_fail";
+    fs::create_directory("tmp");
+    fs::remove(filename);
+
+    string data(256 * 1024 + 3, 0);
+    for (size_t i = 0; i < data.size(); ++i)
+      data[i] = char(i * 13 + i / 512);
+
+    asio::io_service io_service;
+    asio::ip::tcp::acceptor acceptor(io_service,
+        asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    asio::ip::tcp::socket server(io_service);
+    asio::ip::tcp::socket client(io_service);
+    acceptor.async_accept(server, [&](const boost::system::error_code &ec) {
+        BOOST_REQUIRE(!ec);
+        asio::async_write(server, asio::buffer(data),
+          [](const boost::system::error_code &ec, size_t) {
+            BOOST_REQUIRE(!ec);
+          });
+        });
+    client.connect(acceptor.local_endpoint());
+
+    int full[2];
+    BOOST_REQUIRE(pipe2(full, O_NONBLOCK) == 0);
+    char c = 'x';
+    size_t filler = 0;
+    while (write(full[1], &c, 1) == 1)
+      ++filler;
+
+    int fd = open(filename, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+    BOOST_REQUIRE(fd != -1);
+    Net::TCP::Splicer splicer(io_service, client);
+    size_t left = data.size();
+    size_t failed_size = 0;
+    bool supported = true;
+    bool failed = false;
+    function<void(const boost::system::error_code &, size_t)> fn =
+      [&](const boost::system::error_code &ec, size_t size) {
+        if (ec == asio::error::operation_not_supported) {
+          supported = false;
+          return;
+        }
+        BOOST_REQUIRE(size <= left);
+        left -= size;
+        if (!failed) {
+          BOOST_REQUIRE(ec);
+          failed = true;
+          failed_size = size;
+        } else {
+          BOOST_REQUIRE(!ec);
+          BOOST_REQUIRE(size);
+        }
+        // continue into the file
+        if (left)
+          splicer.async_splice(fd, left, fn);
+      };
+    splicer.async_splice(full[1], left, fn);
+    io_service.run();
+    close(fd);
+    if (!supported) {
+      close(full[0]);
+      close(full[1]);
+      return;
+    }
+    BOOST_CHECK(failed);
+    BOOST_CHECK_EQUAL(left, 0u);
+
+    string first;
+    char buf[4096];
+    ssize_t r;
+    while ((r = read(full[0], buf, sizeof buf)) > 0)
+      first.append(buf, size_t(r));
+    close(full[0]);
+    close(full[1]);
+    BOOST_REQUIRE_EQUAL(first.size(), filler + failed_size);
+
+    ifstream f(filename, ifstream::in | ifstream::binary);
+    string content((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
+    BOOST_CHECK(first.substr(filler) + content == data);
+  }
+
+BOOST_AUTO_TEST_SUITE_END()
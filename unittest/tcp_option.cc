@@ -0,0 +1,86 @@
+// Copyright 2014, Georg Sauthoff <mail@georg.so>
+
+/* {{{ GPLv3
+
+    This file is part of imapdl.
+
+    imapdl is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    imapdl is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with imapdl.  If not, see <http://www.gnu.org/licenses/>.
+
+}}} */
+#include <boost/test/unit_test.hpp>
+
+#include <net/tcp_option.h>
+#include <net/tcp_client.h>
+
+#include <boost/asio.hpp>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace asio = boost::asio;
+
+static int get_int(asio::ip::tcp::socket &socket, int level, int name)
+{
+  int value = 0;
+  socklen_t n = sizeof value;
+  BOOST_REQUIRE(!::getsockopt(socket.native_handle(), level, name, &value, &n));
+  return value;
+}
+
+BOOST_AUTO_TEST_SUITE( tcp_option )
+
+  BOOST_AUTO_TEST_CASE( defaults )
+  {
+    asio::io_service io_service;
+    asio::ip::tcp::socket socket(io_service);
+    socket.open(asio::ip::tcp::v4());
+    int rcvbuf = get_int(socket, SOL_SOCKET, SO_RCVBUF);
+    int sndbuf = get_int(socket, SOL_SOCKET, SO_SNDBUF);
+
+    Net::TCP::Client::Options opts;
+    boost::log::sources::severity_logger<Log::Severity> lg;
+    Net::TCP::Option::apply(socket, opts, lg);
+    BOOST_CHECK_EQUAL(get_int(socket, IPPROTO_TCP, TCP_NODELAY), 0);
+    BOOST_CHECK_EQUAL(get_int(socket, SOL_SOCKET, SO_RCVBUF), rcvbuf);
+    BOOST_CHECK_EQUAL(get_int(socket, SOL_SOCKET, SO_SNDBUF), sndbuf);
+  }
+
+  BOOST_AUTO_TEST_CASE( apply )
+  {
+    asio::io_service io_service;
+    asio::ip::tcp::acceptor acceptor(io_service,
+        asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    asio::ip::tcp::socket socket(io_service);
+    socket.open(asio::ip::tcp::v4());
+
+    Net::TCP::Client::Options opts;
+    opts.no_delay = true;
+    opts.rcvbuf   = 64 * 1024;
+    opts.sndbuf   = 32 * 1024;
+    boost::log::sources::severity_logger<Log::Severity> lg;
+    Net::TCP::Option::apply(socket, opts, lg);
+    socket.connect(acceptor.local_endpoint());
+
+    BOOST_CHECK(get_int(socket, IPPROTO_TCP, TCP_NODELAY) != 0);
+    // Linux doubles the value for its bookkeeping overhead
+    int rcvbuf = get_int(socket, SOL_SOCKET, SO_RCVBUF);
+    BOOST_CHECK(rcvbuf >= int(opts.rcvbuf));
+    BOOST_CHECK(rcvbuf <= 2 * int(opts.rcvbuf));
+    int sndbuf = get_int(socket, SOL_SOCKET, SO_SNDBUF);
+    BOOST_CHECK(sndbuf >= int(opts.sndbuf));
+    BOOST_CHECK(sndbuf <= 2 * int(opts.sndbuf));
+  }
+
+BOOST_AUTO_TEST_SUITE_END()